@@ -0,0 +1,147 @@
+#include <uclib/uclib.h>
+
+/* Checks clib_arena_t push, pop and reset and freeing of arena and
+   parent heap objects while arena is pushed.  Example:
+     arena iter 1000 */
+
+typedef struct {
+  clib_arena_t arena;
+
+  u32 n_iter;
+
+  /* First failed check; errors can't be formatted while arena is
+     pushed without allocating from it. */
+  char * error_message;
+  u32 n_errors;
+} test_arena_main_t;
+
+always_inline void
+test_arena_check (test_arena_main_t * tm, uword is_ok, char * what)
+{
+  if (! is_ok)
+    {
+      if (! tm->error_message)
+	tm->error_message = what;
+      tm->n_errors++;
+    }
+}
+
+always_inline uword
+test_arena_heap_bytes_used (void * heap)
+{
+  clib_mem_usage_t u;
+  mheap_usage (heap, &u);
+  return u.bytes_used;
+}
+
+static void
+test_arena_iteration (test_arena_main_t * tm, uword iter)
+{
+  clib_arena_t * a = &tm->arena;
+  void * parent;
+  u8 * parent_vec = 0, * s = 0, * k, * mid, * last;
+  uword * h, i, n_bytes, n_parent_bytes;
+
+  /* Heap is made on first allocation. */
+  vec_resize (parent_vec, 100 + iter % 50);
+  parent = clib_mem_get_heap ();
+  n_parent_bytes = test_arena_heap_bytes_used (parent);
+
+  clib_arena_push (a);
+  test_arena_check (tm, clib_mem_get_heap () == a->heap, "push sets heap");
+
+  /* Typical request handling: format and hash allocate from arena. */
+  h = hash_create_string (0, sizeof (uword));
+  for (i = 0; i < 100; i++)
+    {
+      s = format (s, "line %d %s\n", i, "hello world");
+      k = format (0, "key%d%c", i, 0);
+      hash_set_mem (h, k, i);
+    }
+  test_arena_check (tm, hash_get_mem (h, "key37")[0] == 37, "hash get");
+  test_arena_check (tm, clib_mem_heap_for_object (s) == a->heap, "object in arena");
+  test_arena_check (tm, clib_mem_heap_for_object (parent_vec) == parent, "object in parent");
+
+  /* Freeing last object gives its bytes back. */
+  n_bytes = clib_arena_bytes (a);
+  last = clib_mem_alloc (100);
+  test_arena_check (tm, clib_arena_bytes (a) > n_bytes, "alloc grows arena");
+  clib_mem_free (last);
+  test_arena_check (tm, clib_arena_bytes (a) == n_bytes, "free last");
+
+  /* Others stay allocated until reset. */
+  mid = clib_mem_alloc (64);
+  last = clib_mem_alloc (64);
+  n_bytes = clib_arena_bytes (a);
+  clib_mem_free (mid);
+  test_arena_check (tm, clib_arena_bytes (a) == n_bytes, "free not last");
+
+  /* Parent heap objects go back to parent. */
+  vec_free (parent_vec);
+  test_arena_check (tm, test_arena_heap_bytes_used (parent) < n_parent_bytes, "free parent object");
+  test_arena_check (tm, clib_arena_bytes (a) == n_bytes, "free parent object in arena");
+
+  clib_arena_pop (a);
+  test_arena_check (tm, clib_mem_get_heap () == parent, "pop restores heap");
+
+  clib_arena_reset (a);
+  test_arena_check (tm, clib_arena_bytes (a) == 0, "reset");
+  mheap_validate (parent);
+}
+
+int test_arena_main (unformat_input_t * input)
+{
+  test_arena_main_t tm;
+  clib_error_t * error = 0;
+  uword i;
+
+  memset (&tm, 0, sizeof (tm));
+  tm.n_iter = 1000;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "iter %d", &tm.n_iter))
+        ;
+      else
+        {
+          error = clib_error_return (0, "unknown input `%U'", format_unformat_error, input);
+          goto done;
+        }
+    }
+
+  if (! clib_arena_init (&tm.arena, 4 << 20))
+    {
+      error = clib_error_return (0, "failed to allocate arena");
+      goto done;
+    }
+
+  for (i = 0; i < tm.n_iter; i++)
+    test_arena_iteration (&tm, i);
+
+  fformat (stdout, "%U\n", format_mheap, tm.arena.heap, /* verbose */ 0);
+
+  if (tm.n_errors > 0)
+    error = clib_error_return (0, "%d errors, first: %s", tm.n_errors, tm.error_message);
+
+  clib_arena_free (&tm.arena);
+
+ done:
+  if (error)
+    {
+      clib_error_report (error);
+      return 1;
+    }
+  return 0;
+}
+
+int main (int argc, char * argv[])
+{
+  unformat_input_t i;
+  int ret;
+
+  unformat_init_command_line (&i, argv);
+  ret = test_arena_main (&i);
+  unformat_free (&i);
+
+  return ret;
+}
@@ -0,0 +1,288 @@
+#include <uclib/uclib.h>
+#include "test.h"
+
+/* Checks clib_flat_hash_t against hash.c tables.  Example:
+     flat_hash iter 100000 elts 1000 seed 1 */
+
+typedef struct {
+  u32 a, b, c;
+} test_flat_hash_key_t;
+
+typedef struct {
+  u32 n_iter;
+  u32 n_elts;
+  u32 seed;
+  u32 verbose;
+
+  u32 n_errors;
+} test_flat_hash_main_t;
+
+always_inline test_flat_hash_key_t
+test_flat_hash_key (u32 i)
+{
+  test_flat_hash_key_t k = { .a = i, .b = i * 7, .c = ~i, };
+  return k;
+}
+
+always_inline uword
+test_flat_hash_n_ctrl (clib_flat_hash_t * h, u8 c)
+{
+  uword i, n = 0;
+  for (i = 0; i < clib_flat_hash_capacity (h); i++)
+    n += h->ctrl[i] == c;
+  return n;
+}
+
+/* Every EMPTY slot filled is either full or DELETED. */
+static void
+test_flat_hash_validate (test_flat_hash_main_t * tm, clib_flat_hash_t * h)
+{
+  uword cap = clib_flat_hash_capacity (h);
+  uword n_deleted = test_flat_hash_n_ctrl (h, CLIB_FLAT_HASH_CTRL_DELETED);
+  uword n_empty = test_flat_hash_n_ctrl (h, CLIB_FLAT_HASH_CTRL_EMPTY);
+
+  if (! h->ctrl)
+    return;
+  test_check (tm, n_empty + n_deleted + h->n_elts == cap);
+  test_check (tm, h->n_growth_left == cap - cap / 8 - h->n_elts - n_deleted);
+}
+
+/* Table must hold exactly keys of reference hash, each once. */
+static void
+test_flat_hash_compare (test_flat_hash_main_t * tm, clib_flat_hash_t * h, uword * ref)
+{
+  test_flat_hash_key_t * k;
+  hash_pair_t * p;
+  uword * v, * seen = 0;
+
+  test_check (tm, clib_flat_hash_elts (h) == hash_elts (ref));
+
+  hash_foreach_pair (p, ref, ({
+    test_flat_hash_key_t key = test_flat_hash_key (p->key);
+    v = clib_flat_hash_get (h, key);
+    test_check (tm, v && v[0] == p->value[0]);
+  }));
+
+  clib_flat_hash_foreach (k, v, h, ({
+    uword * r = hash_get (ref, k->a);
+    test_check (tm, r && r[0] == v[0]);
+    test_check (tm, ! clib_bitmap_get (seen, k->a));
+    seen = clib_bitmap_ori (seen, k->a);
+  }));
+
+  clib_bitmap_free (seen);
+}
+
+/* Random sets and unsets checked against reference after each one. */
+static void
+test_flat_hash_random (test_flat_hash_main_t * tm)
+{
+  clib_flat_hash_t h;
+  uword * ref, * p, was, old, value, iter;
+  u32 seed = tm->seed, i;
+
+  clib_flat_hash_init (&h, sizeof (test_flat_hash_key_t), sizeof (uword), 0);
+  ref = hash_create (0, sizeof (uword));
+
+  for (iter = 0; iter < tm->n_iter; iter++)
+    {
+      test_flat_hash_key_t k;
+
+      i = random_u32 (&seed) % tm->n_elts;
+      k = test_flat_hash_key (i);
+      p = hash_get (ref, i);
+
+      if (random_u32 (&seed) >> 31)
+	{
+	  value = iter;
+	  was = clib_flat_hash_set_mem (&h, &k, &value, &old);
+	  test_check (tm, was == (p != 0));
+	  test_check (tm, ! p || old == p[0]);
+	  hash_set (ref, i, iter);
+	}
+      else
+	{
+	  was = clib_flat_hash_unset_mem (&h, &k, &old);
+	  test_check (tm, was == (p != 0));
+	  test_check (tm, ! p || old == p[0]);
+	  test_check (tm, ! clib_flat_hash_get (&h, k));
+	  hash_unset (ref, i);
+	}
+
+      test_check (tm, clib_flat_hash_elts (&h) == hash_elts (ref));
+
+      if (iter % 1024 == 0)
+	{
+	  test_flat_hash_validate (tm, &h);
+	  test_flat_hash_compare (tm, &h, ref);
+	}
+    }
+
+  test_flat_hash_validate (tm, &h);
+  test_flat_hash_compare (tm, &h, ref);
+
+  if (tm->verbose)
+    fformat (stdout, "%U\n", format_clib_flat_hash, &h);
+
+  clib_flat_hash_free (&h);
+  hash_free (ref);
+}
+
+/* Unset from a group with an EMPTY slot makes slot EMPTY again;
+   otherwise slot must be left DELETED. */
+static void
+test_flat_hash_unset_ctrl (test_flat_hash_main_t * tm)
+{
+  clib_flat_hash_t h;
+  uword i, j, g, value = 0, n_growth_left, had_empty;
+
+  clib_flat_hash_init (&h, sizeof (test_flat_hash_key_t), sizeof (uword), tm->n_elts);
+  for (i = 0; i < tm->n_elts; i++)
+    {
+      test_flat_hash_key_t k = test_flat_hash_key (i);
+      clib_flat_hash_set (&h, k, value);
+    }
+
+  for (i = 0; i < tm->n_elts; i++)
+    {
+      test_flat_hash_key_t k = test_flat_hash_key (i);
+
+      j = clib_flat_hash_find (&h, &k, clib_flat_hash_key_sum (&h, &k));
+      test_check (tm, j != ~0);
+      if (j == ~0)
+	continue;
+
+      g = j & ~(CLIB_FLAT_HASH_GROUP_SIZE - 1);
+      had_empty = clib_flat_hash_group_match (h.ctrl + g, CLIB_FLAT_HASH_CTRL_EMPTY) != 0;
+      n_growth_left = h.n_growth_left;
+
+      clib_flat_hash_unset (&h, k);
+      if (had_empty)
+	test_check (tm, h.ctrl[j] == CLIB_FLAT_HASH_CTRL_EMPTY
+			&& h.n_growth_left == n_growth_left + 1);
+      else
+	test_check (tm, h.ctrl[j] == CLIB_FLAT_HASH_CTRL_DELETED
+			&& h.n_growth_left == n_growth_left);
+    }
+
+  /* All slots of a never full table are EMPTY again. */
+  test_check (tm, clib_flat_hash_elts (&h) == 0);
+  test_flat_hash_validate (tm, &h);
+
+  clib_flat_hash_free (&h);
+}
+
+/* Table grows as keys are added and keeps its size when it is
+   re-hashed to drop DELETED slots. */
+static void
+test_flat_hash_growth (test_flat_hash_main_t * tm)
+{
+  clib_flat_hash_t h;
+  uword i, j, n, cap, value = 0, n_left;
+
+  clib_flat_hash_init (&h, sizeof (test_flat_hash_key_t), sizeof (uword), 0);
+
+  /* Fill to maximum load. */
+  cap = 0;
+  for (i = 0; i < tm->n_elts || h.n_growth_left > 0; i++)
+    {
+      test_flat_hash_key_t k = test_flat_hash_key (i);
+      clib_flat_hash_set (&h, k, value);
+      test_check (tm, clib_flat_hash_capacity (&h) >= cap);
+      test_check (tm, clib_flat_hash_elts (&h) <= clib_flat_hash_capacity (&h) * 7 / 8);
+      cap = clib_flat_hash_capacity (&h);
+    }
+  n = i;
+
+  /* Unset keys in full groups: this leaves DELETED slots and no
+     growth so next set into an EMPTY slot must re-hash. */
+  for (i = 0; i < n; i++)
+    {
+      test_flat_hash_key_t k = test_flat_hash_key (i);
+      j = clib_flat_hash_find (&h, &k, clib_flat_hash_key_sum (&h, &k));
+      if (! clib_flat_hash_group_match (h.ctrl + (j & ~(CLIB_FLAT_HASH_GROUP_SIZE - 1)),
+					CLIB_FLAT_HASH_CTRL_EMPTY))
+	clib_flat_hash_unset (&h, k);
+    }
+  test_check (tm, h.n_growth_left == 0);
+  test_flat_hash_validate (tm, &h);
+
+  /* Re-hash keeps size while table is more than half full. */
+  n_left = clib_flat_hash_elts (&h);
+  for (i = n; i < n + cap / 8; i++)
+    {
+      test_flat_hash_key_t k = test_flat_hash_key (i);
+      clib_flat_hash_set (&h, k, value);
+      if (clib_flat_hash_elts (&h) <= cap * 7 / 16)
+	test_check (tm, clib_flat_hash_capacity (&h) == cap);
+    }
+  test_check (tm, test_flat_hash_n_ctrl (&h, CLIB_FLAT_HASH_CTRL_DELETED) == 0);
+  test_check (tm, clib_flat_hash_elts (&h) == n_left + cap / 8);
+  test_flat_hash_validate (tm, &h);
+
+  clib_flat_hash_free (&h);
+}
+
+int test_flat_hash_main (unformat_input_t * input)
+{
+  test_flat_hash_main_t tm;
+  clib_error_t * error = 0;
+
+  memset (&tm, 0, sizeof (tm));
+  tm.n_iter = 100000;
+  tm.n_elts = 1000;
+  tm.seed = 1;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "iter %d", &tm.n_iter))
+        ;
+      else if (unformat (input, "elts %d", &tm.n_elts))
+        ;
+      else if (unformat (input, "seed %d", &tm.seed))
+        ;
+      else if (unformat (input, "verbose"))
+        tm.verbose = 1;
+      else
+        {
+          error = clib_error_return (0, "unknown input `%U'", format_unformat_error, input);
+          goto done;
+        }
+    }
+
+  if (tm.n_elts == 0)
+    {
+      error = clib_error_return (0, "elts must be positive");
+      goto done;
+    }
+
+  if (! tm.seed)
+    tm.seed = getpid ();
+
+  test_flat_hash_random (&tm);
+  test_flat_hash_unset_ctrl (&tm);
+  test_flat_hash_growth (&tm);
+
+  if (tm.n_errors > 0)
+    error = clib_error_return (0, "%d errors, seed %d", tm.n_errors, tm.seed);
+
+ done:
+  if (error)
+    {
+      clib_error_report (error);
+      return 1;
+    }
+  return 0;
+}
+
+int main (int argc, char * argv[])
+{
+  unformat_input_t i;
+  int ret;
+
+  unformat_init_command_line (&i, argv);
+  ret = test_flat_hash_main (&i);
+  unformat_free (&i);
+
+  return ret;
+}
@@ -0,0 +1,422 @@
+#include <uclib/uclib.h>
+
+/* Compares speed and bucket distribution of memory hash functions
+   and checks tables with HASH_FLAG_INCREMENTAL_RESIZE.  Example:
+     hash max-len 4096 iter 100000 keys 100000 log2-buckets 16 resize-ops 300000 */
+
+typedef struct {
+  u32 seed;
+
+  u32 n_iter;
+
+  /* Speed is measured for key lengths 1, 2, 4, ... up to this. */
+  u32 max_key_bytes;
+
+  /* Distribution is measured by hashing this many keys
+     into 2^log2_n_buckets buckets. */
+  u32 n_keys;
+
+  u32 log2_n_buckets;
+
+  /* Random sets and unsets of n_keys keys for incremental resize test. */
+  u32 n_resize_ops;
+} test_hash_main_t;
+
+static never_inline uword
+test_hash_jenkins (void * p, uword n_bytes, uword seed)
+{ return hash_memory (p, n_bytes, seed); }
+
+static never_inline uword
+test_hash_crc32c (void * p, uword n_bytes, uword seed)
+{ return hash_memory_crc32c (p, n_bytes, seed); }
+
+static never_inline uword
+test_hash_wide (void * p, uword n_bytes, uword seed)
+{ return hash_memory_wide (p, n_bytes, seed); }
+
+#define foreach_test_hash_function		\
+  _ (jenkins)					\
+  _ (crc32c)					\
+  _ (wide)
+
+typedef uword (test_hash_function_t) (void * p, uword n_bytes, uword seed);
+
+static void
+test_hash_speed (test_hash_main_t * tm, char * name, test_hash_function_t * f)
+{
+  u8 * v = 0;
+  uword i, l, sum = 0;
+  u64 t0, dt;
+
+  vec_resize (v, tm->max_key_bytes);
+  for (i = 0; i < vec_len (v); i++)
+    v[i] = random_u32 (&tm->seed) >> 24;
+
+  for (l = 1; l <= tm->max_key_bytes; l *= 2)
+    {
+      t0 = clib_cpu_time_now ();
+      for (i = 0; i < tm->n_iter; i++)
+	sum += f (v, l, sum);
+      dt = clib_cpu_time_now () - t0;
+
+      clib_warning ("%s: len %d, %.2f clocks/call, %.2f bytes/clock",
+		    name, l, (f64) dt / tm->n_iter,
+		    (f64) l * tm->n_iter / (dt ? dt : 1));
+    }
+
+  vec_free (v);
+}
+
+/* Number of keys expected to land in an already occupied bucket
+   for a uniformly random hash. */
+static f64 expected_collisions (uword n_keys, uword n_buckets)
+{
+  f64 x = 1 - 1. / n_buckets, p = 1;
+  uword n;
+
+  /* p = x^n_keys */
+  for (n = n_keys; n; n >>= 1, x *= x)
+    if (n & 1)
+      p *= x;
+
+  return n_keys - n_buckets * (1 - p);
+}
+
+static void
+test_hash_distribution (test_hash_main_t * tm, char * name, test_hash_function_t * f)
+{
+  uword * used = 0;
+  u8 key[16];
+  uword i, k, b, n_collisions[2] = {0};
+  uword mask = pow2_mask (tm->log2_n_buckets);
+
+  for (k = 0; k < 2; k++)
+    {
+      clib_bitmap_zero (used);
+      for (i = 0; i < tm->n_keys; i++)
+	{
+	  if (k == 0)
+	    {
+	      /* Sequential integers: worst case for weak mixing. */
+	      memset (key, 0, sizeof (key));
+	      memcpy (key, &i, sizeof (i));
+	    }
+	  else
+	    /* Use high bits: low bits of random_u32 have short periods. */
+	    for (b = 0; b < sizeof (key); b++)
+	      key[b] = random_u32 (&tm->seed) >> 24;
+
+	  b = f (key, sizeof (key), 0) & mask;
+	  n_collisions[k] += clib_bitmap_get (used, b);
+	  used = clib_bitmap_set (used, b, 1);
+	}
+    }
+
+  clib_warning ("%s: %d keys, %d buckets: sequential %d, random %d collisions (%.0f expected)",
+		name, tm->n_keys, mask + 1, n_collisions[0], n_collisions[1],
+		expected_collisions (tm->n_keys, mask + 1));
+
+  clib_bitmap_free (used);
+}
+
+/* Known answer for CRC-32C and check that wide hash neither reads past
+   end of key nor ignores any key byte. */
+static uword test_hash_check (test_hash_main_t * tm)
+{
+  u8 buf[64 + 1];
+  uword n_errors = 0, i, l;
+  u64 h0;
+
+  if (hash_memory_crc32c ("123456789", 9, 0) != 0xe3069283)
+    {
+      clib_warning ("crc32c: check value mismatch 0x%x",
+		    hash_memory_crc32c ("123456789", 9, 0));
+      n_errors++;
+    }
+
+  for (l = 0; l < sizeof (buf) - 1; l++)
+    {
+      for (i = 0; i < sizeof (buf); i++)
+	buf[i] = random_u32 (&tm->seed) >> 24;
+
+      h0 = hash_memory_wide (buf, l, 0);
+
+      buf[l] ^= 1;
+      n_errors += h0 != hash_memory_wide (buf, l, 0);
+
+      for (i = 0; i < l; i++)
+	{
+	  buf[i] ^= 1;
+	  n_errors += h0 == hash_memory_wide (buf, l, 0);
+	  buf[i] ^= 1;
+	}
+    }
+
+  if (n_errors > 0)
+    clib_warning ("%d check errors", n_errors);
+
+  return n_errors;
+}
+
+/* Each key of table must be seen exactly once with value from reference. */
+static uword
+test_hash_check_pairs (void * h, uword * present, uword * values)
+{
+  hash_next_t hn;
+  hash_pair_t * p;
+  uword * seen = 0, n_errors = 0, n_seen = 0;
+
+  hash_foreach_pair (p, h, ({
+    n_errors += ! clib_bitmap_get (present, p->key) || p->value[0] != values[p->key];
+    n_errors += clib_bitmap_get (seen, p->key);
+    seen = clib_bitmap_ori (seen, p->key);
+    n_seen++;
+  }));
+  n_errors += n_seen != hash_elts (h);
+
+  clib_bitmap_zero (seen);
+  n_seen = 0;
+  memset (&hn, 0, sizeof (hn));
+  while ((p = hash_next (h, &hn)))
+    {
+      n_errors += ! clib_bitmap_get (present, p->key) || p->value[0] != values[p->key];
+      n_errors += clib_bitmap_get (seen, p->key);
+      seen = clib_bitmap_ori (seen, p->key);
+      n_seen++;
+    }
+  n_errors += n_seen != hash_elts (h);
+
+  clib_bitmap_free (seen);
+  return n_errors;
+}
+
+/* Batch lookups must give same results as one by one lookups.  Batch
+   sizes cover full batches and tails; about half the keys are missing. */
+static uword
+test_hash_check_get_multi (test_hash_main_t * tm, uword * h, mhash_t * mh)
+{
+  uword keys[3 * 16 + 7], * results[ARRAY_LEN (keys)];
+  u32 mkeys[ARRAY_LEN (keys)];
+  void * mkey_ptrs[ARRAY_LEN (keys)];
+  uword i, n, n_errors = 0;
+
+  n = 1 + (random_u32 (&tm->seed) >> 8) % ARRAY_LEN (keys);
+  for (i = 0; i < n; i++)
+    {
+      keys[i] = (random_u32 (&tm->seed) >> 8) % (2 * tm->n_keys);
+      mkeys[i] = keys[i];
+      mkey_ptrs[i] = &mkeys[i];
+    }
+
+  hash_get_multi (h, keys, n, results);
+  for (i = 0; i < n; i++)
+    n_errors += results[i] != hash_get (h, keys[i]);
+
+  mhash_get_multi (mh, mkey_ptrs, n, results);
+  for (i = 0; i < n; i++)
+    n_errors += results[i] != mhash_get (mh, &mkeys[i]);
+
+  return n_errors;
+}
+
+/* Updates value of every key with hash_set inside hash_foreach while a
+   resize is in progress: walk must see each key exactly once. */
+static uword
+test_hash_check_foreach_update (uword * h, uword * present, uword * values)
+{
+  uword * seen = 0, key, value, n_seen = 0, n_errors = 0, old_bucket;
+
+  old_bucket = hash_header (h)->resize_old_bucket;
+  hash_foreach (key, value, h, ({
+    n_errors += (clib_bitmap_get (seen, key) || ! clib_bitmap_get (present, key)
+		 || value != values[key]);
+    seen = clib_bitmap_ori (seen, key);
+    n_seen++;
+    values[key] += 1;
+    hash_set (h, key, values[key]);
+  }));
+
+  n_errors += n_seen != clib_bitmap_count_set_bits (present);
+  n_errors += (hash_header (h)->flags & HASH_FLAG_HASH_NEXT_IN_PROGRESS) != 0;
+  n_errors += hash_header (h)->resize_old_bucket != old_bucket;
+  clib_bitmap_free (seen);
+  return n_errors;
+}
+
+/* Random sets and unsets on table with HASH_FLAG_INCREMENTAL_RESIZE
+   (and an mhash_t of same keys) checked against a reference after each
+   one and, while a resize is in progress, iteration with
+   hash_foreach_pair and hash_next and batch lookups. */
+static uword
+test_hash_incremental_resize (test_hash_main_t * tm)
+{
+  uword * h, * present = 0, * values = 0, * p;
+  uword i, key, n_present = 0, n_errors = 0, n_iterations_mid_resize = 0;
+  uword n_get_multi_mid_resize = 0;
+  u64 t, dt, max_set_clocks = 0;
+  mhash_t mh;
+  u32 mkey;
+
+  h = hash_create (0, sizeof (uword));
+  hash_set_flags (h, HASH_FLAG_INCREMENTAL_RESIZE);
+  mhash_init (&mh, sizeof (uword), sizeof (mkey));
+  hash_set_flags (mh.hash, HASH_FLAG_INCREMENTAL_RESIZE);
+  vec_resize (values, tm->n_keys);
+
+  for (i = 0; i < tm->n_resize_ops; i++)
+    {
+      key = (random_u32 (&tm->seed) >> 8) % tm->n_keys;
+      mkey = key;
+
+      /* More sets than unsets so that table grows. */
+      if ((random_u32 (&tm->seed) >> 24) < 160)
+	{
+	  t = clib_cpu_time_now ();
+	  hash_set (h, key, i);
+	  dt = clib_cpu_time_now () - t;
+	  max_set_clocks = clib_max (max_set_clocks, dt);
+	  mhash_set (&mh, &mkey, i, 0);
+
+	  n_present += ! clib_bitmap_get (present, key);
+	  present = clib_bitmap_ori (present, key);
+	  values[key] = i;
+	}
+      else
+	{
+	  hash_unset (h, key);
+	  mhash_unset (&mh, &mkey, 0);
+	  n_present -= clib_bitmap_get (present, key);
+	  present = clib_bitmap_andnoti (present, key);
+	}
+
+      p = hash_get (h, key);
+      n_errors += clib_bitmap_get (present, key) ? ! p || p[0] != values[key] : p != 0;
+      n_errors += hash_elts (h) != n_present;
+      p = mhash_get (&mh, &mkey);
+      n_errors += clib_bitmap_get (present, key) ? ! p || p[0] != values[key] : p != 0;
+      n_errors += mhash_elts (&mh) != n_present;
+
+      if (hash_header (h)->resize_old_table || hash_header (mh.hash)->resize_old_table)
+	{
+	  n_errors += test_hash_check_get_multi (tm, h, &mh);
+	  n_get_multi_mid_resize++;
+	}
+      else if ((i % 64) == 0)
+	n_errors += test_hash_check_get_multi (tm, h, &mh);
+
+      /* Iteration over both tables is linear: check now and then. */
+      if (hash_header (h)->resize_old_table && (i % 64) == 0 && n_iterations_mid_resize < 256)
+	{
+	  n_errors += test_hash_check_pairs (h, present, values);
+	  n_errors += test_hash_check_foreach_update (h, present, values);
+	  n_iterations_mid_resize++;
+	}
+    }
+
+  n_errors += test_hash_check_pairs (h, present, values);
+
+  clib_warning ("incremental resize: %d ops, %d keys, %d iterations and %d batch lookups mid-resize, max set %Ld clocks",
+		tm->n_resize_ops, n_present, n_iterations_mid_resize, n_get_multi_mid_resize,
+		max_set_clocks);
+
+  if (tm->n_resize_ops >= 2 * tm->n_keys
+      && (n_iterations_mid_resize == 0 || n_get_multi_mid_resize == 0))
+    {
+      clib_warning ("incremental resize: no resize in progress seen");
+      n_errors++;
+    }
+
+  if (n_errors > 0)
+    clib_warning ("incremental resize: %d errors", n_errors);
+
+  hash_free (h);
+  mhash_free (&mh);
+  clib_bitmap_free (present);
+  vec_free (values);
+
+  return n_errors;
+}
+
+int test_hash_functions_main (unformat_input_t * input)
+{
+  test_hash_main_t tm;
+  clib_error_t * error = 0;
+
+  memset (&tm, 0, sizeof (tm));
+  tm.seed = 1;
+  tm.n_iter = 100000;
+  tm.max_key_bytes = 1024;
+  tm.n_keys = 100000;
+  tm.log2_n_buckets = 17;
+  tm.n_resize_ops = 300000;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "seed %d", &tm.seed))
+        ;
+      else if (unformat (input, "iter %d", &tm.n_iter))
+        ;
+      else if (unformat (input, "max-len %d", &tm.max_key_bytes))
+        ;
+      else if (unformat (input, "keys %d", &tm.n_keys))
+        ;
+      else if (unformat (input, "log2-buckets %d", &tm.log2_n_buckets))
+        ;
+      else if (unformat (input, "resize-ops %d", &tm.n_resize_ops))
+        ;
+      else
+        {
+          error = clib_error_return (0, "unknown input `%U'", format_unformat_error, input);
+          goto done;
+        }
+    }
+
+  if (! tm.seed)
+    tm.seed = getpid ();
+
+  if (tm.log2_n_buckets >= BITS (uword))
+    {
+      error = clib_error_return (0, "log2-buckets must be less than %d", BITS (uword));
+      goto done;
+    }
+
+  if (test_hash_check (&tm))
+    {
+      error = clib_error_return (0, "hash functions fail checks");
+      goto done;
+    }
+
+  if (tm.n_keys > 0 && test_hash_incremental_resize (&tm))
+    {
+      error = clib_error_return (0, "incremental resize fails checks");
+      goto done;
+    }
+
+#define _(f) test_hash_speed (&tm, #f, test_hash_##f);
+  foreach_test_hash_function
+#undef _
+
+#define _(f) test_hash_distribution (&tm, #f, test_hash_##f);
+  foreach_test_hash_function
+#undef _
+
+ done:
+  if (error)
+    {
+      clib_error_report (error);
+      return 1;
+    }
+  return 0;
+}
+
+int main (int argc, char * argv[])
+{
+  unformat_input_t i;
+  int ret;
+
+  unformat_init_command_line (&i, argv);
+  ret = test_hash_functions_main (&i);
+  unformat_free (&i);
+
+  return ret;
+}
@@ -0,0 +1,214 @@
+#include <uclib/uclib.h>
+#include "test.h"
+
+/* Checks mhash_t with fixed size, c-string and vector string keys
+   against a reference through random sets and unsets, including
+   compaction of key vector.  Example:
+     mhash iter 100000 keys 4096 seed 1 */
+
+typedef struct {
+  u32 n_iter;
+  u32 n_keys;
+  u32 seed;
+
+  /* Key vector compactions seen by last run. */
+  uword n_compactions;
+
+  u32 n_errors;
+} test_mhash_main_t;
+
+typedef struct {
+  u32 a, b, c;
+} test_mhash_fixed_key_t;
+
+/* Key number i of given type.  String keys have varying lengths so
+   that key vector holds differently padded keys.  Returned vector
+   holds key bytes including trailing null for c-strings. */
+static u8 *
+test_mhash_key (u8 * k, uword n_key_bytes, uword i)
+{
+  vec_reset_length (k);
+  if (n_key_bytes == MHASH_C_STRING_KEY || n_key_bytes == MHASH_VEC_STRING_KEY)
+    {
+      uword l = i % 200;
+      k = format (k, "key%d-", i);
+      while (l-- > 0)
+	vec_add1 (k, 'a' + (i + l) % 26);
+      if (n_key_bytes == MHASH_C_STRING_KEY)
+	vec_add1 (k, 0);
+    }
+  else
+    {
+      test_mhash_fixed_key_t f = { .a = i, .b = i * 7, .c = ~i, };
+      vec_add (k, (u8 *) &f, sizeof (f));
+    }
+  return k;
+}
+
+/* Value encodes key number so that pairs can be checked. */
+always_inline uword
+test_mhash_value (test_mhash_main_t * tm, uword i, uword iter)
+{ return iter * tm->n_keys + i; }
+
+static void
+test_mhash_compare (test_mhash_main_t * tm, mhash_t * h, uword * present, uword * values)
+{
+  hash_pair_t * p;
+  u8 * k = 0, * m;
+  uword i, l, * seen = 0;
+
+  test_check (tm, mhash_elts (h) == clib_bitmap_count_set_bits (present));
+
+  hash_foreach_pair (p, h->hash, ({
+    i = p->value[0] % tm->n_keys;
+    test_check (tm, clib_bitmap_get (present, i) && p->value[0] == values[i]);
+    test_check (tm, ! clib_bitmap_get (seen, i));
+    seen = clib_bitmap_ori (seen, i);
+
+    k = test_mhash_key (k, h->n_key_bytes, i);
+    m = mhash_key_to_mem (h, p->key);
+    l = h->n_key_bytes == MHASH_VEC_STRING_KEY ? vec_len (m) : vec_len (k);
+    test_check (tm, l == vec_len (k) && ! memcmp (m, k, l));
+  }));
+
+  clib_bitmap_free (seen);
+  vec_free (k);
+}
+
+static void
+test_mhash_random (test_mhash_main_t * tm, uword n_key_bytes)
+{
+  mhash_t h;
+  u8 * k = 0;
+  uword * present = 0, * values = 0, * p, iter, i, was, ikey, old, value, l;
+  uword n_vector_bytes;
+  u32 seed = tm->seed;
+  void * key;
+
+  memset (&h, 0, sizeof (h));
+  mhash_init (&h, sizeof (uword), n_key_bytes);
+  vec_resize (values, tm->n_keys);
+  tm->n_compactions = 0;
+
+  for (iter = 0; iter < tm->n_iter; iter++)
+    {
+      i = (random_u32 (&seed) >> 8) % tm->n_keys;
+      k = test_mhash_key (k, n_key_bytes, i);
+      key = k;
+      was = clib_bitmap_get (present, i);
+      n_vector_bytes = vec_len (h.key_vector);
+
+      if ((random_u32 (&seed) >> 24) < 128)
+	{
+	  value = test_mhash_value (tm, i, iter);
+	  old = ~0;
+	  ikey = mhash_set (&h, key, value, &old);
+	  test_check (tm, was ? old == values[i] : old == ~0);
+
+	  /* Returned hash key points to copy of key. */
+	  l = n_key_bytes == MHASH_VEC_STRING_KEY ? vec_len (mhash_key_to_mem (&h, ikey)) : vec_len (k);
+	  test_check (tm, l == vec_len (k) && ! memcmp (mhash_key_to_mem (&h, ikey), k, l));
+
+	  present = clib_bitmap_ori (present, i);
+	  values[i] = value;
+	}
+      else
+	{
+	  old = ~0;
+	  test_check (tm, mhash_unset (&h, key, &old) == was);
+	  test_check (tm, ! was || old == values[i]);
+	  present = clib_bitmap_andnoti (present, i);
+	}
+
+      p = mhash_get (&h, key);
+      test_check (tm, clib_bitmap_get (present, i) ? p && p[0] == values[i] : p == 0);
+
+      /* Key vector only shrinks when compacted. */
+      if (vec_len (h.key_vector) < n_vector_bytes)
+	{
+	  tm->n_compactions++;
+	  test_check (tm, h.n_dead_key_bytes == 0);
+	  test_mhash_compare (tm, &h, present, values);
+	}
+      else if (iter % 1024 == 0)
+	test_mhash_compare (tm, &h, present, values);
+    }
+
+  test_mhash_compare (tm, &h, present, values);
+
+  mhash_compact_keys (&h);
+  test_check (tm, h.n_dead_key_bytes == 0);
+  test_mhash_compare (tm, &h, present, values);
+
+  clib_warning ("%s keys: %d elts, %d key vector bytes, %d compactions",
+		(n_key_bytes == MHASH_C_STRING_KEY ? "c-string"
+		 : n_key_bytes == MHASH_VEC_STRING_KEY ? "vec-string" : "fixed"),
+		mhash_elts (&h), vec_len (h.key_vector), tm->n_compactions);
+
+  mhash_free (&h);
+  clib_bitmap_free (present);
+  vec_free (values);
+  vec_free (k);
+}
+
+int test_mhash_main (unformat_input_t * input)
+{
+  test_mhash_main_t tm;
+  clib_error_t * error = 0;
+
+  memset (&tm, 0, sizeof (tm));
+  tm.n_iter = 100000;
+  tm.n_keys = 4096;
+  tm.seed = 1;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "iter %d", &tm.n_iter))
+        ;
+      else if (unformat (input, "keys %d", &tm.n_keys))
+        ;
+      else if (unformat (input, "seed %d", &tm.seed))
+        ;
+      else
+        {
+          error = clib_error_return (0, "unknown input `%U'", format_unformat_error, input);
+          goto done;
+        }
+    }
+
+  if (tm.n_keys == 0)
+    {
+      error = clib_error_return (0, "keys must be positive");
+      goto done;
+    }
+
+  if (! tm.seed)
+    tm.seed = getpid ();
+
+  test_mhash_random (&tm, sizeof (test_mhash_fixed_key_t));
+  test_mhash_random (&tm, MHASH_C_STRING_KEY);
+  test_mhash_random (&tm, MHASH_VEC_STRING_KEY);
+
+  if (tm.n_errors > 0)
+    error = clib_error_return (0, "%d errors, seed %d", tm.n_errors, tm.seed);
+
+ done:
+  if (error)
+    {
+      clib_error_report (error);
+      return 1;
+    }
+  return 0;
+}
+
+int main (int argc, char * argv[])
+{
+  unformat_input_t i;
+  int ret;
+
+  unformat_init_command_line (&i, argv);
+  ret = test_mhash_main (&i);
+  unformat_free (&i);
+
+  return ret;
+}
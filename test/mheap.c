@@ -0,0 +1,617 @@
+#include <uclib/uclib.h>
+#include "test.h"
+#include <pthread.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <signal.h>
+
+/* Checks random allocs, frees and reallocs on heaps with magazines
+   and slabs against a reference, double free detection for objects
+   held on magazines, guard mode, mheap_trim and per-cpu heaps made by
+   clib_smp_init.  Example:
+     mheap objects 1000 iter 20000 seed 1 */
+
+typedef struct {
+  u32 n_objects;
+  u32 n_iter;
+  u32 seed;
+
+  /* Objects seen by mheap_foreach callback. */
+  uword n_foreach_objects;
+
+  /* Corruption last reported by guard mode. */
+  uword n_guard_corrupt;
+  uword guard_corrupt_uoffset;
+  char * guard_corrupt_why;
+
+  volatile u32 n_errors;
+} test_mheap_main_t;
+
+static test_mheap_main_t test_mheap_main;
+
+/* Runs on temporary heap mheap_foreach makes on this cpu's stack.
+   Memory allocated here must be freed back to that heap and not to
+   cpu's heap whose VM slot also holds the stack. */
+static uword
+test_mheap_foreach_callback (void * arg, void * heap, void * elt, uword n_bytes)
+{
+  test_mheap_main_t * tm = arg;
+  u8 * v = 0;
+
+  vec_resize (v, 1 + n_bytes % 256);
+  if (clib_mem_heap_for_object (v) != clib_mem_get_heap ())
+    tm->n_errors++;
+  vec_free (v);
+
+  tm->n_foreach_objects++;
+  return 0;
+}
+
+static void *
+test_mheap_foreach_thread (void * arg)
+{
+  test_mheap_main_t * tm = &test_mheap_main;
+  void * heap = clib_mem_get_heap ();
+  void ** objects = 0;
+  uword i;
+
+  for (i = 0; i < tm->n_objects; i++)
+    vec_add1 (objects, clib_mem_alloc (1 + i % 200));
+
+  mheap_foreach (heap, test_mheap_foreach_callback, tm);
+
+  /* Every object plus objects vector itself. */
+  if (tm->n_foreach_objects < tm->n_objects + 1)
+    {
+      clib_warning ("foreach saw %wd objects, expected at least %d",
+		    tm->n_foreach_objects, tm->n_objects + 1);
+      tm->n_errors++;
+    }
+
+  for (i = 0; i < vec_len (objects); i++)
+    clib_mem_free (objects[i]);
+  vec_free (objects);
+
+  mheap_validate (heap);
+  return 0;
+}
+
+/* Live object of random test: contents are a function of seed so
+   that overlapping objects and lost bytes are found. */
+typedef struct {
+  uword offset;
+  uword n_bytes;
+  u32 seed;
+} test_mheap_object_t;
+
+always_inline u8
+test_mheap_object_byte (test_mheap_object_t * o, uword i)
+{ return o->seed + i * 7 + (i >> 8); }
+
+static void
+test_mheap_object_fill (void * heap, test_mheap_object_t * o, uword start)
+{
+  u8 * d = heap + o->offset;
+  uword i;
+  for (i = start; i < o->n_bytes; i++)
+    d[i] = test_mheap_object_byte (o, i);
+}
+
+static uword
+test_mheap_object_is_valid (void * heap, test_mheap_object_t * o)
+{
+  u8 * d = heap + o->offset;
+  uword i;
+  for (i = 0; i < o->n_bytes; i++)
+    if (d[i] != test_mheap_object_byte (o, i))
+      return 0;
+  return mheap_data_bytes (heap, o->offset) >= o->n_bytes;
+}
+
+/* Sizes from slab classes through magazine bins to large objects. */
+static uword
+test_mheap_random_size (u32 * seed)
+{
+  u32 r = random_u32 (seed);
+  switch (r >> 29)
+    {
+    case 0: case 1: case 2:
+      return 1 + (r >> 4) % MHEAP_SLAB_MAX_USER_DATA_BYTES;
+    case 3: case 4: case 5:
+      return 1 + (r >> 4) % 1024;
+    case 6:
+      return 1 + (r >> 4) % (16 << 10);
+    default:
+      return 1 + (r >> 4) % (128 << 10);
+    }
+}
+
+static void
+test_mheap_check_objects (test_mheap_main_t * tm, void * heap,
+			  test_mheap_object_t * objects, char * phase)
+{
+  test_mheap_object_t * o;
+  uword n_bad = 0;
+
+  vec_foreach (o, objects)
+    n_bad += ! test_mheap_object_is_valid (heap, o);
+  if (n_bad > 0)
+    {
+      clib_warning ("%s: %wd of %d objects corrupt", phase, n_bad, vec_len (objects));
+      tm->n_errors++;
+    }
+  mheap_validate (heap);
+}
+
+/* Grow or shrink object: in place when mheap_realloc can, else by
+   allocating and copying. */
+static void *
+test_mheap_object_resize (void * heap, test_mheap_object_t * o, uword n_bytes)
+{
+  uword offset;
+
+  if (! mheap_realloc (heap, o->offset, n_bytes))
+    {
+      heap = mheap_get (heap, n_bytes, &offset);
+      if (offset == ~0)
+	return heap;
+      memcpy (heap + offset, heap + o->offset, clib_min (n_bytes, o->n_bytes));
+      mheap_put (heap, o->offset);
+      o->offset = offset;
+    }
+
+  if (n_bytes > o->n_bytes)
+    {
+      uword start = o->n_bytes;
+      o->n_bytes = n_bytes;
+      test_mheap_object_fill (heap, o, start);
+    }
+  else
+    o->n_bytes = n_bytes;
+  return heap;
+}
+
+/* Allocate, churn with frees, allocs and reallocs, then free all,
+   validating heap and objects after each phase. */
+static void
+test_mheap_random (test_mheap_main_t * tm, char * name, uword flags)
+{
+  void * heap = mheap_alloc_with_flags (0, 256 << 20, flags);
+  test_mheap_object_t * objects = 0, * o;
+  mheap_stats_t stats;
+  uword i, j, offset;
+  u32 seed = tm->seed;
+
+  if (! heap)
+    clib_error ("%s: mheap_alloc fails", name);
+
+  for (i = 0; i < tm->n_objects; i++)
+    {
+      vec_add2 (objects, o, 1);
+      o->n_bytes = test_mheap_random_size (&seed);
+      o->seed = random_u32 (&seed);
+      heap = mheap_get (heap, o->n_bytes, &o->offset);
+      test_check (tm, o->offset != ~0);
+      test_mheap_object_fill (heap, o, 0);
+    }
+  test_mheap_check_objects (tm, heap, objects, "alloc");
+
+  for (i = 0; i < tm->n_iter; i++)
+    {
+      u32 r = random_u32 (&seed);
+
+      /* Low bits of random_u32 have short periods: use high bits. */
+      if (vec_len (objects) > 0 && (r >> 30) == 0)
+	{
+	  j = (r >> 8) % vec_len (objects);
+	  mheap_put (heap, objects[j].offset);
+	  objects[j] = objects[vec_len (objects) - 1];
+	  _vec_len (objects) -= 1;
+	}
+      else if (vec_len (objects) > 0 && (r >> 30) == 1)
+	{
+	  j = (r >> 8) % vec_len (objects);
+	  o = objects + j;
+	  /* Mostly small growth which in place realloc is for. */
+	  if (random_u32 (&seed) & 1)
+	    heap = test_mheap_object_resize (heap, o, o->n_bytes + 1 + (r >> 8) % 256);
+	  else
+	    heap = test_mheap_object_resize (heap, o, test_mheap_random_size (&seed));
+	}
+      else
+	{
+	  uword n_bytes = test_mheap_random_size (&seed);
+	  heap = mheap_get (heap, n_bytes, &offset);
+	  if (offset != ~0)
+	    {
+	      vec_add2 (objects, o, 1);
+	      o->offset = offset;
+	      o->n_bytes = n_bytes;
+	      o->seed = random_u32 (&seed);
+	      test_mheap_object_fill (heap, o, 0);
+	    }
+	}
+
+      if (i % 4096 == 0)
+	test_mheap_check_objects (tm, heap, objects, "churn");
+    }
+  test_mheap_check_objects (tm, heap, objects, "churn");
+
+  vec_foreach (o, objects)
+    mheap_put (heap, o->offset);
+  vec_reset_length (objects);
+  test_mheap_check_objects (tm, heap, objects, "free");
+
+  mheap_get_stats (heap, &stats);
+  clib_warning ("%s: %Ld magazine hits, %Ld reallocs in place, %d slab pages",
+		name, stats.n_magazine_hits, stats.n_reallocs_in_place,
+		mheap_header (heap)->n_slab_pages);
+  test_check (tm, stats.n_reallocs_in_place > 0);
+  if (flags & MHEAP_FLAG_MAGAZINES)
+    test_check (tm, stats.n_magazine_hits > 0);
+  if (flags & MHEAP_FLAG_SLAB)
+    test_check (tm, mheap_header (heap)->n_slab_pages > 0);
+
+  mheap_free (heap);
+  vec_free (objects);
+}
+
+static void
+test_mheap_guard_corrupt (void * arg, void * heap, uword uoffset, char * why)
+{
+  test_mheap_main_t * tm = arg;
+  tm->n_guard_corrupt++;
+  tm->guard_corrupt_uoffset = uoffset;
+  tm->guard_corrupt_why = why;
+}
+
+/* Guard heap must report exactly one corruption of object at given
+   offset with reason containing given string. */
+static void
+test_mheap_guard_expect (test_mheap_main_t * tm, void * heap, uword uoffset, char * what)
+{
+  if (tm->n_guard_corrupt != 1
+      || tm->guard_corrupt_uoffset != uoffset
+      || mheap_header (heap)->guard_corrupt_uoffset != uoffset
+      || ! strstr (tm->guard_corrupt_why, what))
+    {
+      clib_warning ("guard: expected %s at offset %wd; got %wd reports, last at %wd",
+		    what, uoffset, tm->n_guard_corrupt, tm->guard_corrupt_uoffset);
+      tm->n_errors++;
+    }
+  tm->n_guard_corrupt = 0;
+}
+
+/* Canary overrun, write after free while quarantined and double free
+   are each reported by guard mode through a handler instead of a
+   panic. */
+static void
+test_mheap_guard (test_mheap_main_t * tm)
+{
+  void * heap;
+  uword i, o, offsets[MHEAP_GUARD_QUARANTINE_SIZE];
+
+  mheap_guard_register_corrupt_handler (test_mheap_guard_corrupt, tm);
+
+  /* Clean churn reports nothing. */
+  heap = mheap_alloc_with_flags (0, 16 << 20, MHEAP_FLAG_GUARD);
+  for (i = 0; i < 4 * MHEAP_GUARD_QUARANTINE_SIZE; i++)
+    {
+      heap = mheap_get (heap, 1 + i % 300, &o);
+      memset (heap + o, i, mheap_data_bytes (heap, o));
+      mheap_put (heap, o);
+    }
+  mheap_validate (heap);
+  test_check (tm, tm->n_guard_corrupt == 0);
+  mheap_free (heap);
+
+  /* Write one byte past end of object. */
+  heap = mheap_alloc_with_flags (0, 16 << 20, MHEAP_FLAG_GUARD);
+  heap = mheap_get (heap, 40, &o);
+  ((u8 *) heap)[o + mheap_data_bytes (heap, o)] ^= 1;
+  mheap_put (heap, o);
+  test_mheap_guard_expect (tm, heap, o, "canary overwritten");
+  mheap_free (heap);
+
+  /* Write to object while in quarantine: found when it leaves. */
+  heap = mheap_alloc_with_flags (0, 16 << 20, MHEAP_FLAG_GUARD);
+  heap = mheap_get (heap, 64, &o);
+  for (i = 0; i < ARRAY_LEN (offsets); i++)
+    heap = mheap_get (heap, 64, &offsets[i]);
+  mheap_put (heap, o);
+  ((u8 *) heap)[o + 8] = 0;
+  for (i = 0; i < ARRAY_LEN (offsets); i++)
+    mheap_put (heap, offsets[i]);
+  test_mheap_guard_expect (tm, heap, o, "written after free");
+  mheap_free (heap);
+
+  /* Free object twice while in quarantine. */
+  heap = mheap_alloc_with_flags (0, 16 << 20, MHEAP_FLAG_GUARD);
+  heap = mheap_get (heap, 64, &o);
+  mheap_put (heap, o);
+  mheap_put (heap, o);
+  test_mheap_guard_expect (tm, heap, o, "freed twice");
+  mheap_free (heap);
+
+  mheap_guard_register_corrupt_handler (0, 0);
+}
+
+/* Zero if any page strictly inside range is resident. */
+static uword
+test_mheap_range_is_released (void * start, void * end)
+{
+  uword page_size = clib_mem_get_page_size ();
+  uword s = round_pow2 (pointer_to_uword (start), page_size);
+  uword e = pointer_to_uword (end) &~ (page_size - 1);
+  u8 * resident = 0;
+  uword i, is_released = 1;
+
+  if (e <= s)
+    return 1;
+  vec_resize (resident, (e - s) / page_size);
+  if (mincore (uword_to_pointer (s, void *), e - s, resident) < 0)
+    clib_unix_error ("mincore");
+  for (i = 0; i < vec_len (resident); i++)
+    is_released &= ! (resident[i] & 1);
+  vec_free (resident);
+  return is_released;
+}
+
+/* Bytes trimmed must be page multiple at least lower bound, counted by
+   mheap_usage and leave a valid heap. */
+static void
+test_mheap_trim_check (test_mheap_main_t * tm, char * name, void * heap,
+		       uword n_trimmed, uword min_trimmed)
+{
+  clib_mem_usage_t usage;
+
+  mheap_usage (heap, &usage);
+  clib_warning ("%s: trimmed %wd bytes, at least %wd expected", name, n_trimmed, min_trimmed);
+  test_check (tm, n_trimmed >= min_trimmed);
+  test_check (tm, n_trimmed % clib_mem_get_page_size () == 0);
+  test_check (tm, usage.bytes_trimmed == n_trimmed);
+  mheap_validate (heap);
+}
+
+/* Trim free holes and released tail of a heap in caller's memory, then
+   allocate into trimmed ranges again. */
+static void
+test_mheap_trim (test_mheap_main_t * tm)
+{
+  uword page_size = clib_mem_get_page_size ();
+  uword memory_bytes = 16 << 20, n_bytes = 64 << 10;
+  uword i, n, n_trimmed, min_trimmed, n_reused, len;
+  void * memory, * heap;
+  test_mheap_object_t objects[64], * o;
+  u32 seed = tm->seed;
+
+  memory = clib_mem_vm_alloc (memory_bytes);
+  if (! memory)
+    clib_error ("vm alloc fails");
+  heap = mheap_alloc (memory, memory_bytes);
+  test_check (tm, mheap_header (heap)->flags & MHEAP_FLAG_DISABLE_VM);
+
+  for (i = 0; i < ARRAY_LEN (objects); i++)
+    {
+      o = objects + i;
+      o->n_bytes = n_bytes;
+      o->seed = random_u32 (&seed);
+      heap = mheap_get (heap, o->n_bytes, &o->offset);
+      test_mheap_object_fill (heap, o, 0);
+    }
+
+  /* Holes between live objects in first half; free tail in second. */
+  min_trimmed = 0;
+  for (i = 0; i < ARRAY_LEN (objects) / 2; i += 2)
+    {
+      mheap_put (heap, objects[i].offset);
+      min_trimmed += n_bytes - 2 * page_size;
+    }
+  len = vec_len (heap);
+  for (i = ARRAY_LEN (objects) - 1; i >= ARRAY_LEN (objects) / 2; i--)
+    mheap_put (heap, objects[i].offset);
+  min_trimmed += len - vec_len (heap) - 2 * page_size;
+
+  n_trimmed = mheap_trim (heap, ~0);
+  test_mheap_trim_check (tm, "heap", heap, n_trimmed, min_trimmed);
+  for (i = 0; i < ARRAY_LEN (objects) / 2; i += 2)
+    test_check (tm, test_mheap_range_is_released (heap + objects[i].offset,
+						  heap + objects[i].offset + n_bytes));
+  test_check (tm, test_mheap_range_is_released (heap + vec_len (heap), heap + len));
+
+  /* Live objects are untouched; freed ones are allocated again from
+     trimmed holes and tail. */
+  n_reused = 0;
+  for (i = 0; i < ARRAY_LEN (objects); i++)
+    {
+      o = objects + i;
+      if (i % 2 == 1 && i < ARRAY_LEN (objects) / 2)
+	{
+	  test_check (tm, test_mheap_object_is_valid (heap, o));
+	  continue;
+	}
+      n = o->offset;
+      o->seed = random_u32 (&seed);
+      heap = mheap_get (heap, o->n_bytes, &o->offset);
+      n_reused += o->offset == n;
+      test_mheap_object_fill (heap, o, 0);
+    }
+  test_check (tm, n_reused > 0);
+  for (i = 0; i < ARRAY_LEN (objects); i++)
+    test_check (tm, test_mheap_object_is_valid (heap, objects + i));
+  mheap_validate (heap);
+
+  mheap_free (heap);
+  clib_mem_vm_free (memory, memory_bytes);
+
+  /* Arena: reset gives back everything. */
+  heap = mheap_alloc_with_flags (0, memory_bytes, MHEAP_FLAG_ARENA);
+  for (i = 0; i < ARRAY_LEN (objects); i++)
+    {
+      o = objects + i;
+      o->n_bytes = 1 + random_u32 (&seed) % n_bytes;
+      o->seed = random_u32 (&seed);
+      heap = mheap_get (heap, o->n_bytes, &o->offset);
+      test_mheap_object_fill (heap, o, 0);
+    }
+  len = vec_len (heap);
+  mheap_arena_reset (heap);
+
+  n_trimmed = mheap_trim (heap, ~0);
+  test_mheap_trim_check (tm, "arena", heap, n_trimmed, len - 2 * page_size);
+  test_check (tm, test_mheap_range_is_released (heap, heap + len));
+
+  /* Same allocations land at same offsets again. */
+  for (i = 0; i < ARRAY_LEN (objects); i++)
+    {
+      o = objects + i;
+      heap = mheap_get (heap, o->n_bytes, &n);
+      test_check (tm, n == o->offset);
+      o->offset = n;
+      test_mheap_object_fill (heap, o, 0);
+    }
+  for (i = 0; i < ARRAY_LEN (objects); i++)
+    test_check (tm, test_mheap_object_is_valid (heap, objects + i));
+  mheap_validate (heap);
+
+  mheap_free (heap);
+}
+
+/* Freeing and re-allocating objects through magazines must not look
+   like a double free; freeing an object held on a magazine again must
+   panic.  Double free is done in a child process. */
+static void
+test_mheap_magazine_double_free (test_mheap_main_t * tm)
+{
+  void * heap = mheap_alloc (0, 1 << 20);
+  uword i, offset, first_offset;
+  int status;
+  pid_t pid;
+
+  heap = mheap_get (heap, 24, &first_offset);
+  for (i = 0; i < 2 * MHEAP_MAGAZINE_SIZE; i++)
+    {
+      mheap_put (heap, first_offset);
+      if (! mheap_magazine_is_held (heap, first_offset))
+	{
+	  clib_warning ("freed object not on magazine");
+	  tm->n_errors++;
+	  break;
+	}
+      heap = mheap_get (heap, 24, &offset);
+      if (offset != first_offset || mheap_magazine_is_held (heap, offset))
+	{
+	  clib_warning ("magazine did not hand back freed object");
+	  tm->n_errors++;
+	  break;
+	}
+    }
+  mheap_validate (heap);
+
+  pid = fork ();
+  if (pid < 0)
+    clib_unix_error ("fork");
+  if (pid == 0)
+    {
+      mheap_put (heap, first_offset);
+      mheap_put (heap, first_offset);
+      _exit (0);
+    }
+
+  if (waitpid (pid, &status, 0) != pid)
+    clib_unix_error ("waitpid");
+  if (! WIFSIGNALED (status) || WTERMSIG (status) != SIGABRT)
+    {
+      clib_warning ("double free of object on magazine not detected");
+      tm->n_errors++;
+    }
+
+  mheap_free (heap);
+}
+
+/* Run function on cpu 0's stack as clib_smp_init laid it out. */
+static void
+test_mheap_run_on_cpu0 (void * (* f) (void *))
+{
+  clib_smp_main_t * m = &clib_smp_main;
+  pthread_attr_t attr;
+  pthread_t thread;
+
+  pthread_attr_init (&attr);
+  pthread_attr_setstack (&attr, clib_smp_stack_start_for_cpu (m, 0),
+			 (uword) 1 << m->log2_n_per_cpu_stack_bytes);
+  if (pthread_create (&thread, &attr, f, 0))
+    clib_unix_error ("pthread_create");
+  pthread_join (thread, 0);
+  pthread_attr_destroy (&attr);
+}
+
+int test_mheap_main_function (unformat_input_t * input)
+{
+  test_mheap_main_t * tm = &test_mheap_main;
+  clib_smp_main_t * m = &clib_smp_main;
+  clib_error_t * error = 0;
+
+  tm->n_objects = 1000;
+  tm->n_iter = 20000;
+  tm->seed = 1;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "objects %d", &tm->n_objects))
+        ;
+      else if (unformat (input, "iter %d", &tm->n_iter))
+        ;
+      else if (unformat (input, "seed %d", &tm->seed))
+        ;
+      else
+        {
+          error = clib_error_return (0, "unknown input `%U'", format_unformat_error, input);
+          goto done;
+        }
+    }
+
+  if (! tm->seed)
+    tm->seed = getpid ();
+
+  /* Magazines are per-cpu: run before clib_smp_init while this thread
+     is cpu 0. */
+  test_mheap_random (tm, "magazines", mheap_default_flags (0));
+  test_mheap_random (tm, "slab", MHEAP_FLAG_SLAB);
+  test_mheap_random (tm, "plain", 0);
+  test_mheap_magazine_double_free (tm);
+  test_mheap_guard (tm);
+  test_mheap_trim (tm);
+
+  /* Input was allocated on heap that clib_smp_init replaces. */
+  unformat_free (input);
+
+  m->n_cpus = 1;
+  clib_smp_init ();
+
+  test_mheap_run_on_cpu0 (test_mheap_foreach_thread);
+  clib_warning ("foreach: %wd objects", tm->n_foreach_objects);
+
+  if (tm->n_errors > 0)
+    error = clib_error_return (0, "%d errors, seed %d", tm->n_errors, tm->seed);
+
+ done:
+  if (error)
+    {
+      clib_error_report (error);
+      return 1;
+    }
+  return 0;
+}
+
+int main (int argc, char * argv[])
+{
+  unformat_input_t i;
+  int ret;
+
+  unformat_init_command_line (&i, argv);
+  ret = test_mheap_main_function (&i);
+  unformat_free (&i);
+
+  return ret;
+}
@@ -0,0 +1,392 @@
+#include <uclib/uclib.h>
+#include "test.h"
+
+/* Builds clib_perfect_hash_t tables from hash and mhash tables of
+   each key type, checks lookups before and after a serialize round
+   trip and checks that corrupted tables are refused.  Example:
+     perfect_hash keys 10000 */
+
+typedef enum {
+  TEST_PERFECT_HASH_HASH_UWORD,
+  TEST_PERFECT_HASH_HASH_MEM,
+  TEST_PERFECT_HASH_HASH_STRING,
+  TEST_PERFECT_HASH_HASH_VEC,
+  TEST_PERFECT_HASH_MHASH_FIXED,
+  TEST_PERFECT_HASH_MHASH_C_STRING,
+  TEST_PERFECT_HASH_MHASH_VEC_STRING,
+  TEST_PERFECT_HASH_N_SOURCE,
+} test_perfect_hash_source_t;
+
+static char * test_perfect_hash_source_names[] = {
+  [TEST_PERFECT_HASH_HASH_UWORD] = "hash uword",
+  [TEST_PERFECT_HASH_HASH_MEM] = "hash mem",
+  [TEST_PERFECT_HASH_HASH_STRING] = "hash string",
+  [TEST_PERFECT_HASH_HASH_VEC] = "hash vec",
+  [TEST_PERFECT_HASH_MHASH_FIXED] = "mhash fixed",
+  [TEST_PERFECT_HASH_MHASH_C_STRING] = "mhash c-string",
+  [TEST_PERFECT_HASH_MHASH_VEC_STRING] = "mhash vec-string",
+};
+
+typedef struct {
+  u32 n_keys;
+  u32 verbose;
+  u32 n_errors;
+} test_perfect_hash_main_t;
+
+typedef struct {
+  u32 a, b, c;
+} test_perfect_hash_fixed_key_t;
+
+always_inline uword
+test_perfect_hash_is_c_string (test_perfect_hash_source_t s)
+{ return s == TEST_PERFECT_HASH_HASH_STRING || s == TEST_PERFECT_HASH_MHASH_C_STRING; }
+
+/* Key number i as vector of key bytes; c-strings include trailing null. */
+static u8 *
+test_perfect_hash_key (test_perfect_hash_source_t s, uword i)
+{
+  u8 * k = 0;
+
+  switch (s)
+    {
+    case TEST_PERFECT_HASH_HASH_MEM:
+    case TEST_PERFECT_HASH_MHASH_FIXED:
+      {
+	test_perfect_hash_fixed_key_t f = { .a = i, .b = i * 7, .c = ~i, };
+	vec_add (k, (u8 *) &f, sizeof (f));
+      }
+      break;
+
+    default:
+      {
+	uword l;
+	k = format (k, "key%d", i);
+	for (l = 0; l < i % 13; l++)
+	  vec_add1 (k, 'a' + l);
+      }
+      if (test_perfect_hash_is_c_string (s))
+	vec_add1 (k, 0);
+      break;
+    }
+
+  return k;
+}
+
+always_inline uword
+test_perfect_hash_value (uword i)
+{ return 3 * i + 1; }
+
+static uword *
+test_perfect_hash_get (clib_perfect_hash_t * ph, test_perfect_hash_source_t s, u8 * k, uword i)
+{
+  return (s == TEST_PERFECT_HASH_HASH_UWORD
+	  ? clib_perfect_hash_get (ph, i)
+	  : clib_perfect_hash_get_mem (ph, k));
+}
+
+/* All keys 0 .. n_keys - 1 are found with their values; keys after
+   that are not. */
+static void
+test_perfect_hash_lookups (test_perfect_hash_main_t * tm, clib_perfect_hash_t * ph,
+			   test_perfect_hash_source_t s)
+{
+  uword i, * v;
+  u8 * k;
+
+  test_check (tm, clib_perfect_hash_elts (ph) == tm->n_keys);
+  for (i = 0; i < 2 * tm->n_keys; i++)
+    {
+      k = test_perfect_hash_key (s, i);
+      v = test_perfect_hash_get (ph, s, k, i);
+      if (i < tm->n_keys)
+	test_check (tm, v && v[0] == test_perfect_hash_value (i));
+      else
+	test_check (tm, v == 0);
+      vec_free (k);
+    }
+}
+
+static u8 *
+test_perfect_hash_serialize (clib_perfect_hash_t * ph)
+{
+  serialize_main_t m;
+  clib_error_t * error;
+
+  serialize_open_vector (&m, 0);
+  error = serialize (&m, serialize_clib_perfect_hash, ph);
+  ASSERT (! error);
+  return serialize_close_vector (&m);
+}
+
+static clib_error_t *
+test_perfect_hash_unserialize (clib_perfect_hash_t * ph, u8 * data)
+{
+  serialize_main_t m;
+  clib_error_t * error;
+
+  unserialize_open_data (&m, data, vec_len (data));
+  error = unserialize (&m, unserialize_clib_perfect_hash, ph);
+  unserialize_close (&m);
+  return error;
+}
+
+static void
+test_perfect_hash_source (test_perfect_hash_main_t * tm, test_perfect_hash_source_t s)
+{
+  clib_perfect_hash_t ph, ph1;
+  clib_error_t * error;
+  uword i, * hash = 0;
+  u8 ** keys = 0, * data;
+  mhash_t mh;
+
+  memset (&mh, 0, sizeof (mh));
+  switch (s)
+    {
+    case TEST_PERFECT_HASH_HASH_UWORD:
+      hash = hash_create (0, sizeof (uword));
+      break;
+    case TEST_PERFECT_HASH_HASH_MEM:
+      hash = hash_create_mem (0, sizeof (test_perfect_hash_fixed_key_t), sizeof (uword));
+      break;
+    case TEST_PERFECT_HASH_HASH_STRING:
+      hash = hash_create_string (0, sizeof (uword));
+      break;
+    case TEST_PERFECT_HASH_HASH_VEC:
+      hash = hash_create_vec (0, sizeof (u8), sizeof (uword));
+      break;
+    case TEST_PERFECT_HASH_MHASH_FIXED:
+      mhash_init (&mh, sizeof (uword), sizeof (test_perfect_hash_fixed_key_t));
+      break;
+    case TEST_PERFECT_HASH_MHASH_C_STRING:
+      mhash_init_c_string (&mh, sizeof (uword));
+      break;
+    case TEST_PERFECT_HASH_MHASH_VEC_STRING:
+      mhash_init_vec_string (&mh, sizeof (uword));
+      break;
+    default:
+      ASSERT (0);
+    }
+
+  /* Hash tables keep pointers to keys. */
+  for (i = 0; i < tm->n_keys; i++)
+    {
+      u8 * k = test_perfect_hash_key (s, i);
+      vec_add1 (keys, k);
+      if (s == TEST_PERFECT_HASH_HASH_UWORD)
+	hash_set (hash, i, test_perfect_hash_value (i));
+      else if (hash)
+	hash_set_mem (hash, k, test_perfect_hash_value (i));
+      else
+	mhash_set (&mh, k, test_perfect_hash_value (i), 0);
+    }
+
+  if (hash)
+    error = clib_perfect_hash_build_from_hash (&ph, hash);
+  else
+    error = clib_perfect_hash_build_from_mhash (&ph, &mh);
+  if (error)
+    {
+      clib_error_report (error);
+      tm->n_errors++;
+      goto done;
+    }
+
+  test_perfect_hash_lookups (tm, &ph, s);
+
+  data = test_perfect_hash_serialize (&ph);
+  error = test_perfect_hash_unserialize (&ph1, data);
+  test_check (tm, ! error);
+  if (! error)
+    {
+      test_perfect_hash_lookups (tm, &ph1, s);
+      clib_perfect_hash_free (&ph1);
+    }
+  clib_error_free (error);
+
+  if (tm->verbose)
+    fformat (stdout, "%s: %U, %d bytes serialized\n",
+	     test_perfect_hash_source_names[s], format_clib_perfect_hash, &ph, vec_len (data));
+
+  vec_free (data);
+  clib_perfect_hash_free (&ph);
+
+ done:
+  hash_free (hash);
+  mhash_free (&mh);
+  for (i = 0; i < vec_len (keys); i++)
+    vec_free (keys[i]);
+  vec_free (keys);
+}
+
+typedef enum {
+  TEST_PERFECT_HASH_CORRUPT_KEY_TYPE,
+  TEST_PERFECT_HASH_CORRUPT_DIRECT_SLOT,
+  TEST_PERFECT_HASH_CORRUPT_N_BUCKETS,
+  TEST_PERFECT_HASH_CORRUPT_KEY_OFFSET,
+  TEST_PERFECT_HASH_CORRUPT_KEY_ALIGN,
+  TEST_PERFECT_HASH_CORRUPT_KEY_LENGTH,
+  TEST_PERFECT_HASH_N_CORRUPT,
+} test_perfect_hash_corrupt_t;
+
+static void
+test_perfect_hash_corrupt (clib_perfect_hash_t * ph, test_perfect_hash_corrupt_t c)
+{
+  u32 * d;
+
+  switch (c)
+    {
+    case TEST_PERFECT_HASH_CORRUPT_KEY_TYPE:
+      ph->key_type = CLIB_PERFECT_HASH_KEY_VEC + 1;
+      break;
+
+    case TEST_PERFECT_HASH_CORRUPT_DIRECT_SLOT:
+      vec_foreach (d, ph->displacements)
+	if (d[0] & CLIB_PERFECT_HASH_DIRECT)
+	  {
+	    d[0] = CLIB_PERFECT_HASH_DIRECT | vec_len (ph->slots);
+	    break;
+	  }
+      ASSERT (d < vec_end (ph->displacements));
+      break;
+
+    case TEST_PERFECT_HASH_CORRUPT_N_BUCKETS:
+      ph->n_buckets++;
+      break;
+
+    case TEST_PERFECT_HASH_CORRUPT_KEY_OFFSET:
+      ph->slots[0].key = vec_len (ph->key_data) + sizeof (u32);
+      break;
+
+    case TEST_PERFECT_HASH_CORRUPT_KEY_ALIGN:
+      ph->slots[0].key += 1;
+      break;
+
+    case TEST_PERFECT_HASH_CORRUPT_KEY_LENGTH:
+      ((u32 *) (ph->key_data + ph->slots[0].key))[-1] = vec_len (ph->key_data);
+      break;
+
+    default:
+      ASSERT (0);
+    }
+}
+
+/* Tables that would make lookups read out of bounds are refused. */
+static void
+test_perfect_hash_corrupted (test_perfect_hash_main_t * tm)
+{
+  clib_perfect_hash_t ph, ph1;
+  clib_error_t * error;
+  uword i, c, * hash;
+  u8 ** keys = 0, * data, * good;
+
+  hash = hash_create_string (0, sizeof (uword));
+  for (i = 0; i < tm->n_keys; i++)
+    {
+      u8 * k = test_perfect_hash_key (TEST_PERFECT_HASH_HASH_STRING, i);
+      vec_add1 (keys, k);
+      hash_set_mem (hash, k, test_perfect_hash_value (i));
+    }
+
+  error = clib_perfect_hash_build_from_hash (&ph, hash);
+  if (error)
+    {
+      clib_error_report (error);
+      tm->n_errors++;
+      goto done;
+    }
+  good = test_perfect_hash_serialize (&ph);
+  clib_perfect_hash_free (&ph);
+
+  for (c = 0; c < TEST_PERFECT_HASH_N_CORRUPT; c++)
+    {
+      error = test_perfect_hash_unserialize (&ph, good);
+      test_check (tm, ! error);
+      clib_error_free (error);
+
+      test_perfect_hash_corrupt (&ph, c);
+      data = test_perfect_hash_serialize (&ph);
+      clib_perfect_hash_free (&ph);
+
+      memset (&ph1, 0, sizeof (ph1));
+      error = test_perfect_hash_unserialize (&ph1, data);
+      if (! error)
+	{
+	  clib_warning ("corruption %d not detected", c);
+	  tm->n_errors++;
+	}
+      else if (tm->verbose)
+	clib_error_report (error);
+      else
+	clib_error_free (error);
+
+      /* Refused tables are left empty. */
+      test_check (tm, clib_perfect_hash_elts (&ph1) == 0);
+      clib_perfect_hash_free (&ph1);
+      vec_free (data);
+    }
+
+  vec_free (good);
+
+ done:
+  hash_free (hash);
+  for (i = 0; i < vec_len (keys); i++)
+    vec_free (keys[i]);
+  vec_free (keys);
+}
+
+int test_perfect_hash_main (unformat_input_t * input)
+{
+  test_perfect_hash_main_t tm;
+  clib_error_t * error = 0;
+  uword s;
+
+  memset (&tm, 0, sizeof (tm));
+  tm.n_keys = 10000;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "keys %d", &tm.n_keys))
+        ;
+      else if (unformat (input, "verbose"))
+        tm.verbose = 1;
+      else
+        {
+          error = clib_error_return (0, "unknown input `%U'", format_unformat_error, input);
+          goto done;
+        }
+    }
+
+  if (tm.n_keys == 0)
+    {
+      error = clib_error_return (0, "keys must be positive");
+      goto done;
+    }
+
+  for (s = 0; s < TEST_PERFECT_HASH_N_SOURCE; s++)
+    test_perfect_hash_source (&tm, s);
+
+  test_perfect_hash_corrupted (&tm);
+
+  if (tm.n_errors > 0)
+    error = clib_error_return (0, "%d errors", tm.n_errors);
+
+ done:
+  if (error)
+    {
+      clib_error_report (error);
+      return 1;
+    }
+  return 0;
+}
+
+int main (int argc, char * argv[])
+{
+  unformat_input_t i;
+  int ret;
+
+  unformat_init_command_line (&i, argv);
+  ret = test_perfect_hash_main (&i);
+  unformat_free (&i);
+
+  return ret;
+}
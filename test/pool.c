@@ -0,0 +1,278 @@
+#include <uclib/uclib.h>
+#include "test.h"
+
+/* Checks pool_get_n and pool_put_n against a reference through random
+   churn, with and without POOL_FLAG_ASCENDING, and pool_compact of
+   churned pools.  Example:
+     pool iter 10000 seed 1 */
+
+typedef struct {
+  u32 n_iter;
+  u32 seed;
+  u32 n_errors;
+} test_pool_main_t;
+
+typedef struct {
+  u32 index;
+  u32 cookie;
+} test_pool_elt_t;
+
+/* Pool must hold exactly live elements, each stamped with its index. */
+static void
+test_pool_compare (test_pool_main_t * tm, test_pool_elt_t * pool, uword * live)
+{
+  test_pool_elt_t * e;
+  uword n = 0;
+
+  pool_validate (pool);
+  test_check (tm, pool_elts (pool) == clib_bitmap_count_set_bits (live));
+
+  pool_foreach (e, pool, ({
+    test_check (tm, clib_bitmap_get (live, e - pool));
+    test_check (tm, e->index == e - pool && e->cookie == ~e->index);
+    n++;
+  }));
+  test_check (tm, n == pool_elts (pool));
+}
+
+/* Random gets and puts of up to 64 elements at once. */
+static void
+test_pool_get_put_n (test_pool_main_t * tm, uword is_ascending)
+{
+  test_pool_elt_t * pool = 0;
+  uword * live = 0, iter, i, j, n, n_free, l;
+  u32 * indices = 0, * expected = 0, * live_indices = 0;
+  u32 seed = tm->seed;
+
+  if (is_ascending)
+    pool_set_ascending (pool);
+
+  for (iter = 0; iter < tm->n_iter; iter++)
+    {
+      n = 1 + (random_u32 (&seed) >> 8) % 64;
+
+      /* Slightly more gets than puts so that pool grows. */
+      if ((random_u32 (&seed) >> 24) < 112 && vec_len (live_indices) > 0)
+	{
+	  n = clib_min (n, vec_len (live_indices));
+	  vec_reset_length (indices);
+	  for (i = 0; i < n; i++)
+	    {
+	      j = (random_u32 (&seed) >> 8) % vec_len (live_indices);
+	      vec_add1 (indices, live_indices[j]);
+	      live = clib_bitmap_andnoti (live, live_indices[j]);
+	      live_indices[j] = live_indices[vec_len (live_indices) - 1];
+	      _vec_len (live_indices) -= 1;
+	    }
+	  pool_put_n (pool, indices, n);
+	}
+      else
+	{
+	  /* Free indices are used before pool grows; with
+	     POOL_FLAG_ASCENDING lowest first. */
+	  l = vec_len (pool);
+	  n_free = l - clib_bitmap_count_set_bits (live);
+	  vec_reset_length (expected);
+	  for (i = 0; i < l && vec_len (expected) < n; i++)
+	    if (! clib_bitmap_get (live, i))
+	      vec_add1 (expected, i);
+	  for (i = 0; vec_len (expected) < n; i++)
+	    vec_add1 (expected, l + i);
+
+	  vec_validate (indices, n - 1);
+	  pool_get_n (pool, indices, n);
+
+	  test_check (tm, vec_len (pool) == l + (n > n_free ? n - n_free : 0));
+	  if (is_ascending)
+	    test_check (tm, ! memcmp (indices, expected, n * sizeof (indices[0])));
+
+	  for (i = 0; i < n; i++)
+	    {
+	      test_check (tm, indices[i] < vec_len (pool));
+	      test_check (tm, ! clib_bitmap_get (live, indices[i]));
+	      test_check (tm, ! pool_is_free_index (pool, indices[i]));
+	      live = clib_bitmap_ori (live, indices[i]);
+	      vec_add1 (live_indices, indices[i]);
+	      pool[indices[i]].index = indices[i];
+	      pool[indices[i]].cookie = ~indices[i];
+	    }
+	}
+
+      test_check (tm, pool_elts (pool) == vec_len (live_indices));
+      if (iter % 256 == 0)
+	test_pool_compare (tm, pool, live);
+    }
+
+  test_pool_compare (tm, pool, live);
+
+  /* After churn single gets still hand out lowest free index first. */
+  if (is_ascending)
+    {
+      test_pool_elt_t * e;
+      word last = -1;
+
+      n_free = pool_free_elts (pool);
+      for (i = 0; i < n_free; i++)
+	{
+	  pool_get (pool, e);
+	  test_check (tm, (word) (e - pool) > last);
+	  test_check (tm, ! clib_bitmap_get (live, e - pool));
+	  last = e - pool;
+	}
+      test_check (tm, pool_elts (pool) == vec_len (pool));
+    }
+
+  pool_free (pool);
+  clib_bitmap_free (live);
+  vec_free (indices);
+  vec_free (expected);
+  vec_free (live_indices);
+}
+
+/* Builds remap vector from moves reported by pool_compact_with_function. */
+static void
+test_pool_compact_function (void * arg, uword old_index, uword new_index)
+{
+  u32 * remap = arg;
+
+  ASSERT (old_index < vec_len (remap) && remap[old_index] == old_index);
+  remap[old_index] = new_index;
+}
+
+/* Compacted pool holds same elements with no holes; remap sends each
+   old index to where its element went. */
+static void
+test_pool_compact (test_pool_main_t * tm, uword use_function, uword align)
+{
+  test_pool_elt_t * pool = 0, * e;
+  uword * live_ids = 0, i, n, l, n_live, iter;
+  u32 * remap = 0, * old_ids = 0, id = 0;
+  u32 seed = tm->seed;
+
+  /* Churn: elements are tagged with unique ids. */
+  for (iter = 0; iter < tm->n_iter; iter++)
+    {
+      if ((random_u32 (&seed) >> 24) < 96 && pool_elts (pool) > 0)
+	{
+	  i = (random_u32 (&seed) >> 8) % vec_len (pool);
+	  if (! pool_is_free_index (pool, i))
+	    pool_put_index (pool, i);
+	}
+      else
+	{
+	  pool_get_aligned (pool, e, align);
+	  e->index = e - pool;
+	  e->cookie = id++;
+	}
+    }
+
+  l = vec_len (pool);
+  n_live = pool_elts (pool);
+  vec_resize (old_ids, l);
+  for (i = 0; i < l; i++)
+    old_ids[i] = pool_is_free_index (pool, i) ? ~0 : pool[i].cookie;
+
+  if (use_function)
+    {
+      vec_resize (remap, l);
+      for (i = 0; i < l; i++)
+	remap[i] = old_ids[i] == ~0 ? ~0 : i;
+      pool_compact_with_function_aligned (pool, test_pool_compact_function, remap, align);
+    }
+  else
+    pool_compact_aligned (pool, &remap, align);
+
+  test_check (tm, vec_len (pool) == n_live && pool_elts (pool) == n_live);
+  test_check (tm, pool_free_elts (pool) == 0);
+  test_check (tm, align == 0 || pointer_to_uword (pool) % align == 0);
+  test_check (tm, vec_len (remap) == l);
+
+  for (i = 0; i < l; i++)
+    {
+      if (old_ids[i] == ~0)
+	test_check (tm, remap[i] == ~0);
+      else
+	{
+	  test_check (tm, remap[i] < n_live);
+	  test_check (tm, pool[remap[i]].cookie == old_ids[i]);
+	  /* Elements that already fit do not move. */
+	  test_check (tm, i >= n_live || remap[i] == i);
+	}
+    }
+
+  /* Iteration visits same elements as before compaction. */
+  n = 0;
+  pool_foreach (e, pool, ({
+    test_check (tm, old_ids[e->index] == e->cookie);
+    test_check (tm, remap[e->index] == e - pool);
+    test_check (tm, ! clib_bitmap_get (live_ids, e->cookie));
+    live_ids = clib_bitmap_ori (live_ids, e->cookie);
+    n++;
+  }));
+  test_check (tm, n == n_live);
+
+  /* Pool grows from end again. */
+  pool_get_aligned (pool, e, align);
+  test_check (tm, e - pool == n_live);
+
+  pool_free (pool);
+  clib_bitmap_free (live_ids);
+  vec_free (remap);
+  vec_free (old_ids);
+}
+
+int test_pool_main (unformat_input_t * input)
+{
+  test_pool_main_t tm;
+  clib_error_t * error = 0;
+
+  memset (&tm, 0, sizeof (tm));
+  tm.n_iter = 10000;
+  tm.seed = 1;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "iter %d", &tm.n_iter))
+        ;
+      else if (unformat (input, "seed %d", &tm.seed))
+        ;
+      else
+        {
+          error = clib_error_return (0, "unknown input `%U'", format_unformat_error, input);
+          goto done;
+        }
+    }
+
+  if (! tm.seed)
+    tm.seed = getpid ();
+
+  test_pool_get_put_n (&tm, /* is_ascending */ 0);
+  test_pool_get_put_n (&tm, /* is_ascending */ 1);
+  test_pool_compact (&tm, /* use_function */ 0, /* align */ 0);
+  test_pool_compact (&tm, /* use_function */ 1, /* align */ 0);
+  test_pool_compact (&tm, /* use_function */ 0, CLIB_CACHE_LINE_BYTES);
+  test_pool_compact (&tm, /* use_function */ 1, CLIB_CACHE_LINE_BYTES);
+
+  if (tm.n_errors > 0)
+    error = clib_error_return (0, "%d errors, seed %d", tm.n_errors, tm.seed);
+
+ done:
+  if (error)
+    {
+      clib_error_report (error);
+      return 1;
+    }
+  return 0;
+}
+
+int main (int argc, char * argv[])
+{
+  unformat_input_t i;
+  int ret;
+
+  unformat_init_command_line (&i, argv);
+  ret = test_pool_main (&i);
+  unformat_free (&i);
+
+  return ret;
+}
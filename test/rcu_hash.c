@@ -0,0 +1,316 @@
+#include <uclib/uclib.h>
+#include <pthread.h>
+
+/* Runs readers doing lookups against one writer doing sets and unsets
+   (which also resize table) of clib_rcu_hash_t.  Checks that readers
+   never see torn values and that retired memory stays bounded.
+   Example:
+     rcu_hash ops 300000 keys 100000 readers 3 */
+
+typedef struct {
+  /* Writer sets and unsets per run. */
+  u32 n_ops;
+
+  /* Keys are 0 .. n_keys - 1. */
+  u32 n_keys;
+
+  /* Runs are made with 1 .. n_readers readers. */
+  u32 n_readers;
+
+  u32 seed;
+
+  /* Online cpus from OS.  With more threads than cpus readers yield
+     between lookups so that they are rarely preempted while reading. */
+  u32 n_os_cpus;
+  u32 yield_when_waiting;
+
+  clib_rcu_hash_t hash;
+
+  /* Threads wait for go before starting; readers stop once writer is done. */
+  volatile u32 n_ready, go, writer_done;
+
+  /* Lookups made by each reader.  Each reader stores its count once
+     before exiting; pthread_join orders it before main thread reads. */
+  uword * n_lookups_per_reader;
+
+  /* Largest number of retired objects seen by writer. */
+  uword max_retired;
+  uword n_resizes;
+
+  volatile u32 n_errors;
+} test_rcu_hash_main_t;
+
+static test_rcu_hash_main_t test_rcu_hash_main;
+
+/* Values carry the writer's sequence number in one half and a check
+   of key and sequence in other half so torn values can be detected. */
+#define TEST_RCU_HASH_HALF_BITS (BITS (uword) / 2)
+
+always_inline uword
+test_rcu_hash_check_bits (uword key, uword seq)
+{ return (key * 0x9e3779b1 ^ seq) & pow2_mask (TEST_RCU_HASH_HALF_BITS); }
+
+always_inline uword
+test_rcu_hash_value (uword key, uword seq)
+{
+  seq &= pow2_mask (TEST_RCU_HASH_HALF_BITS);
+  return (seq << TEST_RCU_HASH_HALF_BITS) | test_rcu_hash_check_bits (key, seq);
+}
+
+always_inline uword
+test_rcu_hash_value_is_valid (uword key, uword value)
+{
+  uword seq = value >> TEST_RCU_HASH_HALF_BITS;
+  return value == test_rcu_hash_value (key, seq);
+}
+
+static void
+test_rcu_hash_writer (test_rcu_hash_main_t * tm)
+{
+  clib_rcu_hash_t * h = &tm->hash;
+  uword * present = 0, * values = 0;
+  uword i, key, value, old, was, was_present, is_set, n_present = 0, bucket_mask;
+  u32 seed = tm->seed;
+
+  vec_resize (values, tm->n_keys);
+  bucket_mask = h->table->bucket_mask;
+
+  for (i = 0; i < tm->n_ops; i++)
+    {
+      key = (random_u32 (&seed) >> 8) % tm->n_keys;
+      was_present = clib_bitmap_get (present, key);
+
+      /* More sets than unsets so that table grows. */
+      is_set = (random_u32 (&seed) >> 24) < 160;
+      if (is_set)
+	{
+	  value = test_rcu_hash_value (key, i);
+	  was = clib_rcu_hash_set (h, key, value, &old);
+	  present = clib_bitmap_ori (present, key);
+	  n_present += ! was_present;
+	}
+      else
+	{
+	  value = 0;
+	  was = clib_rcu_hash_unset (h, key, &old);
+	  present = clib_bitmap_andnoti (present, key);
+	  n_present -= was_present;
+	}
+
+      if (was != was_present || (was && old != values[key]))
+	tm->n_errors++;
+      values[key] = value;
+
+      tm->max_retired = clib_max (tm->max_retired, vec_len (h->retired));
+      if (h->table->bucket_mask != bucket_mask)
+	{
+	  bucket_mask = h->table->bucket_mask;
+	  tm->n_resizes++;
+	}
+
+      if (tm->yield_when_waiting && (i % 64) == 0)
+	os_sched_yield ();
+    }
+
+  if (clib_rcu_hash_elts (h) != n_present)
+    {
+      clib_warning ("writer: %wd elts expected %wd", clib_rcu_hash_elts (h), n_present);
+      tm->n_errors++;
+    }
+
+  clib_bitmap_free (present);
+  vec_free (values);
+}
+
+static void
+test_rcu_hash_reader (test_rcu_hash_main_t * tm, uword reader)
+{
+  clib_rcu_hash_t * h = &tm->hash;
+  uword key, * p, n_lookups = 0, n_errors = 0;
+  u32 seed = tm->seed + reader;
+
+  while (! tm->writer_done)
+    {
+      key = (random_u32 (&seed) >> 8) % tm->n_keys;
+
+      clib_rcu_hash_reader_enter (h);
+      p = clib_rcu_hash_get (h, key);
+      if (p && ! test_rcu_hash_value_is_valid (key, p[0]))
+	n_errors++;
+      clib_rcu_hash_reader_exit (h);
+
+      n_lookups++;
+      if (tm->yield_when_waiting)
+	os_sched_yield ();
+    }
+
+  tm->n_lookups_per_reader[reader] = n_lookups;
+  if (n_errors > 0)
+    {
+      clib_warning ("reader %d: %wd torn values", reader, n_errors);
+      clib_smp_atomic_add (&tm->n_errors, n_errors);
+    }
+}
+
+static void *
+test_rcu_hash_thread (void * arg)
+{
+  test_rcu_hash_main_t * tm = &test_rcu_hash_main;
+  uword cpu = pointer_to_uword (arg);
+
+  clib_smp_atomic_add (&tm->n_ready, 1);
+  while (! tm->go)
+    os_sched_yield ();
+
+  if (cpu == 0)
+    {
+      test_rcu_hash_writer (tm);
+      tm->writer_done = 1;
+    }
+  else
+    test_rcu_hash_reader (tm, cpu - 1);
+
+  return 0;
+}
+
+static void
+test_rcu_hash_run (test_rcu_hash_main_t * tm, uword n_readers)
+{
+  clib_smp_main_t * m = &clib_smp_main;
+  clib_rcu_hash_t * h = &tm->hash;
+  uword n_threads = 1 + n_readers;
+  pthread_t threads[n_threads];
+  pthread_attr_t attr;
+  uword i, n_lookups, bound;
+  u64 dt;
+
+  tm->yield_when_waiting = n_threads > tm->n_os_cpus;
+  tm->n_ready = tm->go = tm->writer_done = 0;
+  tm->max_retired = tm->n_resizes = 0;
+  vec_validate (tm->n_lookups_per_reader, n_readers - 1);
+
+  clib_rcu_hash_init (h, 0, (void *) KEY_FUNC_NONE, (void *) KEY_FUNC_NONE, 0);
+
+  for (i = 0; i < n_threads; i++)
+    {
+      pthread_attr_init (&attr);
+      pthread_attr_setstack (&attr, clib_smp_stack_start_for_cpu (m, i),
+			     (uword) 1 << m->log2_n_per_cpu_stack_bytes);
+      if (pthread_create (&threads[i], &attr, test_rcu_hash_thread, uword_to_pointer (i, void *)))
+	clib_unix_error ("pthread_create");
+      pthread_attr_destroy (&attr);
+    }
+
+  while (tm->n_ready < n_threads)
+    os_sched_yield ();
+
+  dt = clib_cpu_time_now ();
+  tm->go = 1;
+  for (i = 0; i < n_threads; i++)
+    pthread_join (threads[i], 0);
+  dt = clib_cpu_time_now () - dt;
+
+  n_lookups = 0;
+  for (i = 0; i < n_readers; i++)
+    n_lookups += tm->n_lookups_per_reader[i];
+
+  /* A resize retires every node of old table (at most n_keys) and
+     other writes a reclaim threshold's worth between reclaims.  Readers
+     still in an older epoch may keep at most one more such batch. */
+  bound = 2 * (tm->n_keys + CLIB_RCU_HASH_RECLAIM_THRESHOLD);
+  if (tm->max_retired > bound)
+    {
+      clib_warning ("%d readers: %wd retired objects, expected at most %wd",
+		    n_readers, tm->max_retired, bound);
+      tm->n_errors++;
+    }
+
+  /* With no readers everything retired can be freed. */
+  clib_rcu_hash_reclaim (h);
+  if (vec_len (h->retired) != 0)
+    {
+      clib_warning ("%d readers: %wd retired objects left after last reader exit",
+		    n_readers, vec_len (h->retired));
+      tm->n_errors++;
+    }
+
+  clib_warning ("%d readers: %.4f lookups/clock per reader, %.4f total; %wd resizes, max %wd retired",
+		n_readers, (f64) n_lookups / n_readers / dt, (f64) n_lookups / dt,
+		tm->n_resizes, tm->max_retired);
+
+  clib_rcu_hash_free (h);
+}
+
+int test_rcu_hash_main_function (unformat_input_t * input)
+{
+  test_rcu_hash_main_t * tm = &test_rcu_hash_main;
+  clib_smp_main_t * m = &clib_smp_main;
+  clib_error_t * error = 0;
+  uword i;
+
+  tm->n_ops = 300000;
+  tm->n_keys = 100000;
+  tm->n_readers = 3;
+  tm->seed = 1;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "ops %d", &tm->n_ops))
+        ;
+      else if (unformat (input, "keys %d", &tm->n_keys))
+        ;
+      else if (unformat (input, "readers %d", &tm->n_readers))
+        ;
+      else if (unformat (input, "seed %d", &tm->seed))
+        ;
+      else
+        {
+          error = clib_error_return (0, "unknown input `%U'", format_unformat_error, input);
+          goto done;
+        }
+    }
+
+  if (tm->n_keys == 0 || tm->n_readers == 0)
+    {
+      error = clib_error_return (0, "keys and readers must be positive");
+      goto done;
+    }
+
+  if (! tm->seed)
+    tm->seed = getpid ();
+
+  tm->n_os_cpus = sysconf (_SC_NPROCESSORS_ONLN);
+
+  /* Input was allocated on heap that clib_smp_init replaces. */
+  unformat_free (input);
+
+  /* Writer is cpu 0; readers follow. */
+  m->n_cpus = 1 + tm->n_readers;
+  clib_smp_init ();
+
+  for (i = 1; i <= tm->n_readers; i++)
+    test_rcu_hash_run (tm, i);
+
+  if (tm->n_errors > 0)
+    error = clib_error_return (0, "%d errors", tm->n_errors);
+
+ done:
+  if (error)
+    {
+      clib_error_report (error);
+      return 1;
+    }
+  return 0;
+}
+
+int main (int argc, char * argv[])
+{
+  unformat_input_t i;
+  int ret;
+
+  unformat_init_command_line (&i, argv);
+  ret = test_rcu_hash_main_function (&i);
+  unformat_free (&i);
+
+  return ret;
+}
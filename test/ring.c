@@ -0,0 +1,384 @@
+#include <uclib/uclib.h>
+#include <pthread.h>
+
+/* Compares throughput of passing uwords between cpus with
+   clib_spsc_ring, clib_mpmc_ring and clib_fifo plus clib_smp_lock.
+   Example:
+     ring elts 1000000 size 1024 batch 32 producers 2 consumers 2 */
+
+typedef enum {
+  TEST_RING_FIFO,
+  TEST_RING_SPSC,
+  TEST_RING_MPMC,
+} test_ring_type_t;
+
+static char * test_ring_type_names[] = {
+  [TEST_RING_FIFO] = "fifo+lock",
+  [TEST_RING_SPSC] = "spsc",
+  [TEST_RING_MPMC] = "mpmc",
+};
+
+typedef struct {
+  /* Elements sent by each producer. */
+  u32 n_elts;
+
+  /* Ring and fifo size. */
+  u32 ring_size;
+
+  /* Largest batch for _n functions. */
+  u32 batch;
+
+  /* Producers and consumers for multi-producer tests. */
+  u32 n_producers, n_consumers;
+
+  /* Current test. */
+  test_ring_type_t type;
+  u32 cur_batch, cur_n_producers, cur_n_consumers;
+
+  clib_spsc_ring_t * spsc;
+  clib_mpmc_ring_t * mpmc;
+  uword * fifo;
+  clib_smp_lock_t * fifo_lock;
+
+  /* Online cpus from OS.  With more threads than cpus waiting threads
+     yield instead of spinning and fifo+lock tests are skipped since
+     clib_smp_lock spins on lock holders that are not running. */
+  u32 n_os_cpus;
+  u32 yield_when_waiting;
+
+  /* Threads wait for go before starting. */
+  volatile u32 n_ready, go;
+
+  /* Producers still running; last one to finish sends stop markers. */
+  volatile u32 n_producers_running;
+
+  /* Sum of elements received by consumers. */
+  volatile uword sum;
+
+  volatile u32 n_errors;
+} test_ring_main_t;
+
+static test_ring_main_t test_ring_main;
+
+/* Stop marker; elements sent are always non-zero. */
+#define TEST_RING_STOP 0
+
+static uword
+test_ring_enqueue (test_ring_main_t * tm, uword * elts, uword n)
+{
+  switch (tm->type)
+    {
+    case TEST_RING_SPSC:
+      return clib_spsc_ring_enqueue_n (tm->spsc, elts, n);
+
+    case TEST_RING_MPMC:
+      return clib_mpmc_ring_enqueue_n (tm->mpmc, elts, n);
+
+    case TEST_RING_FIFO:
+      clib_smp_lock (tm->fifo_lock);
+      n = clib_min (n, clib_fifo_free_elts (tm->fifo));
+      if (n > 0)
+	clib_fifo_add (tm->fifo, elts, n);
+      clib_smp_unlock (tm->fifo_lock);
+      return n;
+    }
+  return 0;
+}
+
+static uword
+test_ring_dequeue (test_ring_main_t * tm, uword * elts, uword n)
+{
+  uword i;
+
+  switch (tm->type)
+    {
+    case TEST_RING_SPSC:
+      return clib_spsc_ring_dequeue_n (tm->spsc, elts, n);
+
+    case TEST_RING_MPMC:
+      return clib_mpmc_ring_dequeue_n (tm->mpmc, elts, n);
+
+    case TEST_RING_FIFO:
+      clib_smp_lock (tm->fifo_lock);
+      n = clib_min (n, clib_fifo_elts (tm->fifo));
+      for (i = 0; i < n; i++)
+	clib_fifo_sub1 (tm->fifo, elts[i]);
+      clib_smp_unlock (tm->fifo_lock);
+      return n;
+    }
+  return 0;
+}
+
+/* Ring full or empty. */
+always_inline void
+test_ring_wait (test_ring_main_t * tm)
+{
+  if (tm->yield_when_waiting)
+    os_sched_yield ();
+  else
+    clib_smp_pause ();
+}
+
+static void
+test_ring_enqueue_all (test_ring_main_t * tm, uword * elts, uword n)
+{
+  uword i = 0;
+  while (i < n)
+    {
+      uword m = test_ring_enqueue (tm, elts + i, n - i);
+      if (m == 0)
+	test_ring_wait (tm);
+      i += m;
+    }
+}
+
+static void
+test_ring_producer (test_ring_main_t * tm, uword producer)
+{
+  uword buf[tm->cur_batch];
+  uword i, j, n;
+
+  /* Producer p sends i * n_producers + p + 1 for i = 0 .. n_elts - 1. */
+  for (i = 0; i < tm->n_elts; i += n)
+    {
+      n = clib_min (tm->cur_batch, tm->n_elts - i);
+      for (j = 0; j < n; j++)
+	buf[j] = (i + j) * tm->cur_n_producers + producer + 1;
+      test_ring_enqueue_all (tm, buf, n);
+    }
+
+  if (clib_smp_atomic_add (&tm->n_producers_running, -1) == 1)
+    for (i = 0; i < tm->cur_n_consumers; i++)
+      {
+	buf[0] = TEST_RING_STOP;
+	test_ring_enqueue_all (tm, buf, 1);
+      }
+}
+
+static void
+test_ring_consumer (test_ring_main_t * tm, uword consumer)
+{
+  uword buf[tm->cur_batch];
+  uword * last = 0, sum = 0, i, n, x, p, n_stop = 0;
+
+  /* Elements from any one producer must arrive in order. */
+  vec_resize (last, tm->cur_n_producers);
+
+  while (! n_stop)
+    {
+      n = test_ring_dequeue (tm, buf, tm->cur_batch);
+      if (n == 0)
+	{
+	  test_ring_wait (tm);
+	  continue;
+	}
+
+      for (i = 0; i < n; i++)
+	{
+	  x = buf[i];
+	  if (x == TEST_RING_STOP)
+	    {
+	      n_stop++;
+	      continue;
+	    }
+	  p = (x - 1) % tm->cur_n_producers;
+	  if (x <= last[p])
+	    clib_smp_atomic_add (&tm->n_errors, 1);
+	  last[p] = x;
+	  sum += x;
+	}
+    }
+
+  /* Pass on stop markers meant for other consumers. */
+  for (i = 1; i < n_stop; i++)
+    {
+      buf[0] = TEST_RING_STOP;
+      test_ring_enqueue_all (tm, buf, 1);
+    }
+
+  clib_smp_atomic_add (&tm->sum, sum);
+  vec_free (last);
+}
+
+static void *
+test_ring_thread (void * arg)
+{
+  test_ring_main_t * tm = &test_ring_main;
+  uword cpu = pointer_to_uword (arg);
+
+  clib_smp_atomic_add (&tm->n_ready, 1);
+  while (! tm->go)
+    os_sched_yield ();
+
+  if (cpu < tm->cur_n_producers)
+    test_ring_producer (tm, cpu);
+  else
+    test_ring_consumer (tm, cpu - tm->cur_n_producers);
+
+  return 0;
+}
+
+static void
+test_ring_run (test_ring_main_t * tm, test_ring_type_t type,
+	       uword batch, uword n_producers, uword n_consumers)
+{
+  clib_smp_main_t * m = &clib_smp_main;
+  uword n_threads = n_producers + n_consumers;
+  pthread_t threads[n_threads];
+  pthread_attr_t attr;
+  uword i, n, expected;
+  u64 dt;
+
+  tm->yield_when_waiting = n_threads > tm->n_os_cpus;
+  if (type == TEST_RING_FIFO && tm->yield_when_waiting)
+    {
+      clib_warning ("%s: %d producers %d consumers: skipped, only %d cpus",
+		    test_ring_type_names[type], n_producers, n_consumers, tm->n_os_cpus);
+      return;
+    }
+
+  tm->type = type;
+  tm->cur_batch = batch;
+  tm->cur_n_producers = n_producers;
+  tm->cur_n_consumers = n_consumers;
+  tm->n_ready = tm->go = 0;
+  tm->n_producers_running = n_producers;
+  tm->sum = 0;
+
+  switch (type)
+    {
+    case TEST_RING_SPSC:
+      clib_spsc_ring_init (&tm->spsc, tm->ring_size);
+      break;
+    case TEST_RING_MPMC:
+      clib_mpmc_ring_init (&tm->mpmc, tm->ring_size);
+      break;
+    case TEST_RING_FIFO:
+      /* Size fifo once so that it never grows while threads run. */
+      clib_fifo_resize (tm->fifo, tm->ring_size);
+      clib_smp_lock_init (&tm->fifo_lock);
+      break;
+    }
+
+  for (i = 0; i < n_threads; i++)
+    {
+      pthread_attr_init (&attr);
+      pthread_attr_setstack (&attr, clib_smp_stack_start_for_cpu (m, i),
+			     (uword) 1 << m->log2_n_per_cpu_stack_bytes);
+      if (pthread_create (&threads[i], &attr, test_ring_thread, uword_to_pointer (i, void *)))
+	clib_unix_error ("pthread_create");
+      pthread_attr_destroy (&attr);
+    }
+
+  while (tm->n_ready < n_threads)
+    os_sched_yield ();
+
+  dt = clib_cpu_time_now ();
+  tm->go = 1;
+  for (i = 0; i < n_threads; i++)
+    pthread_join (threads[i], 0);
+  dt = clib_cpu_time_now () - dt;
+
+  /* Sum of 1 .. n. */
+  n = (uword) tm->n_elts * n_producers;
+  expected = n * (n + 1) / 2;
+  if (tm->sum != expected)
+    {
+      clib_warning ("%s: sum %wd expected %wd", test_ring_type_names[type], tm->sum, expected);
+      tm->n_errors++;
+    }
+
+  clib_warning ("%s: %d producers %d consumers batch %d: %.2f clocks/elt",
+		test_ring_type_names[type], n_producers, n_consumers, batch,
+		(f64) dt / n);
+
+  clib_spsc_ring_free (&tm->spsc);
+  clib_mpmc_ring_free (&tm->mpmc);
+  clib_fifo_free (tm->fifo);
+  clib_smp_lock_free (&tm->fifo_lock);
+}
+
+static void
+test_ring_run_all (test_ring_main_t * tm, uword batch)
+{
+  test_ring_run (tm, TEST_RING_FIFO, batch, 1, 1);
+  test_ring_run (tm, TEST_RING_SPSC, batch, 1, 1);
+  test_ring_run (tm, TEST_RING_FIFO, batch, tm->n_producers, tm->n_consumers);
+  test_ring_run (tm, TEST_RING_MPMC, batch, tm->n_producers, tm->n_consumers);
+}
+
+int test_ring_main_function (unformat_input_t * input)
+{
+  test_ring_main_t * tm = &test_ring_main;
+  clib_smp_main_t * m = &clib_smp_main;
+  clib_error_t * error = 0;
+
+  tm->n_elts = 1000000;
+  tm->ring_size = 1024;
+  tm->batch = 32;
+  tm->n_producers = 2;
+  tm->n_consumers = 2;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "elts %d", &tm->n_elts))
+        ;
+      else if (unformat (input, "size %d", &tm->ring_size))
+        ;
+      else if (unformat (input, "batch %d", &tm->batch))
+        ;
+      else if (unformat (input, "producers %d", &tm->n_producers))
+        ;
+      else if (unformat (input, "consumers %d", &tm->n_consumers))
+        ;
+      else
+        {
+          error = clib_error_return (0, "unknown input `%U'", format_unformat_error, input);
+          goto done;
+        }
+    }
+
+  if (tm->n_elts == 0 || tm->ring_size == 0 || tm->batch == 0
+      || tm->n_producers == 0 || tm->n_consumers == 0)
+    {
+      error = clib_error_return (0, "elts, size, batch, producers and consumers must be positive");
+      goto done;
+    }
+
+  tm->n_os_cpus = sysconf (_SC_NPROCESSORS_ONLN);
+
+  /* Input was allocated on heap that clib_smp_init replaces. */
+  unformat_free (input);
+
+  /* Each thread gets a cpu index, stack and heap. */
+  m->n_cpus = clib_max (2, tm->n_producers + tm->n_consumers);
+  clib_smp_init ();
+
+  /* One element at a time, then batched. */
+  test_ring_run_all (tm, 1);
+  if (tm->batch > 1)
+    test_ring_run_all (tm, tm->batch);
+
+  if (tm->n_errors > 0)
+    error = clib_error_return (0, "%d elements lost or out of order", tm->n_errors);
+
+ done:
+  if (error)
+    {
+      clib_error_report (error);
+      return 1;
+    }
+  return 0;
+}
+
+int main (int argc, char * argv[])
+{
+  unformat_input_t i;
+  int ret;
+
+  unformat_init_command_line (&i, argv);
+  ret = test_ring_main_function (&i);
+  unformat_free (&i);
+
+  return ret;
+}
@@ -126,6 +126,60 @@ typedef struct {
   foo_main_t foo_main[2];
 } test_udb_main_t;
 
+/* Round trip of vectors of many sizes through a vector stream: writes
+   larger than what is left of buffer go through overflow buffer
+   which must be flushed in order as buffer grows. */
+static clib_error_t * test_serialize_long_vectors (void)
+{
+  serialize_main_t _sm, * sm = &_sm;
+  clib_error_t * error = 0;
+  u32 ** vs = 0, * v, seed = 1;
+  u8 * data;
+  uword i, j, n;
+
+  for (i = 0; i < 64; i++)
+    {
+      v = 0;
+      n = (i * 997) % 5000;
+      for (j = 0; j < n; j++)
+	vec_add1 (v, random_u32 (&seed));
+      vec_add1 (vs, v);
+    }
+
+  serialize_open_vector (sm, 0);
+  for (i = 0; i < vec_len (vs); i++)
+    {
+      serialize_likely_small_unsigned_integer (sm, i);
+      vec_serialize (sm, vs[i], serialize_vec_32);
+    }
+  data = serialize_close_vector (sm);
+
+  unserialize_open_data (sm, data, vec_len (data));
+  for (i = 0; i < vec_len (vs) && ! error; i++)
+    {
+      v = 0;
+      if (unserialize_likely_small_unsigned_integer (sm) != i)
+	error = clib_error_return (0, "vector %d: wrong index", i);
+      else if ((error = unserialize (sm, unserialize_vector, &v, sizeof (v[0]), unserialize_vec_32)))
+	;
+      else if (vec_len (v) != vec_len (vs[i])
+	       || (vec_len (v) > 0 && memcmp (v, vs[i], vec_bytes (v))))
+	error = clib_error_return (0, "vector %d of %d elts differs after round trip",
+				   i, vec_len (vs[i]));
+      vec_free (v);
+    }
+  if (! error && ! unserialize_is_end_of_stream (sm))
+    error = clib_error_return (0, "extra data after %d vectors", vec_len (vs));
+  unserialize_close (sm);
+
+  vec_free (data);
+  for (i = 0; i < vec_len (vs); i++)
+    vec_free (vs[i]);
+  vec_free (vs);
+
+  return error;
+}
+
 int test_udb_main (unformat_input_t * input)
 {
   clib_error_t * error = 0;
@@ -136,6 +190,9 @@ int test_udb_main (unformat_input_t * input)
 
   memset (tm, 0, sizeof (tm[0]));
 
+  if ((error = test_serialize_long_vectors ()))
+    goto done;
+
   pool_get (fm->foo_pool, f);
   f->a = 1; f->b = 2;
 
@@ -0,0 +1,191 @@
+#include <uclib/uclib.h>
+#include "test.h"
+
+/* Checks clib_small_vec_t against normal vectors.  Example:
+     small_vec iter 1000 seed 1 */
+
+typedef struct {
+  u32 n_iter;
+  u32 seed;
+  u32 n_errors;
+} test_small_vec_main_t;
+
+/* Small vector must look just like reference vector. */
+static void
+test_small_vec_compare (test_small_vec_main_t * tm, clib_small_vec_t * s, u8 * ref)
+{
+  u8 * v = clib_small_vec (s);
+  u8 * f;
+
+  test_check (tm, vec_len (v) == vec_len (ref));
+  test_check (tm, clib_small_vec_len (s) == vec_len (ref));
+  test_check (tm, vec_len (ref) == 0 || ! memcmp (v, ref, vec_len (ref)));
+
+  f = format (0, "%v", v);
+  test_check (tm, vec_len (f) == vec_len (ref) && ! memcmp (f, ref, vec_len (ref)));
+  vec_free (f);
+}
+
+/* Spill happens exactly when CLIB_SMALL_VEC_N_INLINE bytes are exceeded. */
+static void
+test_small_vec_spill (test_small_vec_main_t * tm, uword use_add1)
+{
+  clib_small_vec_t s;
+  u8 * ref = 0, * v;
+  uword i;
+
+  clib_small_vec_init (&s);
+  for (i = 0; i < CLIB_SMALL_VEC_N_INLINE; i++)
+    {
+      if (use_add1)
+	clib_small_vec_add1 (&s, 'a' + i % 26);
+      else
+	clib_small_vec_add (&s, "abcdefghijklmnopqrstuvwxyz" + i % 26, 1);
+      vec_add1 (ref, 'a' + i % 26);
+    }
+
+  test_check (tm, clib_small_vec_is_inline (&s));
+  test_check (tm, clib_small_vec (&s) == s.inline_data);
+  test_small_vec_compare (tm, &s, ref);
+
+  if (use_add1)
+    clib_small_vec_add1 (&s, '!');
+  else
+    clib_small_vec_add (&s, "!", 1);
+  vec_add1 (ref, '!');
+
+  test_check (tm, ! clib_small_vec_is_inline (&s));
+  test_small_vec_compare (tm, &s, ref);
+
+  /* Spilled vector is handed over as is. */
+  v = clib_small_vec_to_vec (&s);
+  test_check (tm, vec_len (v) == vec_len (ref) && ! memcmp (v, ref, vec_len (ref)));
+  test_check (tm, clib_small_vec_is_inline (&s) && clib_small_vec_len (&s) == 0);
+
+  vec_free (v);
+  vec_free (ref);
+}
+
+static void
+test_small_vec_to_vec (test_small_vec_main_t * tm)
+{
+  clib_small_vec_t s;
+  u8 * v;
+
+  /* Empty. */
+  clib_small_vec_init (&s);
+  test_check (tm, clib_small_vec_to_vec (&s) == 0);
+
+  /* Inline: copied to exactly sized heap vector. */
+  clib_small_vec_add (&s, "hello", 5);
+  v = clib_small_vec_to_vec (&s);
+  test_check (tm, v != s.inline_data && vec_len (v) == 5 && ! memcmp (v, "hello", 5));
+  test_check (tm, clib_small_vec_len (&s) == 0);
+  vec_free (v);
+
+  /* Spilled then emptied: heap memory is freed. */
+  clib_small_vec_add2 (&s, CLIB_SMALL_VEC_N_INLINE + 1);
+  test_check (tm, ! clib_small_vec_is_inline (&s));
+  clib_small_vec_reset_length (&s);
+  test_check (tm, clib_small_vec_len (&s) == 0);
+  test_check (tm, clib_small_vec_to_vec (&s) == 0);
+  test_check (tm, clib_small_vec_is_inline (&s));
+}
+
+/* Random adds of random sizes. */
+static void
+test_small_vec_random (test_small_vec_main_t * tm)
+{
+  clib_small_vec_t s;
+  u8 * ref = 0, * p;
+  uword iter, i, n, l;
+  u32 seed = tm->seed;
+
+  clib_small_vec_init (&s);
+  for (iter = 0; iter < tm->n_iter; iter++)
+    {
+      n = random_u32 (&seed) >> 24;
+      /* Mostly short adds with some that spill at once. */
+      l = (n >> 6) ? n % 8 : n % (2 * CLIB_SMALL_VEC_N_INLINE);
+      if (n & 1)
+	{
+	  p = clib_small_vec_add2 (&s, l);
+	  for (i = 0; i < l; i++)
+	    p[i] = iter + i;
+	  for (i = 0; i < l; i++)
+	    vec_add1 (ref, iter + i);
+	}
+      else
+	for (i = 0; i < l; i++)
+	  {
+	    clib_small_vec_add1 (&s, iter + i);
+	    vec_add1 (ref, iter + i);
+	  }
+
+      test_small_vec_compare (tm, &s, ref);
+
+      /* Start over now and then. */
+      if (vec_len (ref) > 4 * CLIB_SMALL_VEC_N_INLINE || (n & 0xf) == 0)
+	{
+	  clib_small_vec_free (&s);
+	  vec_reset_length (ref);
+	}
+    }
+
+  clib_small_vec_free (&s);
+  vec_free (ref);
+}
+
+int test_small_vec_main (unformat_input_t * input)
+{
+  test_small_vec_main_t tm;
+  clib_error_t * error = 0;
+
+  memset (&tm, 0, sizeof (tm));
+  tm.n_iter = 1000;
+  tm.seed = 1;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "iter %d", &tm.n_iter))
+        ;
+      else if (unformat (input, "seed %d", &tm.seed))
+        ;
+      else
+        {
+          error = clib_error_return (0, "unknown input `%U'", format_unformat_error, input);
+          goto done;
+        }
+    }
+
+  if (! tm.seed)
+    tm.seed = getpid ();
+
+  test_small_vec_spill (&tm, /* use_add1 */ 1);
+  test_small_vec_spill (&tm, /* use_add1 */ 0);
+  test_small_vec_to_vec (&tm);
+  test_small_vec_random (&tm);
+
+  if (tm.n_errors > 0)
+    error = clib_error_return (0, "%d errors, seed %d", tm.n_errors, tm.seed);
+
+ done:
+  if (error)
+    {
+      clib_error_report (error);
+      return 1;
+    }
+  return 0;
+}
+
+int main (int argc, char * argv[])
+{
+  unformat_input_t i;
+  int ret;
+
+  unformat_init_command_line (&i, argv);
+  ret = test_small_vec_main (&i);
+  unformat_free (&i);
+
+  return ret;
+}
@@ -0,0 +1,19 @@
+#ifndef included_test_test_h
+#define included_test_test_h
+
+#include <uclib/uclib.h>
+
+/* Checks condition in a test: failures are warned about with failed
+   expression and counted in (tm)->n_errors so that one run reports
+   every failure.  Test main then returns an error when count is
+   non-zero. */
+#define test_check(tm,x)					\
+do {								\
+  if (! (x))							\
+    {								\
+      clib_warning ("check failed: %s", #x);			\
+      (tm)->n_errors++;						\
+    }								\
+} while (0)
+
+#endif /* included_test_test_h */
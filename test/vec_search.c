@@ -0,0 +1,192 @@
+#include <uclib/uclib.h>
+
+/* Checks vector search/count kernels against scalar loops and
+   compares their speed.  Example:
+     vec_search len 64 iter 100000 */
+
+typedef struct {
+  u32 seed;
+
+  u32 n_iter;
+
+  /* Vector length in elements. */
+  u32 len;
+} test_vec_search_main_t;
+
+static never_inline uword
+scalar_search_u8 (u8 * p, uword n, u8 x)
+{
+  uword i;
+  for (i = 0; i < n; i++)
+    if (p[i] == x)
+      return i;
+  return ~0;
+}
+
+static never_inline uword
+scalar_search_u16 (u16 * p, uword n, u16 x)
+{
+  uword i;
+  for (i = 0; i < n; i++)
+    if (p[i] == x)
+      return i;
+  return ~0;
+}
+
+static never_inline uword
+scalar_search_u32 (u32 * p, uword n, u32 x)
+{
+  uword i;
+  for (i = 0; i < n; i++)
+    if (p[i] == x)
+      return i;
+  return ~0;
+}
+
+static never_inline uword
+scalar_count_u8 (u8 * p, uword n, u8 x)
+{
+  uword i, c = 0;
+  for (i = 0; i < n; i++)
+    c += p[i] == x;
+  return c;
+}
+
+static never_inline uword
+simd_search_u8 (u8 * p, uword n, u8 x)
+{ return clib_search_u8 (p, n, x); }
+
+static never_inline uword
+simd_search_u16 (u16 * p, uword n, u16 x)
+{ return clib_search_u16 (p, n, x); }
+
+static never_inline uword
+simd_search_u32 (u32 * p, uword n, u32 x)
+{ return clib_search_u32 (p, n, x); }
+
+static never_inline uword
+simd_count_u8 (u8 * p, uword n, u8 x)
+{ return clib_count_u8 (p, n, x); }
+
+/* Time n_iter calls of scalar and vector versions of FUNC and check
+   that they agree.  Searched value is placed at end of vector. */
+#define foreach_test_vec_search_type		\
+  _ (search, u8)				\
+  _ (search, u16)				\
+  _ (search, u32)				\
+  _ (count, u8)
+
+#define _(f,t)								\
+static uword								\
+test_##f##_##t (test_vec_search_main_t * tm)				\
+{									\
+  t * v = 0;								\
+  uword i, j, r[2], sum[2] = {0};					\
+  u64 clocks[2] = {0}, t0;						\
+									\
+  vec_resize (v, tm->len);						\
+									\
+  for (i = 0; i < tm->n_iter; i++)					\
+    {									\
+      /* Avoid matching value 0: it is always searched for. */		\
+      for (j = 0; j < vec_len (v); j++)					\
+	v[j] = 1 + random_u32 (&tm->seed) % 251;			\
+      j = random_u32 (&tm->seed) % vec_len (v);				\
+      v[j] = 0;								\
+									\
+      /* Offset start to exercise unaligned loads and tails. */	\
+      j = i % 16;							\
+      if (j > vec_len (v))						\
+	j = 0;								\
+									\
+      t0 = clib_cpu_time_now ();					\
+      r[0] = scalar_##f##_##t (v + j, vec_len (v) - j, 0);		\
+      clocks[0] += clib_cpu_time_now () - t0;				\
+									\
+      t0 = clib_cpu_time_now ();					\
+      r[1] = simd_##f##_##t (v + j, vec_len (v) - j, 0);		\
+      clocks[1] += clib_cpu_time_now () - t0;				\
+									\
+      if (r[0] != r[1])							\
+	{								\
+	  clib_warning ("%s_%s: mismatch len %d offset %d: %wd != %wd", \
+			#f, #t, vec_len (v), j, r[0], r[1]);		\
+	  vec_free (v);							\
+	  return 1;							\
+	}								\
+      sum[0] += r[0];							\
+      sum[1] += r[1];							\
+    }									\
+									\
+  clib_warning ("%s_%s: len %d, scalar %.2f clocks/call, vector %.2f clocks/call", \
+		#f, #t, tm->len,					\
+		(f64) clocks[0] / tm->n_iter,				\
+		(f64) clocks[1] / tm->n_iter);				\
+  vec_free (v);								\
+  return sum[0] != sum[1];						\
+}
+foreach_test_vec_search_type
+#undef _
+
+int test_vec_search_main (unformat_input_t * input)
+{
+  test_vec_search_main_t tm;
+  clib_error_t * error = 0;
+  uword n_errors = 0;
+
+  memset (&tm, 0, sizeof (tm));
+  tm.seed = 1;
+  tm.n_iter = 10000;
+  tm.len = 64;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "seed %d", &tm.seed))
+        ;
+      else if (unformat (input, "iter %d", &tm.n_iter))
+        ;
+      else if (unformat (input, "len %d", &tm.len))
+        ;
+      else
+        {
+          error = clib_error_return (0, "unknown input `%U'", format_unformat_error, input);
+          goto done;
+        }
+    }
+
+  if (! tm.seed)
+    tm.seed = getpid ();
+
+  if (tm.len == 0 || tm.n_iter == 0)
+    {
+      error = clib_error_return (0, "len and iter must be positive");
+      goto done;
+    }
+
+#define _(f,t) n_errors += test_##f##_##t (&tm);
+  foreach_test_vec_search_type
+#undef _
+
+  if (n_errors > 0)
+    error = clib_error_return (0, "%d kernels disagree with scalar loops", n_errors);
+
+ done:
+  if (error)
+    {
+      clib_error_report (error);
+      return 1;
+    }
+  return 0;
+}
+
+int main (int argc, char * argv[])
+{
+  unformat_input_t i;
+  int ret;
+
+  unformat_init_command_line (&i, argv);
+  ret = test_vec_search_main (&i);
+  unformat_free (&i);
+
+  return ret;
+}
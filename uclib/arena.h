@@ -0,0 +1,82 @@
+/*
+  Copyright (c) 2005 Eliot Dresselhaus
+
+  Permission is hereby granted, free of charge, to any person obtaining
+  a copy of this software and associated documentation files (the
+  "Software"), to deal in the Software without restriction, including
+  without limitation the rights to use, copy, modify, merge, publish,
+  distribute, sublicense, and/or sell copies of the Software, and to
+  permit persons to whom the Software is furnished to do so, subject to
+  the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+  LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+  WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef included_clib_arena_h
+#define included_clib_arena_h
+
+/* Bump pointer allocator for short lived objects (e.g. everything made
+   while handling one request).  Arena is pushed as this cpu's current
+   heap so that vec_add, format, hash_create etc. all allocate from it;
+   clib_arena_reset then frees everything at once.
+
+   Objects must not be used after reset.  Vectors from other heaps must
+   not be grown while arena is pushed since they would move into arena. */
+typedef struct {
+  /* Heap made with MHEAP_FLAG_ARENA. */
+  void * heap;
+} clib_arena_t;
+
+/* Reserve max_bytes of address space for arena.  Pages are only
+   backed by memory once touched.  Returns 0 on failure. */
+always_inline void * clib_arena_init (clib_arena_t * a, uword max_bytes)
+{
+  a->heap = mheap_alloc_with_flags (0, max_bytes, MHEAP_FLAG_ARENA);
+  return a->heap;
+}
+
+always_inline void clib_arena_free (clib_arena_t * a)
+{
+  if (a->heap)
+    mheap_free (a->heap);
+}
+
+/* Make arena this cpu's current heap. */
+always_inline void clib_arena_push (clib_arena_t * a)
+{
+  mheap_t * h = mheap_header (a->heap);
+  ASSERT (! h->arena_parent_heap);
+  h->arena_parent_heap = clib_mem_set_heap (a->heap);
+}
+
+/* Restore heap which was current before clib_arena_push. */
+always_inline void clib_arena_pop (clib_arena_t * a)
+{
+  mheap_t * h = mheap_header (a->heap);
+  ASSERT (clib_mem_get_heap () == a->heap);
+  clib_mem_set_heap (h->arena_parent_heap);
+  h->arena_parent_heap = 0;
+}
+
+/* Free all objects in arena. */
+always_inline void clib_arena_reset (clib_arena_t * a)
+{ mheap_arena_reset (a->heap); }
+
+/* Bytes allocated from arena since last reset. */
+always_inline uword clib_arena_bytes (clib_arena_t * a)
+{ return vec_len (a->heap); }
+
+/* Maximum size of arena. */
+always_inline uword clib_arena_max_bytes (clib_arena_t * a)
+{ return mheap_header (a->heap)->max_size; }
+
+#endif /* included_clib_arena_h */
@@ -34,7 +34,7 @@ clib_backtrace (uword * callers,
 		uword max_callers,
 		uword n_frames_to_skip)
 {
-  clib_generic_stack_frame_t * f;
+  clib_generic_stack_frame_t * f, * prev;
   uword i;
 
   f = __builtin_frame_address (0);
@@ -44,11 +44,15 @@ clib_backtrace (uword * callers,
 
   for (i = 0; i < max_callers + n_frames_to_skip; i++)
     {
-      f = f->prev;
-      if (! f)
-	goto backtrace_done;
-      if (clib_abs ((void *) f - (void *) f->prev) > (64*1024))
+      /* Caller's frame must be just above ours on stack.  Stops before
+	 following a frame pointer register used for something else
+	 (e.g. by code compiled without frame pointers). */
+      prev = f->prev;
+      if (! prev
+	  || (void *) prev <= (void *) f
+	  || (void *) prev - (void *) f > (64*1024))
 	goto backtrace_done;
+      f = prev;
       if (i >= n_frames_to_skip)
 	callers[i - n_frames_to_skip] = pointer_to_uword (f->return_address);
     }
@@ -326,6 +326,30 @@ u8 * format_clib_elf_symbol (u8 * s, va_list * args)
     }
 }
 
+u8 * format_clib_elf_symbol_name (u8 * s, va_list * args)
+{
+  uword address = va_arg (*args, uword);
+  clib_elf_main_t * cem = &clib_elf_main;
+  clib_elf_symbol_t sym;
+  elf_main_t * em;
+  elf_symbol_table_t * t;
+
+  clib_elf_main_init ("/proc/self/exe");
+
+  if (clib_elf_symbol_by_address (address, &sym))
+    {
+      em = vec_elt_at_index (cem->elf_mains, sym.elf_main_index);
+      t = vec_elt_at_index (em->symbol_tables, sym.symbol_table_index);
+      s = format (s, "%s+0x%wx",
+		  elf_symbol_name (t, &sym.symbol),
+		  address - sym.symbol.value);
+    }
+  else
+    s = format (s, "0x%wx", address);
+
+  return s;
+}
+
 u8 * format_clib_elf_symbol_with_address (u8 * s, va_list * args)
 {
   uword address = va_arg (*args, uword);
@@ -108,3 +108,4 @@ uword clib_elf_symbol_by_name (char * name, clib_elf_symbol_t * result);
 uword clib_elf_symbol_by_address (uword address, clib_elf_symbol_t * result);
 
 format_function_t format_clib_elf_symbol, format_clib_elf_symbol_with_address;
+format_function_t format_clib_elf_symbol_name;
@@ -0,0 +1,214 @@
+/*
+  Copyright (c) 2014 Eliot Dresselhaus
+
+  Permission is hereby granted, free of charge, to any person obtaining
+  a copy of this software and associated documentation files (the
+  "Software"), to deal in the Software without restriction, including
+  without limitation the rights to use, copy, modify, merge, publish,
+  distribute, sublicense, and/or sell copies of the Software, and to
+  permit persons to whom the Software is furnished to do so, subject to
+  the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+  LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+  WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+always_inline uword flat_hash_min_pow2_align (uword n_bytes)
+{
+  /* Largest power of 2 dividing n_bytes, at most a uword. */
+  uword a = n_bytes & -n_bytes;
+  return a == 0 || a > sizeof (uword) ? sizeof (uword) : a;
+}
+
+void clib_flat_hash_init (clib_flat_hash_t * h, uword key_bytes, uword value_bytes, uword n_elts)
+{
+  uword ka, va;
+
+  ASSERT (key_bytes > 0);
+
+  memset (h, 0, sizeof (h[0]));
+  h->key_bytes = key_bytes;
+  h->value_bytes = value_bytes;
+
+  ka = flat_hash_min_pow2_align (key_bytes);
+  va = value_bytes > 0 ? flat_hash_min_pow2_align (value_bytes) : 1;
+  h->value_offset = round_pow2 (key_bytes, va);
+  h->slot_bytes = round_pow2 (h->value_offset + value_bytes, clib_max (ka, va));
+
+  /* Seed from table address so tables differ. */
+  h->seed = pointer_to_uword (h);
+
+  if (n_elts > 0)
+    clib_flat_hash_resize (h, n_elts);
+}
+
+void clib_flat_hash_free (clib_flat_hash_t * h)
+{
+  vec_free (h->ctrl);
+  vec_free (h->slots);
+  h->n_elts = h->n_growth_left = 0;
+}
+
+/* Max number of elements for a given number of slots. */
+always_inline uword flat_hash_max_elts (uword n_slots)
+{ return n_slots - n_slots / 8; }
+
+/* First EMPTY or DELETED slot along probe sequence for hash. */
+static uword
+flat_hash_find_free (clib_flat_hash_t * h, uword hv)
+{
+  uword g, step, mask;
+  u8 * ctrl;
+  u32 m;
+
+  mask = pow2_mask (h->log2_n_groups);
+  g = (hv >> 7) & mask;
+
+  for (step = 1; ; step++)
+    {
+      ctrl = h->ctrl + g * CLIB_FLAT_HASH_GROUP_SIZE;
+      m = (clib_flat_hash_group_match (ctrl, CLIB_FLAT_HASH_CTRL_EMPTY)
+	   | clib_flat_hash_group_match (ctrl, CLIB_FLAT_HASH_CTRL_DELETED));
+      if (m)
+	return g * CLIB_FLAT_HASH_GROUP_SIZE + log2_first_set (m);
+      g = (g + step) & mask;
+    }
+}
+
+void clib_flat_hash_resize (clib_flat_hash_t * h, uword n_elts)
+{
+  clib_flat_hash_t old = h[0];
+  uword i, j, n_slots, log2_n_groups, hv;
+
+  n_elts = clib_max (n_elts, h->n_elts);
+
+  /* Smallest power of 2 number of groups keeping table 7/8 full. */
+  log2_n_groups = 0;
+  while (flat_hash_max_elts (CLIB_FLAT_HASH_GROUP_SIZE << log2_n_groups) < n_elts)
+    log2_n_groups++;
+  n_slots = CLIB_FLAT_HASH_GROUP_SIZE << log2_n_groups;
+
+  h->ctrl = 0;
+  h->slots = 0;
+  vec_validate_aligned (h->ctrl, n_slots - 1, CLIB_FLAT_HASH_GROUP_SIZE);
+  memset (h->ctrl, CLIB_FLAT_HASH_CTRL_EMPTY, n_slots);
+  vec_resize_haf (h->slots, n_slots * h->slot_bytes, 0, CLIB_CACHE_LINE_BYTES,
+		  VEC_RESIZE_NO_ZERO);
+  h->log2_n_groups = log2_n_groups;
+  h->n_growth_left = flat_hash_max_elts (n_slots) - h->n_elts;
+
+  /* Re-insert old keys; no compares needed since keys are unique. */
+  for (i = 0; i < vec_len (old.ctrl); i++)
+    {
+      u8 * s;
+
+      if (old.ctrl[i] & 0x80)
+	continue;
+
+      s = clib_flat_hash_slot (&old, i);
+      hv = clib_flat_hash_key_sum (h, s);
+      j = flat_hash_find_free (h, hv);
+      h->ctrl[j] = hv & 0x7f;
+      memcpy (clib_flat_hash_slot (h, j), s, h->slot_bytes);
+    }
+
+  vec_free (old.ctrl);
+  vec_free (old.slots);
+}
+
+uword clib_flat_hash_set_mem (clib_flat_hash_t * h, void * key, void * value, void * old_value)
+{
+  uword i, hv;
+  u8 * s;
+
+  hv = clib_flat_hash_key_sum (h, key);
+  i = clib_flat_hash_find (h, key, hv);
+  if (i != ~0)
+    {
+      s = clib_flat_hash_slot (h, i) + h->value_offset;
+      if (old_value)
+	memcpy (old_value, s, h->value_bytes);
+      memcpy (s, value, h->value_bytes);
+      return 1;
+    }
+
+  i = h->ctrl ? flat_hash_find_free (h, hv) : ~0;
+
+  /* Only filling an EMPTY slot uses up growth; DELETED slots are free. */
+  if (i == ~0 || (h->ctrl[i] == CLIB_FLAT_HASH_CTRL_EMPTY && h->n_growth_left == 0))
+    {
+      /* Re-hashing at same size drops DELETED slots when less than
+	 half of maximum is in use; otherwise double. */
+      uword n = h->n_elts + 1, max = flat_hash_max_elts (clib_flat_hash_capacity (h));
+      if (h->ctrl)
+	n = n > max / 2 ? flat_hash_max_elts (2 * clib_flat_hash_capacity (h)) : max;
+      clib_flat_hash_resize (h, n);
+      i = flat_hash_find_free (h, hv);
+    }
+
+  if (h->ctrl[i] == CLIB_FLAT_HASH_CTRL_EMPTY)
+    h->n_growth_left -= 1;
+
+  h->ctrl[i] = hv & 0x7f;
+  s = clib_flat_hash_slot (h, i);
+  memcpy (s, key, h->key_bytes);
+  memcpy (s + h->value_offset, value, h->value_bytes);
+  h->n_elts += 1;
+
+  return 0;
+}
+
+uword clib_flat_hash_unset_mem (clib_flat_hash_t * h, void * key, void * old_value)
+{
+  uword i, g;
+
+  if (h->n_elts == 0)
+    return 0;
+
+  i = clib_flat_hash_find (h, key, clib_flat_hash_key_sum (h, key));
+  if (i == ~0)
+    return 0;
+
+  if (old_value)
+    memcpy (old_value, clib_flat_hash_slot (h, i) + h->value_offset, h->value_bytes);
+
+  /* A group with an EMPTY slot has never been full so no probe
+     sequence continues past it: slot can be made EMPTY again.
+     Otherwise leave a DELETED marker so probes continue. */
+  g = i & ~(CLIB_FLAT_HASH_GROUP_SIZE - 1);
+  if (clib_flat_hash_group_match (h->ctrl + g, CLIB_FLAT_HASH_CTRL_EMPTY))
+    {
+      h->ctrl[i] = CLIB_FLAT_HASH_CTRL_EMPTY;
+      h->n_growth_left += 1;
+    }
+  else
+    h->ctrl[i] = CLIB_FLAT_HASH_CTRL_DELETED;
+
+  h->n_elts -= 1;
+
+  return 1;
+}
+
+u8 * format_clib_flat_hash (u8 * s, va_list * va)
+{
+  clib_flat_hash_t * h = va_arg (*va, clib_flat_hash_t *);
+  uword i, n_deleted = 0;
+
+  for (i = 0; i < clib_flat_hash_capacity (h); i++)
+    n_deleted += h->ctrl[i] == CLIB_FLAT_HASH_CTRL_DELETED;
+
+  s = format (s, "flat hash: %wd elts, capacity %wd, %wd deleted, %d+%d byte key+value, %wd bytes used",
+	      h->n_elts, clib_flat_hash_capacity (h), n_deleted,
+	      h->key_bytes, h->value_bytes,
+	      vec_bytes (h->ctrl) + vec_bytes (h->slots));
+
+  return s;
+}
@@ -0,0 +1,194 @@
+/*
+  Copyright (c) 2014 Eliot Dresselhaus
+
+  Permission is hereby granted, free of charge, to any person obtaining
+  a copy of this software and associated documentation files (the
+  "Software"), to deal in the Software without restriction, including
+  without limitation the rights to use, copy, modify, merge, publish,
+  distribute, sublicense, and/or sell copies of the Software, and to
+  permit persons to whom the Software is furnished to do so, subject to
+  the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+  LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+  WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef included_clib_flat_hash_h
+#define included_clib_flat_hash_h
+
+/* Open addressing hash table for fixed size keys and values.
+
+   Slots are grouped 16 at a time.  Each slot has a control byte
+   holding 7 bits of its key's hash (or EMPTY/DELETED) so that one
+   16 byte compare checks a whole group.  Keys and values are stored
+   inline in the slot: there are no indirect pair vectors as in hash.c.
+
+   Value pointers returned by get are invalidated by set (which may
+   resize the table). */
+
+#define CLIB_FLAT_HASH_GROUP_SIZE 16
+#define CLIB_FLAT_HASH_CTRL_EMPTY 0x80
+#define CLIB_FLAT_HASH_CTRL_DELETED 0xfe
+
+typedef struct {
+  /* Control byte for each slot: hash tag (< 0x80) when full. */
+  u8 * ctrl;
+
+  /* Key and value for each slot; slot_bytes apart. */
+  u8 * slots;
+
+  /* Number of keys in table. */
+  uword n_elts;
+
+  /* Number of EMPTY slots which may still be filled before table
+     must be resized.  Keeps table at most 7/8 full counting
+     deleted slots. */
+  uword n_growth_left;
+
+  /* Number of groups is 2^log2_n_groups when ctrl is non-zero. */
+  u32 log2_n_groups;
+
+  u16 key_bytes;
+  u16 value_bytes;
+
+  /* Offset of value in slot; value is naturally aligned up to uword. */
+  u16 value_offset;
+  u16 slot_bytes;
+
+  /* Hash function seed. */
+  uword seed;
+} clib_flat_hash_t;
+
+void clib_flat_hash_init (clib_flat_hash_t * h, uword key_bytes, uword value_bytes, uword n_elts);
+void clib_flat_hash_free (clib_flat_hash_t * h);
+
+/* Resize to hold at least n_elts. */
+void clib_flat_hash_resize (clib_flat_hash_t * h, uword n_elts);
+
+/* Set key to value.  Returns 1 and copies previous value to
+   old_value (if non-zero) when key was already in table. */
+uword clib_flat_hash_set_mem (clib_flat_hash_t * h, void * key, void * value, void * old_value);
+
+/* Returns 1 and copies value to old_value (if non-zero) when key was in table. */
+uword clib_flat_hash_unset_mem (clib_flat_hash_t * h, void * key, void * old_value);
+
+format_function_t format_clib_flat_hash;
+
+always_inline uword clib_flat_hash_elts (clib_flat_hash_t * h)
+{ return h->n_elts; }
+
+always_inline uword clib_flat_hash_capacity (clib_flat_hash_t * h)
+{ return h->ctrl ? CLIB_FLAT_HASH_GROUP_SIZE << h->log2_n_groups : 0; }
+
+always_inline u8 * clib_flat_hash_slot (clib_flat_hash_t * h, uword i)
+{ return h->slots + i * h->slot_bytes; }
+
+always_inline uword clib_flat_hash_key_sum (clib_flat_hash_t * h, void * key)
+{ return hash_memory_wide (key, h->key_bytes, h->seed); }
+
+/* Bitmap of slots in group whose control byte equals c. */
+always_inline u32 clib_flat_hash_group_match (u8 * ctrl, u8 c)
+{
+#if CLIB_VEC_SEARCH_SIMD
+  return u8x16_compare_byte_mask (u8x16_is_equal (*(u8x16 *) ctrl, u8x16_splat (c)));
+#else
+  u32 i, m = 0;
+  for (i = 0; i < CLIB_FLAT_HASH_GROUP_SIZE; i++)
+    m |= (ctrl[i] == c) << i;
+  return m;
+#endif
+}
+
+/* Slot index for key with given hash or ~0 if not found. */
+always_inline uword
+clib_flat_hash_find (clib_flat_hash_t * h, void * key, uword hv)
+{
+  uword g, step, mask, i;
+  u8 * ctrl, tag = hv & 0x7f;
+  u32 m;
+
+  if (! h->ctrl)
+    return ~0;
+
+  mask = pow2_mask (h->log2_n_groups);
+  g = (hv >> 7) & mask;
+
+  /* Triangular probing over groups visits every group once. */
+  for (step = 1; ; step++)
+    {
+      ctrl = h->ctrl + g * CLIB_FLAT_HASH_GROUP_SIZE;
+      m = clib_flat_hash_group_match (ctrl, tag);
+      while (m)
+	{
+	  i = g * CLIB_FLAT_HASH_GROUP_SIZE + log2_first_set (m);
+	  if (! memcmp (clib_flat_hash_slot (h, i), key, h->key_bytes))
+	    return i;
+	  m &= m - 1;
+	}
+
+      /* Key would have been placed in an empty slot of this group. */
+      if (clib_flat_hash_group_match (ctrl, CLIB_FLAT_HASH_CTRL_EMPTY))
+	return ~0;
+
+      g = (g + step) & mask;
+    }
+}
+
+/* Pointer to value for key or zero if not found. */
+always_inline void *
+clib_flat_hash_get_mem (clib_flat_hash_t * h, void * key)
+{
+  uword i;
+
+  if (h->n_elts == 0)
+    return 0;
+
+  i = clib_flat_hash_find (h, key, clib_flat_hash_key_sum (h, key));
+  return i == ~0 ? 0 : clib_flat_hash_slot (h, i) + h->value_offset;
+}
+
+/* Macro API: KEY and VALUE are lvalues of table's key and value size. */
+#define clib_flat_hash_get(h,key)					\
+({									\
+  ASSERT (sizeof (key) == (h)->key_bytes);				\
+  clib_flat_hash_get_mem ((h), &(key));					\
+})
+
+#define clib_flat_hash_set(h,key,value)					\
+({									\
+  ASSERT (sizeof (key) == (h)->key_bytes);				\
+  ASSERT (sizeof (value) == (h)->value_bytes);				\
+  clib_flat_hash_set_mem ((h), &(key), &(value), 0);			\
+})
+
+#define clib_flat_hash_unset(h,key)					\
+({									\
+  ASSERT (sizeof (key) == (h)->key_bytes);				\
+  clib_flat_hash_unset_mem ((h), &(key), 0);				\
+})
+
+/* Iterate over table with K and V pointing to key and value. */
+#define clib_flat_hash_foreach(k,v,h,body)				\
+do {									\
+  uword _clib_flat_hash_i;						\
+  for (_clib_flat_hash_i = 0;						\
+       _clib_flat_hash_i < clib_flat_hash_capacity (h);		\
+       _clib_flat_hash_i++)						\
+    {									\
+      if ((h)->ctrl[_clib_flat_hash_i] & 0x80)				\
+	continue;							\
+      (k) = (void *) clib_flat_hash_slot ((h), _clib_flat_hash_i);	\
+      (v) = (void *) ((u8 *) (k) + (h)->value_offset);		\
+      do { body; } while (0);						\
+    }									\
+} while (0)
+
+#endif /* included_clib_flat_hash_h */
@@ -71,6 +71,7 @@ _ (format_time_float);
 _ (format_clib_mem_usage);
 _ (format_sockaddr);
 _ (format_symbol_with_address);
+_ (format_symbol_name);
 
 #undef _
 
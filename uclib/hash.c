@@ -196,6 +196,216 @@ uword hash_memory (void * p, word n_bytes, uword state)
 #endif
 }
 
+/* 64 x 64 => 128 bit multiply; returns low half. */
+always_inline u64 hash_mul64 (u64 a, u64 b, u64 * hi)
+{
+#if uword_bits == 64 && defined (__SIZEOF_INT128__)
+  unsigned __int128 r = (unsigned __int128) a * b;
+  *hi = r >> 64;
+  return r;
+#else
+  u64 ha = a >> 32, la = (u32) a, hb = b >> 32, lb = (u32) b;
+  u64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  u64 t, lo, c;
+  t = rl + (rm0 << 32);
+  c = t < rl;
+  lo = t + (rm1 << 32);
+  c += lo < t;
+  *hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+  return lo;
+#endif
+}
+
+/* Multiply and fold high half into low half. */
+always_inline u64 hash_mum64 (u64 a, u64 b)
+{
+  u64 hi, lo = hash_mul64 (a, b, &hi);
+  return lo ^ hi;
+}
+
+always_inline u64 hash_load_u32_as_u64 (u8 * p)
+{ return clib_mem_unaligned (p, u32); }
+
+#define HASH_WIDE_K0 0xa0761d6478bd642fULL
+#define HASH_WIDE_K1 0xe7037ed1a0b428dbULL
+#define HASH_WIDE_K2 0x8ebc6af09c88c6e3ULL
+#define HASH_WIDE_K3 0x589965cc75374cc3ULL
+
+/* Multiply-mix hash in the style of wyhash: 16 bytes per 64 x 64 => 128
+   bit multiply, three independent lanes for long keys.  Never reads
+   outside [p, p + n_bytes). */
+u64 hash_memory_wide (void * p, word n_bytes, u64 seed)
+{
+  u8 * q = p;
+  uword n = n_bytes;
+  u64 a, b;
+
+  seed ^= hash_mum64 (seed ^ HASH_WIDE_K0, HASH_WIDE_K1);
+
+  if (n <= 16)
+    {
+      if (n >= 4)
+	{
+	  uword o = (n >> 3) << 2;
+	  a = (hash_load_u32_as_u64 (q) << 32) | hash_load_u32_as_u64 (q + o);
+	  b = (hash_load_u32_as_u64 (q + n - 4) << 32) | hash_load_u32_as_u64 (q + n - 4 - o);
+	}
+      else if (n > 0)
+	{
+	  a = ((u64) q[0] << 16) | ((u64) q[n >> 1] << 8) | q[n - 1];
+	  b = 0;
+	}
+      else
+	a = b = 0;
+    }
+  else
+    {
+      if (n > 48)
+	{
+	  u64 s1 = seed, s2 = seed;
+	  do {
+	    seed = hash_mum64 (clib_mem_unaligned (q + 0, u64) ^ HASH_WIDE_K1,
+			       clib_mem_unaligned (q + 8, u64) ^ seed);
+	    s1 = hash_mum64 (clib_mem_unaligned (q + 16, u64) ^ HASH_WIDE_K2,
+			     clib_mem_unaligned (q + 24, u64) ^ s1);
+	    s2 = hash_mum64 (clib_mem_unaligned (q + 32, u64) ^ HASH_WIDE_K3,
+			     clib_mem_unaligned (q + 40, u64) ^ s2);
+	    q += 48;
+	    n -= 48;
+	  } while (n > 48);
+	  seed ^= s1 ^ s2;
+	}
+
+      while (n > 16)
+	{
+	  seed = hash_mum64 (clib_mem_unaligned (q + 0, u64) ^ HASH_WIDE_K1,
+			     clib_mem_unaligned (q + 8, u64) ^ seed);
+	  q += 16;
+	  n -= 16;
+	}
+
+      /* Last 16 bytes (may overlap bytes already hashed). */
+      a = clib_mem_unaligned (q + n - 16, u64);
+      b = clib_mem_unaligned (q + n - 8, u64);
+    }
+
+  a = hash_mul64 (a ^ HASH_WIDE_K1, b ^ seed, &b);
+  return hash_mum64 (a ^ HASH_WIDE_K0 ^ n_bytes, b ^ HASH_WIDE_K1);
+}
+
+#if defined (__SSE4_2__) || defined (__ARM_FEATURE_CRC32)
+#define CLIB_HAVE_HASH_CRC32C
+#endif
+
+#ifdef __SSE4_2__
+#define hash_crc32c_u8(c,x) __builtin_ia32_crc32qi (c, x)
+#define hash_crc32c_u32(c,x) __builtin_ia32_crc32si (c, x)
+#if uword_bits == 64
+#define hash_crc32c_u64(c,x) __builtin_ia32_crc32di (c, x)
+#endif
+#elif defined (__ARM_FEATURE_CRC32)
+#define hash_crc32c_u8(c,x) __builtin_aarch64_crc32cb (c, x)
+#define hash_crc32c_u32(c,x) __builtin_aarch64_crc32cw (c, x)
+#define hash_crc32c_u64(c,x) __builtin_aarch64_crc32cx (c, x)
+#else
+/* Table driven fallback (reflected Castagnoli polynomial). */
+static u32 hash_crc32c_table[256];
+static volatile u32 hash_crc32c_table_valid;
+
+#if defined (__x86_64__) && defined (__GNUC__)
+/* Default x86_64 builds lack -msse4.2: check cpu at run time instead. */
+#define CLIB_HASH_CRC32C_RUNTIME_SSE42
+static u32 hash_crc32c_have_sse42;
+
+static never_inline __attribute__ ((target ("sse4.2"))) u32
+hash_crc32c_sse42 (u8 * q, uword n, u32 c)
+{
+  while (n >= sizeof (u64))
+    {
+      c = __builtin_ia32_crc32di (c, clib_mem_unaligned (q, u64));
+      q += sizeof (u64);
+      n -= sizeof (u64);
+    }
+  while (n > 0)
+    {
+      c = __builtin_ia32_crc32qi (c, q[0]);
+      q++;
+      n--;
+    }
+  return c;
+}
+#endif
+
+static never_inline void hash_crc32c_table_init (void)
+{
+  u32 i, j, c;
+
+  for (i = 0; i < ARRAY_LEN (hash_crc32c_table); i++)
+    {
+      c = i;
+      for (j = 0; j < 8; j++)
+	c = (c >> 1) ^ (0x82f63b78 & -(c & 1));
+      hash_crc32c_table[i] = c;
+    }
+
+#ifdef CLIB_HASH_CRC32C_RUNTIME_SSE42
+  __builtin_cpu_init ();
+  hash_crc32c_have_sse42 = __builtin_cpu_supports ("sse4.2");
+#endif
+
+  /* Table must be complete before other threads see it valid. */
+  CLIB_MEMORY_BARRIER ();
+  hash_crc32c_table_valid = 1;
+}
+
+static_always_inline u32 hash_crc32c_u8 (u32 c, u8 x)
+{ return (c >> 8) ^ hash_crc32c_table[(c ^ x) & 0xff]; }
+#endif
+
+/* CRC-32C (Castagnoli) of memory; with seed zero this is standard CRC-32C.
+   Uses crc32 instructions when compiled for SSE4.2 or ARMv8 CRC and,
+   on x86_64, when cpu supports SSE4.2. */
+u32 hash_memory_crc32c (void * p, word n_bytes, u32 seed)
+{
+  u8 * q = p;
+  uword n = n_bytes;
+  u32 c = ~seed;
+
+#ifndef CLIB_HAVE_HASH_CRC32C
+  if (PREDICT_FALSE (! hash_crc32c_table_valid))
+    hash_crc32c_table_init ();
+#ifdef CLIB_HASH_CRC32C_RUNTIME_SSE42
+  if (PREDICT_TRUE (hash_crc32c_have_sse42))
+    return ~hash_crc32c_sse42 (q, n, c);
+#endif
+#endif
+
+#ifdef hash_crc32c_u64
+  while (n >= sizeof (u64))
+    {
+      c = hash_crc32c_u64 (c, clib_mem_unaligned (q, u64));
+      q += sizeof (u64);
+      n -= sizeof (u64);
+    }
+#endif
+#ifdef hash_crc32c_u32
+  while (n >= sizeof (u32))
+    {
+      c = hash_crc32c_u32 (c, clib_mem_unaligned (q, u32));
+      q += sizeof (u32);
+      n -= sizeof (u32);
+    }
+#endif
+  while (n > 0)
+    {
+      c = hash_crc32c_u8 (c, q[0]);
+      q++;
+      n--;
+    }
+
+  return ~c;
+}
+
 #if uword_bits == 64
 always_inline uword hash_uword (uword x)
 {
@@ -243,6 +453,24 @@ always_inline uword key_sum (hash_t * h, uword key)
       sum = string_key_sum (h, key);  
       break;
 
+    case KEY_FUNC_MEM_WIDE:
+      sum = hash_memory_wide (uword_to_pointer (key, void *), h->user, 0);
+      break;
+
+    case KEY_FUNC_VEC_WIDE:
+      {
+	void * v = uword_to_pointer (key, void *);
+	sum = hash_memory_wide (v, vec_len (v) * h->user, 0);
+      }
+      break;
+
+    case KEY_FUNC_STRING_WIDE:
+      {
+	char * v = uword_to_pointer (key, char *);
+	sum = hash_memory_wide (v, strlen (v), 0);
+      }
+      break;
+
     default:
       sum = h->key_sum (h, key);
       break;
@@ -267,9 +495,18 @@ always_inline uword key_equal1 (hash_t * h, uword key1, uword key2, uword e)
       break;
 
     case KEY_FUNC_STRING:
+    case KEY_FUNC_STRING_WIDE:
       e = string_key_equal (h, key1, key2);  
       break;
 
+    case KEY_FUNC_MEM_WIDE:
+      e = mem_key_equal (h, key1, key2);
+      break;
+
+    case KEY_FUNC_VEC_WIDE:
+      e = vec_key_equal (h, key1, key2);
+      break;
+
     default:
       e = h->key_equal (h, key1, key2);
       break;
@@ -524,6 +761,21 @@ static hash_pair_t * lookup (void * v, uword key, enum lookup_opcode op,
   return &p->hash_pair_direct;
 }
 
+/* Lookup in table and then in old table when incremental resize is in progress. */
+static_always_inline hash_pair_t * lookup_get (void * v, uword key)
+{
+  hash_t * h = hash_header (v);
+  hash_pair_t * p;
+
+  if (! v)
+    return 0;
+
+  p = lookup (v, key, GET, 0, 0);
+  if (! p && h->resize_old_table)
+    p = lookup (h->resize_old_table, key, GET, 0, 0);
+  return p;
+}
+
 /* Fetch value of key. */
 uword * _hash_get (void * v, uword key)
 {
@@ -531,10 +783,10 @@ uword * _hash_get (void * v, uword key)
   hash_pair_t * p;
 
   /* Don't even search table if its empty. */
-  if (! v || h->elts == 0)
+  if (! v || hash_elts (v) == 0)
     return 0;
 
-  p = lookup (v, key, GET, 0, 0);
+  p = lookup_get (v, key);
   if (! p)
     return 0;
   if (h->log2_pair_size == 0)
@@ -544,12 +796,100 @@ uword * _hash_get (void * v, uword key)
 }
 
 hash_pair_t * _hash_get_pair (void * v, uword key)
-{ return lookup (v, key, GET, 0, 0); }
+{ return lookup_get (v, key); }
+
+uword hash_key_bucket (void * v, uword key)
+{ return key_sum (hash_header (v), key) & (_vec_len (v) - 1); }
+
+void hash_prefetch_bucket (void * v, uword i)
+{
+  hash_t * h = hash_header (v);
+  CLIB_PREFETCH (get_pair (v, i), sizeof (hash_pair_t) << h->log2_pair_size, LOAD);
+  CLIB_PREFETCH (&h->is_user[i / BITS (h->is_user[0])], sizeof (h->is_user[0]), LOAD);
+}
+
+hash_pair_t * hash_prefetch_bucket_pairs (void * v, uword i)
+{
+  hash_pair_union_t * p = get_pair (v, i);
+
+  if (hash_is_user (v, i))
+    return &p->hash_pair_direct;
+
+  /* Prefetch first pairs of indirect bucket. */
+  if (p->hash_pair_indirect.pairs)
+    CLIB_PREFETCH (p->hash_pair_indirect.pairs, 2*CLIB_CACHE_LINE_BYTES, LOAD);
+  return 0;
+}
+
+hash_pair_t * hash_get_pair_in_bucket (void * v, uword key, uword i)
+{
+  hash_t * h = hash_header (v);
+  hash_pair_union_t * p = get_pair (v, i);
+
+  if (hash_is_user (v, i))
+    p = key_equal (h, p->hash_pair_direct.key, key) ? p : 0;
+  else
+    p = get_indirect (v, &p->hash_pair_indirect, key);
+
+  if (! p)
+    return h->resize_old_table ? lookup (h->resize_old_table, key, GET, 0, 0) : 0;
+
+  return &p->hash_pair_direct;
+}
+
+/* Lookups are done in batches: sum all keys and prefetch buckets,
+   then prefetch indirect pairs, then compare keys. */
+#define HASH_GET_MULTI_BATCH 16
+
+void _hash_get_multi (void * v, uword * keys, uword n_keys, uword ** results)
+{
+  hash_t * h = hash_header (v);
+  uword buckets[HASH_GET_MULTI_BATCH];
+  uword i, n;
+  hash_pair_t * p;
+
+  if (! v || hash_elts (v) == 0)
+    {
+      memset (results, 0, n_keys * sizeof (results[0]));
+      return;
+    }
+
+  while (n_keys > 0)
+    {
+      n = clib_min (n_keys, HASH_GET_MULTI_BATCH);
+
+      for (i = 0; i < n; i++)
+	{
+	  buckets[i] = hash_key_bucket (v, keys[i]);
+	  hash_prefetch_bucket (v, buckets[i]);
+	}
+
+      for (i = 0; i < n; i++)
+	hash_prefetch_bucket_pairs (v, buckets[i]);
+
+      for (i = 0; i < n; i++)
+	{
+	  p = hash_get_pair_in_bucket (v, keys[i], buckets[i]);
+	  if (! p)
+	    results[i] = 0;
+	  else if (h->log2_pair_size == 0)
+	    results[i] = &p->key;
+	  else
+	    results[i] = &p->value[0];
+	}
+
+      keys += n;
+      results += n;
+      n_keys -= n;
+    }
+}
 
 hash_pair_t * hash_next (void * v, hash_next_t * hn)
 {
   hash_t * h = hash_header (v);
   hash_pair_t * p;
+  void * t;
+  uword i;
 
   while (1)
     {
@@ -564,7 +904,7 @@ hash_pair_t * hash_next (void * v, hash_next_t * hn)
 	       | HASH_FLAG_NO_AUTO_SHRINK
 	       | HASH_FLAG_HASH_NEXT_IN_PROGRESS);
 	}
-      else if (hn->i >= hash_capacity (v))
+      else if (hn->i >= hash_capacity (v) + hash_capacity (h->resize_old_table))
 	{
 	  /* Restore flags. */
 	  h->flags = hn->f;
@@ -572,8 +912,18 @@ hash_pair_t * hash_next (void * v, hash_next_t * hn)
 	  return 0;
 	}
 
-      p = hash_forward (h, v, hn->i);
-      if (hash_is_user (v, hn->i))
+      /* Buckets of old table (if any) follow those of table.
+	 Buckets are not moved while HASH_NEXT_IN_PROGRESS is set. */
+      t = v;
+      i = hn->i;
+      if (i >= hash_capacity (v))
+	{
+	  t = h->resize_old_table;
+	  i -= hash_capacity (v);
+	}
+
+      p = hash_forward (h, t, i);
+      if (hash_is_user (t, i))
 	{
 	  hn->i++;
 	  return p;
@@ -599,6 +949,71 @@ hash_pair_t * hash_next (void * v, hash_next_t * hn)
     }
 }
 
+/* Move next few buckets of old table into table; free old table
+   once all buckets have been moved. */
+static void hash_resize_step (void * v, uword n_buckets)
+{
+  hash_t * h = hash_header (v);
+  void * old = h->resize_old_table;
+  hash_t * ho = hash_header (old);
+  hash_pair_union_t * p;
+  hash_pair_t * q, * q_end;
+  uword i, i_end;
+
+  /* Keep iteration order stable for hash_next. */
+  if (h->flags & HASH_FLAG_HASH_NEXT_IN_PROGRESS)
+    return;
+
+  i_end = clib_min (h->resize_old_bucket + n_buckets, hash_capacity (old));
+  for (i = h->resize_old_bucket; i < i_end; i++)
+    {
+      p = get_pair (old, i);
+      if (hash_is_user (old, i))
+	{
+	  lookup (v, p->hash_pair_direct.key, SET, p->hash_pair_direct.value, 0);
+	  hash_zero_pair (ho, &p->hash_pair_direct);
+	  set_is_user (old, i, 0);
+	  ho->elts -= 1;
+	  continue;
+	}
+
+      q = p->hash_pair_indirect.pairs;
+      if (! q)
+	continue;
+
+      if (ho->log2_pair_size > 0)
+	q_end = hash_forward (ho, q, indirect_pair_get_len (&p->hash_pair_indirect));
+      else
+	q_end = vec_end (q);
+
+      for (; q < q_end; q = hash_forward1 (ho, q))
+	{
+	  lookup (v, q->key, SET, q->value, 0);
+	  ho->elts -= 1;
+	}
+
+      if (ho->log2_pair_size > 0)
+	clib_mem_free (p->hash_pair_indirect.pairs);
+      else
+	vec_free (p->hash_pair_indirect.pairs);
+      hash_zero_pair (ho, &p->hash_pair_direct);
+    }
+
+  h->resize_old_bucket = i;
+  if (i >= hash_capacity (old))
+    {
+      ASSERT (ho->elts == 0);
+      hash_free (old);
+      h->resize_old_table = 0;
+      h->resize_old_bucket = 0;
+    }
+}
+
+/* Number of old buckets moved per set or unset.  Old table has half
+   as many buckets as new so moving completes well before new table
+   needs to grow again. */
+#define HASH_RESIZE_BUCKETS_PER_CALL 8
+
 /* Remove key from table. */
 void * _hash_unset (void * v, uword key, void * old_value)
 {
@@ -607,10 +1022,18 @@ void * _hash_unset (void * v, uword key, void * old_value)
   if (! v)
     return v;
 
+  h = hash_header (v);
+  if (h->resize_old_table)
+    {
+      /* Key is in at most one of the two tables. */
+      (void) lookup (h->resize_old_table, key, UNSET, 0, old_value);
+      hash_resize_step (v, HASH_RESIZE_BUCKETS_PER_CALL);
+    }
+
   (void) lookup (v, key, UNSET, 0, old_value);
 
   h = hash_header (v);
-  if (! (h->flags & HASH_FLAG_NO_AUTO_SHRINK))
+  if (! (h->flags & HASH_FLAG_NO_AUTO_SHRINK) && ! h->resize_old_table)
     {
       /* Resize when 1/4 full. */
       if (h->elts > 32 && 4 * (h->elts + 1) < vec_len (v))
@@ -648,6 +1071,8 @@ void * _hash_create (uword elts, hash_t * h_user)
 
   h->log2_pair_size = log2_pair_size;
   h->elts = 0;
+  h->resize_old_table = 0;
+  h->resize_old_bucket = 0;
 
   /* Default flags to never shrinking hash tables.
      Shrinking tables can cause "jackpot" cases. */
@@ -672,6 +1097,9 @@ void * _hash_free (void * v)
   if (! v)
     return v;
 
+  if (h->resize_old_table)
+    _hash_free (h->resize_old_table);
+
   /* We zero all freed memory in case user would be tempted to use it. */
   for (i = 0; i < hash_capacity (v); i++)
     {
@@ -723,13 +1151,47 @@ void * _hash_set3 (void * v, uword key, void * value, void * old_value)
     v = hash_create (0, sizeof (uword));
 
   h = hash_header (v);
+
+  if (h->resize_old_table)
+    {
+      hash_pair_t * p;
+
+      /* Update key in place if it has not yet been moved. */
+      p = lookup (h->resize_old_table, key, GET, 0, 0);
+      if (p)
+	{
+	  hash_t * ho = hash_header (h->resize_old_table);
+	  if (old_value)
+	    memcpy (old_value, p->value, hash_value_bytes (ho));
+	  memcpy (p->value, value, hash_value_bytes (ho));
+	}
+      else
+	(void) lookup (v, key, SET, value, old_value);
+
+      hash_resize_step (v, HASH_RESIZE_BUCKETS_PER_CALL);
+      return v;
+    }
+
   (void) lookup (v, key, SET, value, old_value);
 
   if (! (h->flags & HASH_FLAG_NO_AUTO_GROW))
     {
       /* Resize when 3/4 full. */
       if (4 * (h->elts + 1) > 3 * vec_len (v))
-	v = hash_resize (v, 2 * vec_len (v));
+	{
+	  if (h->flags & HASH_FLAG_INCREMENTAL_RESIZE)
+	    {
+	      void * old = v;
+
+	      /* Start with empty table; old table's buckets are moved
+		 by subsequent sets and unsets. */
+	      v = _hash_create (2 * vec_len (old), h);
+	      h = hash_header (v);
+	      h->resize_old_table = old;
+	    }
+	  else
+	    v = hash_resize (v, 2 * vec_len (v));
+	}
     }
 
   return v;
@@ -863,6 +1325,7 @@ uword hash_bytes (void * v)
     return 0;
 
   bytes = vec_capacity (v, hash_header_bytes (v));
+  bytes += hash_bytes (h->resize_old_table);
 
   for (i = 0; i < hash_capacity (v); i++)
     {
@@ -890,6 +1353,11 @@ u8 * format_hash (u8 * s, va_list * va)
 	      v, hash_elts (v), hash_capacity (v),
 	      hash_bytes (v));
 
+  if (h->resize_old_table)
+    s = format (s, "  resizing: %wd of %wd old buckets moved, %wd elts left\n",
+		h->resize_old_bucket, hash_capacity (h->resize_old_table),
+		hash_header (h->resize_old_table)->elts);
+
   {
     uword * occupancy = 0;
 
@@ -45,6 +45,13 @@ typedef struct hash_header {
 #define HASH_FLAG_NO_AUTO_SHRINK	(1 << 1)
   /* Set when hash_next is in the process of iterating through this hash table. */
 #define HASH_FLAG_HASH_NEXT_IN_PROGRESS (1 << 2)
+  /* Set to grow table incrementally: old table is kept and its buckets
+     are moved a few at a time by set and unset (see resize_old_table).
+     hash_foreach holds off moves while it walks, so hash_set of
+     existing keys in its body sees each pair once as without this flag.
+     As for any table, body must not add or unset keys: indirect
+     buckets are reallocated and a resize may start. */
+#define HASH_FLAG_INCREMENTAL_RESIZE	(1 << 3)
 
   u32 log2_pair_size;
 
@@ -58,6 +65,10 @@ typedef struct hash_header {
 #define KEY_FUNC_POINTER_UWORD	(1) /*< sum = *(uword *) key */
 #define KEY_FUNC_POINTER_U32	(2) /*< sum = *(u32 *) key */
 #define KEY_FUNC_STRING         (3) /*< sum = string_key_sum, etc. */
+  /* As mem/vec/string key functions but with hash_memory_wide. */
+#define KEY_FUNC_MEM_WIDE	(4) /*< sum = hash_memory_wide of h->user bytes */
+#define KEY_FUNC_VEC_WIDE	(5) /*< sum = hash_memory_wide of vector, h->user bytes per elt */
+#define KEY_FUNC_STRING_WIDE	(6) /*< sum = hash_memory_wide of c string */
 
   /* key comparison function */
   hash_key_equal_function_t * key_equal;
@@ -71,6 +82,12 @@ typedef struct hash_header {
   /* Format function arg */
   void * format_pair_arg;
 
+  /* With HASH_FLAG_INCREMENTAL_RESIZE: table being emptied into this
+     one (or zero) and index of its next bucket to move.  Each key is
+     in exactly one of the two tables. */
+  void * resize_old_table;
+  uword resize_old_bucket;
+
   /* Bit i is set if pair i is a user object (as opposed to being
      either zero or an indirect array of pairs). */
   uword is_user[0];
@@ -92,7 +109,14 @@ always_inline hash_t * hash_header (void * v)
 always_inline uword hash_elts (void * v)
 {
   hash_t * h = hash_header (v);
-  return v ? h->elts : 0;
+  uword n;
+  if (! v)
+    return 0;
+  n = h->elts;
+  /* Old table never has an old table of its own. */
+  if (h->resize_old_table)
+    n += hash_header (h->resize_old_table)->elts;
+  return n;
 }
 
 /* Number of elements the hash table can hold */
@@ -186,6 +210,19 @@ uword * _hash_get (void * v, uword key);
 /* internal routine to fetch value (key, value) pair for given key */
 hash_pair_t * _hash_get_pair (void * v, uword key);
 
+/* internal routine to fetch values for n_keys keys: results[i] is value
+   pointer for keys[i] or 0 if not found.  Memory latency is overlapped
+   by prefetching buckets for a batch of keys before comparing keys. */
+void _hash_get_multi (void * v, uword * keys, uword n_keys, uword ** results);
+
+/* Steps of batched lookup for users (e.g. mhash) with their own key
+   handling: bucket of key; prefetch bucket; prefetch pairs of indirect
+   bucket (returns pair of direct bucket); lookup key given its bucket. */
+uword hash_key_bucket (void * v, uword key);
+void hash_prefetch_bucket (void * v, uword bucket);
+hash_pair_t * hash_prefetch_bucket_pairs (void * v, uword bucket);
+hash_pair_t * hash_get_pair_in_bucket (void * v, uword key, uword bucket);
+
 /* internal routine to unset a (key, value) pair */
 void *  _hash_unset (void * v, uword key, void * old_value);
 
@@ -211,6 +248,10 @@ uword hash_bytes (void * v);
 /* Public macro to fetch value for given key */
 #define hash_get(h,key)		_hash_get ((h), (uword) (key))
 
+/* Public macro to fetch values for vector of keys */
+#define hash_get_multi(h,keys,n_keys,results) \
+  _hash_get_multi ((h), (uword *) (keys), (n_keys), (results))
+
 /* Public macro to fetch value (key, value) pair for given key */
 #define hash_get_pair(h,key)	_hash_get_pair ((h), (uword) (key))
 
@@ -231,6 +272,10 @@ uword hash_bytes (void * v);
 /* Public macro to fetch value for given pointer key */
 #define hash_get_mem(h,key)	_hash_get ((h), pointer_to_uword (key))
 
+/* Public macro to fetch values for vector of pointer keys */
+#define hash_get_multi_mem(h,keys,n_keys,results) \
+  _hash_get_multi ((h), (uword *) (keys), (n_keys), (results))
+
 /* Public macro to fetch (key, value) for given pointer key */
 #define hash_get_pair_mem(h,key) _hash_get_pair ((h), pointer_to_uword (key))
 
@@ -294,17 +339,32 @@ always_inline void * hash_forward (hash_t * h, void * v, uword n)
 #define hash_foreach_pair(p,v,body)                                     \
 do {                                                                    \
  __label__ hash_var(hash_foreach_done);                                 \
-  hash_t * hash_var(h) = hash_header (v);                               \
+  void * hash_var(table) = (v);                                         \
+  hash_t * hash_var(h_walk) = 0;                                        \
+                                                                        \
+  /* Keep set and unset from moving buckets of an incremental resize   \
+     in progress during walk; table and old table then stay put. */     \
+  if (hash_var(table)                                                   \
+      && hash_header (hash_var(table))->resize_old_table               \
+      && ! (hash_header (hash_var(table))->flags                        \
+            & HASH_FLAG_HASH_NEXT_IN_PROGRESS))                         \
+    {                                                                   \
+      hash_var(h_walk) = hash_header (hash_var(table));                 \
+      hash_var(h_walk)->flags |= HASH_FLAG_HASH_NEXT_IN_PROGRESS;       \
+    }                                                                   \
+                                                                        \
+  /* Visit table then old table when an incremental resize is in progress. */ \
+  while (hash_var(table))                                               \
+  {                                                                     \
+  hash_t * hash_var(h) = hash_header (hash_var(table));                 \
   hash_pair_union_t * hash_var(p);                                      \
   hash_pair_t * hash_var(q), * hash_var(q_end);                         \
   uword hash_var(i), hash_var(i1), hash_var(id), hash_var(pair_increment); \
                                                                         \
-  hash_var(p) = (hash_pair_union_t *) (v);                              \
+  hash_var(p) = (hash_pair_union_t *) (hash_var(table));                \
   hash_var(i) = 0;                                                      \
-  hash_var(pair_increment) = 1;                                         \
-  if ((v))                                                              \
-      hash_var(pair_increment) = 1 << hash_var(h)->log2_pair_size;      \
-  while (hash_var(i) < hash_capacity (v))                               \
+  hash_var(pair_increment) = 1 << hash_var(h)->log2_pair_size;          \
+  while (hash_var(i) < hash_capacity (hash_var(table)))                 \
     {                                                                   \
       hash_var(id) = hash_var(h)->is_user[hash_var(i) / BITS (hash_var(h)->is_user[0])]; \
       hash_var(i1) = hash_var(i) + BITS (hash_var(h)->is_user[0]);      \
@@ -345,7 +405,11 @@ do {                                                                    \
         hash_var(i)++;                                                  \
       } while (hash_var(i) < hash_var(i1));                             \
     }                                                                   \
+  hash_var(table) = hash_var(h)->resize_old_table;                      \
+  }                                                                     \
   hash_var (hash_foreach_done):;                                        \
+  if (hash_var(h_walk))                                                 \
+    hash_var(h_walk)->flags &= ~HASH_FLAG_HASH_NEXT_IN_PROGRESS;        \
  } while (0)
 
 /* Iterate over key/value pairs
@@ -579,12 +643,26 @@ extern u64 hash_memory64 (void * p, word n_bytes, u64 state);
 extern u32 hash_memory32 (void * p, word n_bytes, u32 state);
 extern uword hash_memory (void * p, word n_bytes, uword state);
 
+/* Faster alternatives to hash_memory for long keys. */
+extern u64 hash_memory_wide (void * p, word n_bytes, u64 seed);
+
+/* CRC-32C uses crc32 instructions when built with -msse4.2 or for ARMv8
+   CRC and on x86_64 cpus with SSE4.2 (checked at run time).  Elsewhere
+   it falls back to a byte at a time table, many times slower. */
+extern u32 hash_memory_crc32c (void * p, word n_bytes, u32 seed);
+
 extern uword mem_key_sum (hash_t * h, uword key);
 extern uword mem_key_equal (hash_t * h, uword key1, uword key2);
 
 #define hash_create_mem(elts,key_bytes,value_bytes)	\
   hash_create2((elts),(key_bytes),(value_bytes),mem_key_sum,mem_key_equal,0,0)
 
+#define hash_create_mem_wide(elts,key_bytes,value_bytes)	\
+  hash_create2((elts),(key_bytes),(value_bytes),		\
+               (hash_key_sum_function_t *) KEY_FUNC_MEM_WIDE,	\
+               (hash_key_equal_function_t *) KEY_FUNC_MEM_WIDE,	\
+               0,0)
+
 extern uword vec_key_sum (hash_t * h, uword key);
 extern uword vec_key_equal (hash_t * h, uword key1, uword key2);
 extern u8 * vec_key_format_pair (u8 * s, va_list * args);
@@ -593,6 +671,12 @@ extern u8 * vec_key_format_pair (u8 * s, va_list * args);
   hash_create2((elts),(key_bytes),(value_bytes),\
                vec_key_sum,vec_key_equal,vec_key_format_pair,0)
 
+#define hash_create_vec_wide(elts,key_bytes,value_bytes)	\
+  hash_create2((elts),(key_bytes),(value_bytes),		\
+               (hash_key_sum_function_t *) KEY_FUNC_VEC_WIDE,	\
+               (hash_key_equal_function_t *) KEY_FUNC_VEC_WIDE,	\
+               vec_key_format_pair,0)
+
 extern uword string_key_sum (hash_t * h, uword key);
 extern uword string_key_equal (hash_t * h, uword key1, uword key2);
 extern u8 * string_key_format_pair (u8 * s, va_list * args);
@@ -603,6 +687,12 @@ extern u8 * string_key_format_pair (u8 * s, va_list * args);
                (hash_key_equal_function_t *)KEY_FUNC_STRING,    \
                0, 0)
 
+#define hash_create_string_wide(elts,value_bytes)		\
+  hash_create2((elts),0,(value_bytes),				\
+               (hash_key_sum_function_t *) KEY_FUNC_STRING_WIDE,	\
+               (hash_key_equal_function_t *) KEY_FUNC_STRING_WIDE,	\
+               string_key_format_pair, 0)
+
 #define hash_create(elts,value_bytes)				\
   hash_create2((elts),0,(value_bytes),				\
                (hash_key_sum_function_t *) KEY_FUNC_NONE,	\
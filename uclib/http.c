@@ -24,18 +24,23 @@
 uword unformat_http_header_line (unformat_input_t * input, va_list * va)
 {
   uword c;
-  u8 * vs[2] = {0};
+  /* Build key and value in inline storage; only one exactly sized
+     allocation per string is made once the line is complete. */
+  clib_small_vec_t vs[2];
   u32 saw_colon = 0;
   http_key_and_value_t * result = va_arg (*va, http_key_and_value_t *);
 
+  clib_small_vec_init (&vs[0]);
+  clib_small_vec_init (&vs[1]);
+
   while (1)
     {
       c = unformat_get_input (input);
       switch (c)
         {
         case UNFORMAT_END_OF_INPUT:
-          vec_free (vs[0]);
-          vec_free (vs[1]);
+          clib_small_vec_free (&vs[0]);
+          clib_small_vec_free (&vs[1]);
           return 0;
 
         case '\r':
@@ -43,31 +48,34 @@ uword unformat_http_header_line (unformat_input_t * input, va_list * va)
             unformat_get_input (input);
         case '\n':
           /* Reject empty key with non-empty value. */
-          if (! vs[0] && vs[1])
-            return 0;
-          result->key = vs[0];
-          result->value = vs[1];
+          if (clib_small_vec_len (&vs[0]) == 0 && clib_small_vec_len (&vs[1]) > 0)
+            {
+              clib_small_vec_free (&vs[1]);
+              return 0;
+            }
+          result->key = clib_small_vec_to_vec (&vs[0]);
+          result->value = clib_small_vec_to_vec (&vs[1]);
           return 1;
 
         case ':':
           if (! saw_colon)
             saw_colon = 1;
           else
-            vec_add1 (vs[saw_colon], c); /* colon in value string */
+            clib_small_vec_add1 (&vs[saw_colon], c); /* colon in value string */
           break;
 
         case ' ': case '\t':
-          if (saw_colon && vec_len (vs[saw_colon]) == 0)
+          if (saw_colon && clib_small_vec_len (&vs[saw_colon]) == 0)
             /* skip white space after colon */;
           else
-            vec_add1 (vs[saw_colon], c);
+            clib_small_vec_add1 (&vs[saw_colon], c);
           break;
 
         default:
           /* Normalize keys as lower case. */
           if (! saw_colon && c >= 'A' && c <= 'Z')
             c = (c - 'A') + 'a';
-          vec_add1 (vs[saw_colon], c);
+          clib_small_vec_add1 (&vs[saw_colon], c);
           break;
         }
     }
@@ -125,7 +133,7 @@ http_request_query_unformat_value_for_key (http_request_or_response_t * r, char
 uword unformat_http_request_path (unformat_input_t * input, va_list * va)
 {
   http_request_or_response_t * r = va_arg (*va, http_request_or_response_t *);
-  u8 * vs[2] = {0, 0};
+  clib_small_vec_t vs[2];
   uword saw_question = 0;
   uword saw_equal = 0;
   uword syntax_error = 0;
@@ -134,6 +142,8 @@ uword unformat_http_request_path (unformat_input_t * input, va_list * va)
 
   r->request.path = 0;
   r->request.query = 0;
+  clib_small_vec_init (&vs[0]);
+  clib_small_vec_init (&vs[1]);
 
   while ((c = unformat_get_input (input)) != UNFORMAT_END_OF_INPUT)
     {
@@ -145,36 +155,34 @@ uword unformat_http_request_path (unformat_input_t * input, va_list * va)
         case '?':
           if (! saw_question)
             {
-              r->request.path = vs[0];
-              vs[0] = 0;
+              r->request.path = clib_small_vec_to_vec (&vs[0]);
               saw_question = 1;
             }
           else
-            vec_add1 (vs[saw_equal], c);
+            clib_small_vec_add1 (&vs[saw_equal], c);
           break;
 
         case '&':
           if (saw_question)
             {
-              if (vec_len (vs[0]) == 0)
+              if (clib_small_vec_len (&vs[0]) == 0)
                 {
                   syntax_error = 1;
                   goto done;
                 }
               vec_add2 (r->request.query, kv, 1);
-              kv->key = vs[0];
-              kv->value = vs[1];
-              vs[0] = vs[1] = 0;
+              kv->key = clib_small_vec_to_vec (&vs[0]);
+              kv->value = clib_small_vec_to_vec (&vs[1]);
               saw_equal = 0;
             }
           else
-            vec_add1 (vs[0], c); /* add to path */
+            clib_small_vec_add1 (&vs[0], c); /* add to path */
           break;
 
         case '=':
           if (saw_question)
             {
-              if (saw_equal || vec_len (vs[0]) == 0)
+              if (saw_equal || clib_small_vec_len (&vs[0]) == 0)
                 {
                   syntax_error = 1;
                   goto done;
@@ -182,35 +190,33 @@ uword unformat_http_request_path (unformat_input_t * input, va_list * va)
               saw_equal = 1;
             }
           else
-            vec_add1 (vs[0], c);
+            clib_small_vec_add1 (&vs[0], c);
           break;
 
         default:
           if (saw_question)
-            vec_add1 (vs[saw_equal], c);
+            clib_small_vec_add1 (&vs[saw_equal], c);
           else
-            vec_add1 (vs[0], c); /* add to path */
+            clib_small_vec_add1 (&vs[0], c); /* add to path */
           break;
         }
     }
 
  done:
-  if (! syntax_error && vec_len (vs[0]) > 0)
+  if (! syntax_error && clib_small_vec_len (&vs[0]) > 0)
     {
       if (saw_question)
         {
           vec_add2 (r->request.query, kv, 1);
-          kv->key = vs[0];
-          kv->value = vs[1];
+          kv->key = clib_small_vec_to_vec (&vs[0]);
+          kv->value = clib_small_vec_to_vec (&vs[1]);
         }
       else
-        r->request.path = vs[0];
-
-      vs[0] = vs[1] = 0;
+        r->request.path = clib_small_vec_to_vec (&vs[0]);
     }
 
-  vec_free (vs[0]);
-  vec_free (vs[1]);
+  clib_small_vec_free (&vs[0]);
+  clib_small_vec_free (&vs[1]);
 
   if (syntax_error)
     {
@@ -18,8 +18,9 @@
 
 #include <string.h>
 
-/* Per CPU heaps. */
-extern void * clib_per_cpu_mheaps[32];
+/* Per CPU heaps indexed by cpu number.  Sized by clib_smp_init for
+   all cpus, main thread and foreign threads. */
+extern void ** clib_per_cpu_mheaps;
 
 always_inline void * clib_mem_get_per_cpu_heap (void)
 {
@@ -56,6 +57,12 @@ clib_mem_alloc_aligned_at_offset (uword size,
 
   cpu = os_get_cpu_number ();
   heap = clib_per_cpu_mheaps[cpu];
+
+  /* Inline fast path: this cpu's magazine. */
+  offset = mheap_magazine_get (heap, size, align, align_offset);
+  if (offset != ~0)
+    return heap + offset;
+
   heap = mheap_get_aligned (heap,
 			    size, align, align_offset,
 			    &offset);
@@ -111,9 +118,44 @@ clib_mem_alloc_in_container (uword sizeof_object, uword sizeof_container, uword
 /* Alias to stack allocator for naming consistency. */
 #define clib_mem_alloc_stack(bytes) __builtin_alloca(bytes)
 
+/* Heap which given object was allocated from.  Objects in the per-cpu
+   and global heaps made by clib_smp_init are found by address; all others
+   (including heaps made elsewhere in a cpu's VM slot, e.g. on its stack)
+   are assumed to be in this cpu's current heap or, when current heap is
+   an arena not containing object, the heap arena was pushed on. */
+always_inline void * clib_mem_heap_for_object (void * p)
+{
+  clib_smp_main_t * m = &clib_smp_main;
+  mheap_t * h;
+  void * heap;
+  uword cpu;
+
+  if (m->vm_base)
+    {
+      cpu = (pointer_to_uword (p) - pointer_to_uword (m->vm_base)) >> m->log2_n_per_cpu_vm_bytes;
+      if (cpu < vec_len (m->per_cpu_mains)
+	  && (heap = m->per_cpu_mains[cpu].heap)
+	  && (uword) (p - heap) < mheap_max_size (heap))
+	return heap;
+    }
+
+  heap = clib_mem_get_per_cpu_heap ();
+  while (heap)
+    {
+      h = mheap_header (heap);
+      if (PREDICT_TRUE (! (h->flags & MHEAP_FLAG_ARENA))
+	  || ! h->arena_parent_heap
+	  || (uword) (p - heap) < h->max_size)
+	break;
+      heap = h->arena_parent_heap;
+    }
+
+  return heap;
+}
+
 always_inline uword clib_mem_is_heap_object (void * p)
 {
-  void * heap = clib_mem_get_per_cpu_heap ();
+  void * heap = clib_mem_heap_for_object (p);
   uword offset = p - heap;
   mheap_elt_t * e, * n;
 
@@ -129,11 +171,24 @@ always_inline uword clib_mem_is_heap_object (void * p)
 
 always_inline void clib_mem_free (void * p)
 {
-  u8 * heap = clib_mem_get_per_cpu_heap ();
+  u8 * heap = clib_mem_heap_for_object (p);
+  mheap_t * h = mheap_header (heap);
 
   /* Make sure object is in the correct heap. */
   ASSERT (clib_mem_is_heap_object (p));
 
+  /* Object belongs to another cpu's heap: hand it back to its owner. */
+  if (PREDICT_FALSE ((h->flags & MHEAP_FLAG_REMOTE_FREE)
+		     && h->owner_cpu != os_get_cpu_number ()))
+    {
+      mheap_put_remote (heap, (u8 *) p - heap);
+      return;
+    }
+
+  /* Inline fast path: this cpu's magazine. */
+  if (mheap_magazine_put (heap, (u8 *) p - heap))
+    return;
+
   mheap_put (heap, (u8 *) p - heap);
 }
 
@@ -141,10 +196,30 @@ always_inline void
 clib_mem_free_in_container (void * object, uword container_offset_of_object)
 { clib_mem_free (object - container_offset_of_object); }
 
+/* Grow object in place into following free heap space.
+   Returns 0 if object could not be grown. */
+always_inline uword clib_mem_realloc_in_place (void * p, uword new_size)
+{
+  u8 * heap = clib_mem_heap_for_object (p);
+  mheap_t * h = mheap_header (heap);
+
+  /* Only owner may modify a per-cpu heap. */
+  if ((h->flags & MHEAP_FLAG_REMOTE_FREE)
+      && h->owner_cpu != os_get_cpu_number ())
+    return 0;
+
+  return mheap_realloc (heap, (u8 *) p - heap, new_size);
+}
+
 always_inline void * clib_mem_realloc (void * p, uword new_size, uword old_size)
 {
-  /* By default use alloc, copy and free to emulate realloc. */
-  void * q = clib_mem_alloc (new_size);
+  void * q;
+
+  if (clib_mem_realloc_in_place (p, new_size))
+    return p;
+
+  /* Otherwise use alloc, copy and free to emulate realloc. */
+  q = clib_mem_alloc (new_size);
   if (q)
     {
       uword copy_size;
@@ -160,7 +235,7 @@ always_inline void * clib_mem_realloc (void * p, uword new_size, uword old_size)
 
 always_inline uword clib_mem_size (void * p)
 {
-  void * heap = clib_mem_get_per_cpu_heap ();
+  void * heap = clib_mem_heap_for_object (p);
   ASSERT (clib_mem_is_heap_object (p));
   return mheap_data_bytes (heap, p - heap);
 }
@@ -172,6 +247,7 @@ always_inline void * clib_mem_set_heap (void * heap)
 { return clib_mem_set_per_cpu_heap (heap); }
 
 void * clib_mem_init (void * heap, uword size);
+void * clib_mem_init_with_flags (void * heap, uword size, uword mheap_flags);
 
 void clib_mem_exit (void);
 
@@ -195,6 +271,10 @@ typedef struct {
 
   /* Amount of free space returned to operating system. */
   uword bytes_free_reclaimed;
+
+  /* Bytes given back to operating system by mheap_trim.  Pages
+     given back more than once are counted each time. */
+  uword bytes_trimmed;
   
   /* For malloc which puts small objects in sbrk region and
      large objects in mmap'ed regions. */
@@ -207,4 +287,7 @@ typedef struct {
 
 void clib_mem_usage (clib_mem_usage_t * usage);
 
+/* Give free memory in current heap back to operating system. */
+uword clib_mem_trim (uword target_bytes);
+
 #endif /* included_uclib_mem_h */
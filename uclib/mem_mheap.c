@@ -23,11 +23,16 @@
 
 clib_smp_main_t clib_smp_main = {
   .n_cpus = 0,
+  .max_foreign_threads = 16,
   .log2_n_per_cpu_stack_bytes = 20,
   .log2_n_per_cpu_vm_bytes = 28,
 };
 
-void * clib_per_cpu_mheaps[32];
+__thread uword clib_smp_cpu_index_plus_one;
+
+/* Until clib_smp_init all threads are cpu 0. */
+static void * clib_per_cpu_mheaps_bootstrap[1];
+void ** clib_per_cpu_mheaps = clib_per_cpu_mheaps_bootstrap;
 
 void clib_mem_exit (void)
 {
@@ -38,13 +43,16 @@ void clib_mem_exit (void)
 }
 
 /* Initialize CLIB heap based on memory/size given by user.
-   Set memory to 0 and CLIB will try to allocate its own heap. */
-void * clib_mem_init (void * memory, uword memory_size)
+   Set memory to 0 and CLIB will try to allocate its own heap.
+   Extra mheap flags (e.g. MHEAP_FLAG_HUGE_PAGES) are added to defaults. */
+void * clib_mem_init_with_flags (void * memory, uword memory_size, uword flags)
 {
   u8 * heap;
 
+  flags |= mheap_default_flags (memory);
+
   if (memory || memory_size)
-    heap = mheap_alloc (memory, memory_size);
+    heap = mheap_alloc_with_flags (memory, memory_size, flags);
   else
     {
       /* Allocate lots of address space since this will limit
@@ -62,7 +70,7 @@ void * clib_mem_init (void * memory, uword memory_size)
 
       while (1)
 	{
-	  heap = mheap_alloc (0, alloc_size);
+	  heap = mheap_alloc_with_flags (0, alloc_size, flags);
 	  if (heap)
 	    break;
 	  alloc_size = (alloc_size * 3) / 4;
@@ -77,6 +85,9 @@ void * clib_mem_init (void * memory, uword memory_size)
   return heap;
 }
 
+void * clib_mem_init (void * memory, uword memory_size)
+{ return clib_mem_init_with_flags (memory, memory_size, 0); }
+
 u8 * format_clib_mem_usage (u8 * s, va_list * va)
 {
     int verbose = va_arg (*va, int);
@@ -86,6 +97,9 @@ u8 * format_clib_mem_usage (u8 * s, va_list * va)
 void clib_mem_usage (clib_mem_usage_t * u)
 { mheap_usage (clib_mem_get_heap (), u); }
 
+uword clib_mem_trim (uword target_bytes)
+{ return mheap_trim (clib_mem_get_heap (), target_bytes); }
+
 /* Call serial number for debugger breakpoints. */
 uword clib_mem_validate_serial = 0;
 
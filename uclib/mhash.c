@@ -86,6 +86,8 @@ mhash_key_sum_inline (void * data, uword n_data_bytes, u32 seed)
   mhash_key_sum_##N_KEY_BYTES (hash_t * h, uword key)			\
   {									\
     mhash_t * hv = uword_to_pointer (h->user, mhash_t *);		\
+    if (MHASH_KEY_HAS_HASH)						\
+      return mhash_key_hash (key);					\
     return mhash_key_sum_inline (mhash_key_to_mem (hv, key),		\
 				 (N_KEY_BYTES),				\
 				 hv->hash_seed);			\
@@ -95,8 +97,12 @@ mhash_key_sum_inline (void * data, uword n_data_bytes, u32 seed)
   mhash_key_equal_##N_KEY_BYTES (hash_t * h, uword key1, uword key2)	\
   {									\
     mhash_t * hv = uword_to_pointer (h->user, mhash_t *);		\
-    void * k1 = mhash_key_to_mem (hv, key1);				\
-    void * k2 = mhash_key_to_mem (hv, key2);				\
+    void * k1, * k2;							\
+    if (MHASH_KEY_HAS_HASH						\
+	&& mhash_key_hash (key1) != mhash_key_hash (key2))		\
+      return 0;								\
+    k1 = mhash_key_to_mem (hv, key1);					\
+    k2 = mhash_key_to_mem (hv, key2);					\
     return ! memcmp (k1, k2, (N_KEY_BYTES));				\
   }
 
@@ -108,7 +114,10 @@ static uword
 mhash_key_sum_c_string (hash_t * h, uword key)
 {
   mhash_t * hv = uword_to_pointer (h->user, mhash_t *);
-  void * k = mhash_key_to_mem (hv, key);
+  void * k;
+  if (MHASH_KEY_HAS_HASH)
+    return mhash_key_hash (key);
+  k = mhash_key_to_mem (hv, key);
   return mhash_key_sum_inline (k, strlen (k), hv->hash_seed);
 }
 
@@ -116,8 +125,11 @@ static uword
 mhash_key_equal_c_string (hash_t * h, uword key1, uword key2)
 {
   mhash_t * hv = uword_to_pointer (h->user, mhash_t *);
-  void * k1 = mhash_key_to_mem (hv, key1);
-  void * k2 = mhash_key_to_mem (hv, key2);
+  void * k1, * k2;
+  if (MHASH_KEY_HAS_HASH && mhash_key_hash (key1) != mhash_key_hash (key2))
+    return 0;
+  k1 = mhash_key_to_mem (hv, key1);
+  k2 = mhash_key_to_mem (hv, key2);
   return strcmp (k1, k2) == 0;
 }
 
@@ -125,7 +137,10 @@ static uword
 mhash_key_sum_vec_string (hash_t * h, uword key)
 {
   mhash_t * hv = uword_to_pointer (h->user, mhash_t *);
-  void * k = mhash_key_to_mem (hv, key);
+  void * k;
+  if (MHASH_KEY_HAS_HASH)
+    return mhash_key_hash (key);
+  k = mhash_key_to_mem (hv, key);
   return mhash_key_sum_inline (k, vec_len (k), hv->hash_seed);
 }
 
@@ -133,8 +148,11 @@ static uword
 mhash_key_equal_vec_string (hash_t * h, uword key1, uword key2)
 {
   mhash_t * hv = uword_to_pointer (h->user, mhash_t *);
-  void * k1 = mhash_key_to_mem (hv, key1);
-  void * k2 = mhash_key_to_mem (hv, key2);
+  void * k1, * k2;
+  if (MHASH_KEY_HAS_HASH && mhash_key_hash (key1) != mhash_key_hash (key2))
+    return 0;
+  k1 = mhash_key_to_mem (hv, key1);
+  k2 = mhash_key_to_mem (hv, key2);
   return vec_len (k1) == vec_len (k2) && memcmp (k1, k2, vec_len (k1)) == 0;
 }
 
@@ -177,11 +195,8 @@ void mhash_init (mhash_t * h, uword n_value_bytes, uword n_key_bytes)
     },
   };
 
-  if (mhash_key_vector_is_heap (h))
-    heap_free (h->key_vector_or_heap);
-  else
-    vec_free (h->key_vector_or_heap);
-  vec_free (h->key_vector_free_indices);
+  vec_free (h->key_vector);
+  vec_free (h->key_tmp);
   hash_free (h->hash);
 
   memset (h, 0, sizeof (h[0]));
@@ -197,11 +212,11 @@ void mhash_init (mhash_t * h, uword n_value_bytes, uword n_key_bytes)
 			  0, 0);
 }
 
-static uword mhash_set_tmp_key (mhash_t * h, void * key)
+static void mhash_copy_tmp_key (mhash_t * h, void * key)
 {
   vec_reset_length (h->key_tmp);
 
-  if (mhash_key_vector_is_heap (h))
+  if (mhash_is_string_key (h))
     {
       uword is_c_string = h->n_key_bytes == MHASH_C_STRING_KEY;
 
@@ -212,8 +227,26 @@ static uword mhash_set_tmp_key (mhash_t * h, void * key)
     }
   else
     vec_add (h->key_tmp, key, h->n_key_bytes);
+}
+
+/* Copy key to key_tmp and return hash table key for it. */
+static uword mhash_set_tmp_key (mhash_t * h, void * key)
+{
+  u32 hash = 0;
 
-  return ~0;
+  mhash_copy_tmp_key (h, key);
+
+  if (MHASH_KEY_HAS_HASH)
+    {
+      uword n = h->n_key_bytes;
+      if (mhash_is_string_key (h))
+	n = (n == MHASH_C_STRING_KEY
+	     ? strlen ((char *) h->key_tmp)
+	     : vec_len (h->key_tmp));
+      hash = mhash_key_sum_inline (h->key_tmp, n, h->hash_seed);
+    }
+
+  return mhash_make_key (~0, hash);
 }
 
 hash_pair_t * mhash_get_pair (mhash_t * h, void * key)
@@ -224,95 +257,158 @@ hash_pair_t * mhash_get_pair (mhash_t * h, void * key)
   return hash_get_pair (h->hash, ikey);
 }
 
-typedef struct {
-  u32 heap_handle;
+/* As for _hash_get_multi.  Keys are hashed once and copied to key_tmp
+   again for comparison. */
+#define MHASH_GET_MULTI_BATCH 16
 
-  /* Must conincide with vec_header. */
-  vec_header_t vec;
-} mhash_string_key_t;
-
-uword mhash_set_mem (mhash_t * h, void * key, uword * new_value, uword * old_value)
+void mhash_get_multi (mhash_t * h, void ** keys, uword n_keys, uword ** results)
 {
-  u8 * k;
-  uword ikey, i, l = 0, n_key_bytes, old_n_elts, key_alloc_from_free_list = 0;
+  uword buckets[MHASH_GET_MULTI_BATCH], ikeys[MHASH_GET_MULTI_BATCH];
+  uword i, n;
+  hash_pair_t * p;
 
   mhash_sanitize_hash_user (h);
 
-  if (mhash_key_vector_is_heap (h))
+  if (hash_elts (h->hash) == 0)
     {
-      mhash_string_key_t * sk;
-      uword is_c_string = h->n_key_bytes == MHASH_C_STRING_KEY;
-      uword handle;
+      memset (results, 0, n_keys * sizeof (results[0]));
+      return;
+    }
 
-      n_key_bytes = is_c_string ? (strlen (key) + 1) : vec_len (key);
-      i = heap_alloc (h->key_vector_or_heap, n_key_bytes + sizeof (sk[0]), handle);
+  while (n_keys > 0)
+    {
+      n = clib_min (n_keys, MHASH_GET_MULTI_BATCH);
 
-      sk = (void *) (h->key_vector_or_heap + i);
-      sk->heap_handle = handle;
-      sk->vec.len = n_key_bytes;
-      memcpy (sk->vec.vector_data, key, n_key_bytes);
+      for (i = 0; i < n; i++)
+	{
+	  ikeys[i] = mhash_set_tmp_key (h, keys[i]);
+	  buckets[i] = hash_key_bucket (h->hash, ikeys[i]);
+	  hash_prefetch_bucket (h->hash, buckets[i]);
+	}
 
-      /* Advance key past vector header. */
-      i += sizeof (sk[0]);
-    }
-  else
-    {
-      key_alloc_from_free_list = (l = vec_len (h->key_vector_free_indices)) > 0;
-      if (key_alloc_from_free_list)
+      /* Key memory of direct pairs is needed for comparison
+	 unless cached hash rejects them. */
+      for (i = 0; i < n; i++)
 	{
-	  i = h->key_vector_free_indices[l - 1];
-	  k = vec_elt_at_index (h->key_vector_or_heap, i);
-	  _vec_len (h->key_vector_free_indices) = l - 1;
+	  p = hash_prefetch_bucket_pairs (h->hash, buckets[i]);
+	  if (p && (! MHASH_KEY_HAS_HASH
+		    || mhash_key_hash (p->key) == mhash_key_hash (ikeys[i])))
+	    CLIB_PREFETCH (mhash_key_to_mem (h, p->key), CLIB_CACHE_LINE_BYTES, LOAD);
 	}
-      else
+
+      for (i = 0; i < n; i++)
 	{
-	  vec_add2 (h->key_vector_or_heap, k, h->n_key_bytes);
-	  i = k - h->key_vector_or_heap;
+	  mhash_copy_tmp_key (h, keys[i]);
+	  p = hash_get_pair_in_bucket (h->hash, ikeys[i], buckets[i]);
+	  results[i] = p ? &p->value[0] : 0;
 	}
 
-      n_key_bytes = h->n_key_bytes;
-      memcpy (k, key, n_key_bytes);
+      keys += n;
+      results += n;
+      n_keys -= n;
     }
-  ikey = i;
-
-  old_n_elts = hash_elts (h->hash);
-  h->hash = _hash_set3 (h->hash, ikey, new_value, old_value);
+}
 
-  /* If element already existed remove duplicate key. */
-  if (hash_elts (h->hash) == old_n_elts)
+/* Bytes used in key vector by key at given offset. */
+always_inline uword
+mhash_key_vector_bytes (mhash_t * h, u32 offset, u32 * start)
+{
+  if (mhash_is_string_key (h))
     {
-      hash_pair_t * p;
+      void * k = vec_elt_at_index (h->key_vector, offset);
+      *start = offset - sizeof (vec_header_t);
+      return sizeof (vec_header_t) + round_pow2 (vec_len (k), sizeof (vec_header_t));
+    }
+  *start = offset;
+  return h->n_key_bytes;
+}
 
-      /* Fetch old key for return value. */
-      p = hash_get_pair (h->hash, ikey);
-      ikey = p->key;
+uword mhash_set_mem (mhash_t * h, void * key, uword * new_value, uword * old_value)
+{
+  hash_pair_t * p;
+  uword ikey, n_key_bytes, n_vector_bytes;
+  u32 offset;
+  u8 * k;
 
-      /* Remove duplicate key. */
-      if (mhash_key_vector_is_heap (h))
-	{
-	  mhash_string_key_t * sk;
-	  sk = (void *) (h->key_vector_or_heap + i - sizeof (sk[0]));
-	  heap_dealloc (h->key_vector_or_heap, sk->heap_handle);
-	}
-      else
-	{
-	  if (key_alloc_from_free_list)
-	    {
-	      h->key_vector_free_indices[l] = i;
-	      _vec_len (h->key_vector_free_indices) = l + 1;
-	    }
-	  else
-	    _vec_len (h->key_vector_or_heap) -= h->n_key_bytes;
-	}
+  mhash_sanitize_hash_user (h);
+
+  ikey = mhash_set_tmp_key (h, key);
+
+  /* Existing key: just update value. */
+  p = hash_get_pair (h->hash, ikey);
+  if (p)
+    {
+      uword n_value_bytes = mhash_value_bytes (h);
+      if (old_value)
+	memcpy (old_value, p->value, n_value_bytes);
+      memcpy (p->value, new_value, n_value_bytes);
+      return p->key;
     }
 
+  /* Append key to key vector.  Hash keys hold 32 bit offsets (with ~0
+     meaning key_tmp) so key vector must stay below 4G bytes; drop dead
+     keys first before giving up. */
+  n_key_bytes = vec_len (h->key_tmp);
+  n_vector_bytes = n_key_bytes;
+  if (mhash_is_string_key (h))
+    n_vector_bytes = sizeof (vec_header_t) + round_pow2 (n_key_bytes, sizeof (vec_header_t));
+
+  if ((u64) vec_len (h->key_vector) + n_vector_bytes >= (u32) ~0 && h->n_dead_key_bytes > 0)
+    mhash_compact_keys (h);
+  if ((u64) vec_len (h->key_vector) + n_vector_bytes >= (u32) ~0)
+    clib_panic ("key vector of %wd bytes full: %wd byte key does not fit",
+		vec_len (h->key_vector), n_key_bytes);
+
+  if (mhash_is_string_key (h))
+    {
+      vec_header_t * vh;
+      vec_add2 (h->key_vector, k, n_vector_bytes);
+      vh = (void *) k;
+      vh->len = n_key_bytes;
+      k = vh->vector_data;
+    }
+  else
+    vec_add2 (h->key_vector, k, n_key_bytes);
+
+  memcpy (k, h->key_tmp, n_key_bytes);
+  offset = k - h->key_vector;
+
+  ikey = mhash_make_key (offset, mhash_key_hash (ikey));
+  h->hash = _hash_set3 (h->hash, ikey, new_value, 0);
+
   return ikey;
 }
 
+void mhash_compact_keys (mhash_t * h)
+{
+  u8 * old = h->key_vector, * new = 0;
+  hash_pair_t * p;
+
+  vec_alloc (new, vec_len (old) - h->n_dead_key_bytes);
+
+  /* Bucket of a key depends only on key contents (or cached hash),
+     so keys can be changed in place. */
+  hash_foreach_pair (p, h->hash, ({
+    u32 start, offset = mhash_key_offset (p->key);
+    uword n_bytes = mhash_key_vector_bytes (h, offset, &start);
+    offset += vec_len (new) - start;
+    vec_add (new, old + start, n_bytes);
+    p->key = mhash_make_key (offset, mhash_key_hash (p->key));
+  }));
+
+  vec_free (old);
+  h->key_vector = new;
+  h->n_dead_key_bytes = 0;
+}
+
+/* Don't bother compacting small key vectors. */
+#define MHASH_COMPACT_MIN_DEAD_BYTES (64 << 10)
+
 uword mhash_unset (mhash_t * h, void * key, uword * old_value)
 {
   hash_pair_t * p;
   uword i;
+  u32 start;
 
   mhash_sanitize_hash_user (h);
   i = mhash_set_tmp_key (h, key);
@@ -321,29 +417,27 @@ uword mhash_unset (mhash_t * h, void * key, uword * old_value)
   if (! p)
     return 0;
 
-  ASSERT (p->key != ~0);
+  ASSERT (mhash_key_offset (p->key) != (u32) ~0);
   i = p->key;
 
-  if (mhash_key_vector_is_heap (h))
-    {
-      mhash_string_key_t * sk;
-      sk = (void *) (h->key_vector_or_heap + i) - sizeof (sk[0]);
-      heap_dealloc (h->key_vector_or_heap, sk->heap_handle);
-    }
-  else
-    vec_add1 (h->key_vector_free_indices, i);
+  h->n_dead_key_bytes += mhash_key_vector_bytes (h, mhash_key_offset (i), &start);
 
   hash_unset3 (h->hash, i, old_value);
+
+  if (h->n_dead_key_bytes >= MHASH_COMPACT_MIN_DEAD_BYTES
+      && 2 * h->n_dead_key_bytes > vec_len (h->key_vector))
+    mhash_compact_keys (h);
+
   return 1;
 }
 
 u8 * format_mhash_key (u8 * s, va_list * va)
 {
   mhash_t * h = va_arg (*va, mhash_t *);
-  u32 ki = va_arg (*va, u32);
+  uword ki = va_arg (*va, uword);
   void * k = mhash_key_to_mem (h, ki);
 
-  if (mhash_key_vector_is_heap (h))
+  if (mhash_is_string_key (h))
     {
       uword is_c_string = h->n_key_bytes == MHASH_C_STRING_KEY;
       u32 l = is_c_string ? strlen (k) : vec_len (k);
@@ -26,13 +26,14 @@
 
 /* Hash table plus vector of keys. */
 typedef struct {
-  /* Vector or heap used to store keys.  Hash table stores keys as byte
-     offsets into this vector. */
-  u8 * key_vector_or_heap;
+  /* Keys are appended to this vector; hash table stores keys as byte
+     offsets into it (see mhash_make_key).  String keys are preceded
+     by a vec_header_t so that vec_len works on them. */
+  u8 * key_vector;
 
-  /* Byte offsets of free keys in vector (used to store free keys when
-     n_key_bytes > 1). */
-  u32 * key_vector_free_indices;
+  /* Bytes of unset keys in key vector.  Vector is compacted when half
+     of it is dead. */
+  uword n_dead_key_bytes;
 
   u8 * key_tmp;
 
@@ -63,18 +64,43 @@ always_inline void
 mhash_init_vec_string (mhash_t * h, uword n_value_bytes)
 { mhash_init (h, n_value_bytes, MHASH_VEC_STRING_KEY); }
 
+/* On 64 bit machines hash table keys cache 32 bit hash of key in upper
+   half so that mismatches and re-hashes never touch key memory.
+   Lower 32 bits are byte offset in key vector; ~0 means key_tmp. */
+#define MHASH_KEY_HAS_HASH (uword_bits == 64)
+
+always_inline uword
+mhash_make_key (u32 offset, u32 hash)
+{ return MHASH_KEY_HAS_HASH ? offset | ((u64) hash << 32) : offset; }
+
+always_inline u32
+mhash_key_offset (uword key)
+{ return key; }
+
+always_inline u32
+mhash_key_hash (uword key)
+{ return (u64) key >> 32; }
+
 always_inline void *
 mhash_key_to_mem (mhash_t * h, uword key)
 {
-  return (key == ~0
+  u32 o = mhash_key_offset (key);
+  return (o == (u32) ~0
 	  ? h->key_tmp
-	  : vec_elt_at_index (h->key_vector_or_heap, key));
+	  : vec_elt_at_index (h->key_vector, o));
 }
 
 hash_pair_t * mhash_get_pair (mhash_t * h, void * key);
+
+/* Fetch values of n_keys keys: results[i] is value pointer or 0. */
+void mhash_get_multi (mhash_t * h, void ** keys, uword n_keys, uword ** results);
 uword mhash_set_mem (mhash_t * h, void * key, uword * new_value, uword * old_value);
 uword mhash_unset (mhash_t * h, void * key, uword * old_value);
 
+/* Remove unset keys from key vector.  Changes hash keys (offsets)
+   previously returned by mhash_set. */
+void mhash_compact_keys (mhash_t * h);
+
 always_inline uword *
 mhash_get (mhash_t * h, void * key)
 {
@@ -105,17 +131,14 @@ mhash_elts (mhash_t * m)
 { return hash_elts (m->hash); }
 
 always_inline uword
-mhash_key_vector_is_heap (mhash_t * h)
+mhash_is_string_key (mhash_t * h)
 { return h->n_key_bytes <= 1; }
 
 always_inline void
 mhash_free (mhash_t * h)
 {
-  if (mhash_key_vector_is_heap (h))
-    heap_free (h->key_vector_or_heap);
-  else
-    vec_free (h->key_vector_or_heap);
-  vec_free (h->key_vector_free_indices);
+  vec_free (h->key_vector);
+  vec_free (h->key_tmp);
   hash_free (h->hash);
 }
 
@@ -23,6 +23,7 @@
 
 static void mheap_get_trace (void * v, uword offset, uword size);
 static void mheap_put_trace (void * v, uword offset, uword size);
+static uword mheap_trace_sample_countdown (mheap_t * h, uword size);
 static int mheap_trace_sort (const void * t1, const void * t2);
 
 always_inline void mheap_maybe_lock (void * v)
@@ -180,13 +181,11 @@ remove_free_elt2 (void * v, mheap_elt_t * e)
 #define MHEAP_VM_ROUND_UP	MHEAP_VM_ROUND
 #define MHEAP_VM_ROUND_DOWN	(0 << 2)
 
-static uword mheap_page_size;
+static_always_inline uword mheap_page_round (mheap_t * h, uword addr)
+{ return (addr + h->vm_page_size - 1) &~ (h->vm_page_size - 1); }
 
-static_always_inline uword mheap_page_round (uword addr)
-{ return (addr + mheap_page_size - 1) &~ (mheap_page_size - 1); }
-
-static_always_inline uword mheap_page_truncate (uword addr)
-{ return addr &~ (mheap_page_size - 1); }
+static_always_inline uword mheap_page_truncate (mheap_t * h, uword addr)
+{ return addr &~ (h->vm_page_size - 1); }
 
 static_always_inline uword
 mheap_vm (void * v,
@@ -203,21 +202,29 @@ mheap_vm (void * v,
   end_addr = start_addr + size;
 
   /* Round start/end address up to page boundary. */
-  start_page = mheap_page_round (start_addr);
+  start_page = mheap_page_round (h, start_addr);
 
   if ((flags & MHEAP_VM_ROUND) == MHEAP_VM_ROUND_UP)
-    end_page = mheap_page_round (end_addr);
+    end_page = mheap_page_round (h, end_addr);
   else
-    end_page = mheap_page_truncate (end_addr);
+    end_page = mheap_page_truncate (h, end_addr);
 
   mapped_bytes = 0;
   if (end_page > start_page)
     {
       mapped_bytes = end_page - start_page;
-      if (flags & MHEAP_VM_MAP)
+      /* Huge pages stay mapped: released pages fault back in as zeros. */
+      if (h->flags & MHEAP_FLAG_HUGE_PAGES)
+	{
+	  if (flags & MHEAP_VM_UNMAP)
+	    clib_mem_vm_release ((void *) start_page, end_page - start_page);
+	}
+      else if (flags & MHEAP_VM_MAP)
         {
           void * r = clib_mem_vm_map ((void *) start_page, end_page - start_page);
           ASSERT (r != 0);
+	  if (h->numa_node != ~0)
+	    clib_mem_vm_bind_numa_node ((void *) start_page, end_page - start_page, h->numa_node);
         }
       else if (flags & MHEAP_VM_UNMAP)
         {
@@ -327,6 +334,7 @@ mheap_get_search_free_bin (void * v,
      Allocatted object is at offset o0 ... o1. */
   word o0, o1, f0, f1, search_n_user_data_bytes;
   word lo_free_usize, hi_free_usize;
+  uword n_searched;
 
   ASSERT (h->first_free_elt_uoffset_by_bin[bin] != ~0);
   e = mheap_elt_at_uoffset (v, h->first_free_elt_uoffset_by_bin[bin]);
@@ -337,6 +345,7 @@ mheap_get_search_free_bin (void * v,
   o0 = o1 = f0 = f1 = 0;
 
   h->stats.free_list.n_search_attempts += 1;
+  n_searched = 0;
 
   /* Find an object that is large enough with correct alignment at given alignment offset. */
   while (1)
@@ -348,6 +357,7 @@ mheap_get_search_free_bin (void * v,
 	ASSERT (this_object_n_user_data_bytes >= search_n_user_data_bytes);
 
       h->stats.free_list.n_objects_searched += 1;
+      n_searched += 1;
 
       if (this_object_n_user_data_bytes < search_n_user_data_bytes)
 	goto next;
@@ -380,13 +390,18 @@ mheap_get_search_free_bin (void * v,
     next:
       /* Reached end of free list without finding large enough object. */
       if (e->free_elt.next_uoffset == ~0)
-	return ~0;
+	{
+	  h->stats.free_list.n_searches_by_log2_length[mheap_log2_bin (n_searched, MHEAP_N_LOG2_SEARCH_BINS)] += 1;
+	  return ~0;
+	}
 
       /* Otherwise keep searching for large enough object. */
       e = mheap_elt_at_uoffset (v, e->free_elt.next_uoffset);
     }
 
  found:
+  h->stats.free_list.n_searches_by_log2_length[mheap_log2_bin (n_searched, MHEAP_N_LOG2_SEARCH_BINS)] += 1;
+
   /* Free fragment at end. */
   hi_free_usize = f1 != o1 ? f1 - o1 - MHEAP_ELT_OVERHEAD_BYTES : 0;
 
@@ -412,18 +427,19 @@ mheap_get_search_free_bin (void * v,
 
       /* Free elt is mapped.  Addresses after that may not be mapped.
          Address from f0_page_start to f0_page_end are not mapped. */
-      f0_page_start = mheap_page_round (pointer_to_uword (f0_elt + 1));
-      f0_page_end   = mheap_page_truncate (pointer_to_uword (f1_elt));
+      f0_page_start = mheap_page_round (h, pointer_to_uword (f0_elt + 1));
+      f0_page_end   = mheap_page_truncate (h, pointer_to_uword (f1_elt));
 
-      o0_page_start = mheap_page_truncate (pointer_to_uword (o0_elt));
-      o0_page_end = mheap_page_round (pointer_to_uword (o1_elt + 1));
+      o0_page_start = mheap_page_truncate (h, pointer_to_uword (o0_elt));
+      o0_page_end = mheap_page_round (h, pointer_to_uword (o1_elt + 1));
 
       if (o0_page_start < f0_page_start)
 	o0_page_start = f0_page_start;
       if (o0_page_end > f0_page_end)
 	o0_page_end = f0_page_end;
 
-      if (o0_page_end > o0_page_start)
+      if (o0_page_end > o0_page_start
+	  && ! (h->flags & MHEAP_FLAG_HUGE_PAGES))
 	clib_mem_vm_map (uword_to_pointer (o0_page_start, void *),
 			 o0_page_end - o0_page_start);
     }
@@ -562,8 +578,8 @@ mheap_get_extend_vector (void * v,
       mheap_elt_t * f0_elt = mheap_elt_at_uoffset (v, f0);
       mheap_elt_t * f1_elt = mheap_elt_at_uoffset (v, f1);
 
-      uword f0_page = mheap_page_round (pointer_to_uword (f0_elt->user_data));
-      uword f1_page = mheap_page_round (pointer_to_uword (f1_elt->user_data));
+      uword f0_page = mheap_page_round (h, pointer_to_uword (f0_elt->user_data));
+      uword f1_page = mheap_page_round (h, pointer_to_uword (f1_elt->user_data));
 
       if (f1_page > f0_page)
 	mheap_vm (v, MHEAP_VM_MAP, f0_page, f1_page - f0_page);
@@ -583,6 +599,387 @@ mheap_get_extend_vector (void * v,
   return v;
 }
 
+always_inline u64 mheap_guard_canary (mheap_t * h, uword uoffset)
+{ return h->guard_secret ^ ((u64) uoffset * 0x9e3779b97f4a7c15ULL); }
+
+always_inline u64 * mheap_guard_canary_for_elt (void * v, mheap_elt_t * e)
+{ return v + mheap_elt_uoffset (v, e) + mheap_elt_data_bytes (e) - MHEAP_GUARD_CANARY_BYTES; }
+
+/* Canary is inverted while object is in quarantine. */
+always_inline void
+mheap_guard_set_canary (void * v, uword uoffset, uword is_quarantined)
+{
+  mheap_elt_t * e = mheap_elt_at_uoffset (v, uoffset);
+  u64 c = mheap_guard_canary (mheap_header (v), uoffset);
+  mheap_guard_canary_for_elt (v, e)[0] = is_quarantined ? ~c : c;
+}
+
+always_inline uword
+mheap_guard_canary_is_valid (void * v, uword uoffset, uword is_quarantined)
+{
+  mheap_elt_t * e = mheap_elt_at_uoffset (v, uoffset);
+  u64 c = mheap_guard_canary (mheap_header (v), uoffset);
+  return mheap_guard_canary_for_elt (v, e)[0] == (is_quarantined ? ~c : c);
+}
+
+static mheap_guard_corrupt_handler_t * mheap_guard_corrupt_handler;
+static void * mheap_guard_corrupt_handler_arg;
+
+void mheap_guard_register_corrupt_handler (mheap_guard_corrupt_handler_t * f, void * arg)
+{
+  mheap_guard_corrupt_handler = f;
+  mheap_guard_corrupt_handler_arg = arg;
+}
+
+/* Panics unless a handler is registered; callers stop touching object
+   when this returns. */
+static never_inline void
+mheap_guard_corrupt (void * v, uword uoffset, char * why)
+{
+  mheap_t * h = mheap_header (v);
+  h->guard_corrupt_uoffset = uoffset;
+  if (mheap_guard_corrupt_handler)
+    {
+      mheap_guard_corrupt_handler (mheap_guard_corrupt_handler_arg, v, uoffset, why);
+      return;
+    }
+  os_puts ((u8 *) why, strlen (why), /* is_error */ 1);
+  os_panic ();
+}
+
+/* Check next few elements of heap, wrapping around at end.
+   Caller holds heap lock. */
+static void mheap_guard_check (void * v, uword n_elts)
+{
+  mheap_t * h = mheap_header (v);
+  mheap_elt_t * e, * n;
+  uword uo;
+
+  while (n_elts > 0 && vec_len (v) > 0)
+    {
+      uo = h->guard_check_uoffset;
+      if (uo < MHEAP_ELT_OVERHEAD_BYTES || uo >= vec_len (v))
+	uo = MHEAP_ELT_OVERHEAD_BYTES;
+
+      e = mheap_elt_at_uoffset (v, uo);
+      if (uo + mheap_elt_data_bytes (e) + MHEAP_ELT_OVERHEAD_BYTES > vec_len (v))
+	{
+	  mheap_guard_corrupt (v, uo, "mheap: element size corrupt\n");
+	  return;
+	}
+
+      n = mheap_next_elt (e);
+      if (e->n_user_data != n->prev_n_user_data
+	  || e->is_free != n->prev_is_free)
+	{
+	  mheap_guard_corrupt (v, uo, "mheap: element header corrupt\n");
+	  return;
+	}
+
+      /* Object found corrupt before is left alone. */
+      if (! e->is_free
+	  && uo != h->guard_corrupt_uoffset
+	  && ! mheap_guard_canary_is_valid (v, uo, /* is_quarantined */ 0)
+	  && ! mheap_guard_canary_is_valid (v, uo, /* is_quarantined */ 1))
+	mheap_guard_corrupt (v, uo, "mheap: canary overwritten\n");
+
+      h->guard_check_uoffset = (n->n_user_data == MHEAP_N_USER_DATA_INVALID
+				? MHEAP_ELT_OVERHEAD_BYTES
+				: mheap_elt_uoffset (v, n));
+      h->stats.n_guard_elts_checked += 1;
+      n_elts--;
+    }
+}
+
+/* Search free lists and then extend heap vector.  Caller holds heap lock. */
+static void *
+mheap_get_no_lock (void * v,
+		   uword n_user_data_bytes,
+		   uword align,
+		   uword align_offset,
+		   uword * offset_return)
+{
+  mheap_t * h = mheap_header (v);
+  uword offset;
+
+  if (h->flags & MHEAP_FLAG_GUARD)
+    n_user_data_bytes += MHEAP_GUARD_CANARY_BYTES;
+
+  /* First search free lists for object. */
+  offset = mheap_get_search_free_list (v, &n_user_data_bytes, align, align_offset);
+
+  h = mheap_header (v);
+
+  /* If that fails allocate object at end of heap by extending vector. */
+  if (offset == ~0 && _vec_len (v) < h->max_size)
+    {
+      v = mheap_get_extend_vector (v, n_user_data_bytes, align, align_offset, &offset);
+      h = mheap_header (v);
+      h->stats.n_vector_expands += offset != ~0;
+    }
+
+  if (offset != ~0)
+    {
+      h->n_elts += 1;
+      if (h->flags & MHEAP_FLAG_GUARD)
+	mheap_guard_set_canary (v, offset, /* is_quarantined */ 0);
+    }
+
+  *offset_return = offset;
+  return v;
+}
+
+/* Allocate this cpu's magazines.  Caller holds heap lock. */
+static mheap_per_cpu_t *
+mheap_get_per_cpu (void * v)
+{
+  mheap_t * h = mheap_header (v);
+  uword cpu = os_get_cpu_number ();
+
+  mheap_per_cpu_t * pc;
+  uword offset;
+
+  if (! h->per_cpu)
+    {
+      uword n = clib_smp_n_thread_slots (&clib_smp_main);
+      uword n_bytes = n * sizeof (h->per_cpu[0]);
+
+      v = mheap_get_no_lock (v, n_bytes, sizeof (h->per_cpu[0]), 0, &offset);
+      if (offset == ~0)
+	return 0;
+
+      memset (v + offset, 0, n_bytes);
+
+      /* Lock-free fast path reads per_cpu and n_per_cpu without lock. */
+      h->n_per_cpu = n;
+      CLIB_MEMORY_BARRIER ();
+      h->per_cpu = v + offset;
+    }
+
+  /* Main thread's index is shared with unregistered threads. */
+  if (cpu >= h->n_per_cpu
+      || (clib_smp_main.vm_base && cpu == clib_smp_main.n_cpus))
+    return 0;
+
+  if (! h->per_cpu[cpu])
+    {
+      v = mheap_get_no_lock (v, sizeof (pc[0]), CLIB_CACHE_LINE_BYTES, 0, &offset);
+      if (offset == ~0)
+	return 0;
+
+      pc = v + offset;
+      memset (pc, 0, sizeof (pc[0]));
+      CLIB_MEMORY_BARRIER ();
+      h->per_cpu[cpu] = pc;
+    }
+
+  return h->per_cpu[cpu];
+}
+
+/* Statistics for calling cpu: its own if it has per-cpu state
+   so that cpus do not contend for statistics cache lines. */
+always_inline mheap_stats_t *
+mheap_cpu_stats (mheap_t * h)
+{
+  uword cpu = os_get_cpu_number ();
+  if (h->per_cpu && cpu < h->n_per_cpu && h->per_cpu[cpu])
+    return &h->per_cpu[cpu]->stats;
+  return &h->stats;
+}
+
+/* Refill empty magazine with a batch of objects and return one of them. */
+static uword
+mheap_magazine_refill (void * v, mheap_per_cpu_t * pc, uword bin)
+{
+  mheap_magazine_t * m = pc->magazines + bin;
+  uword n_user_data_bytes = MHEAP_MIN_USER_DATA_BYTES + bin * MHEAP_USER_DATA_WORD_BYTES;
+  uword offset;
+
+  pc->stats.n_magazine_misses += 1;
+
+  while (m->n_offsets < MHEAP_MAGAZINE_SIZE / 2)
+    {
+      v = mheap_get_no_lock (v, n_user_data_bytes, MHEAP_USER_DATA_WORD_BYTES, 0, &offset);
+      if (offset == ~0)
+	break;
+      mheap_magazine_set_held (v, offset, 1);
+      m->offsets[m->n_offsets++] = offset;
+    }
+
+  if (m->n_offsets == 0)
+    return ~0;
+
+  m->n_offsets -= 1;
+  mheap_magazine_set_held (v, m->offsets[m->n_offsets], 0);
+  return m->offsets[m->n_offsets];
+}
+
+/* Owner frees objects which other cpus have pushed on remote free list. */
+static never_inline void
+mheap_drain_remote_frees (void * v)
+{
+  mheap_t * h = mheap_header (v);
+  uword * p, * next, n_frees;
+
+  /* Take entire list: no ABA problems since we are the only consumer. */
+  p = uword_to_pointer (clib_smp_swap (&h->remote_free_list, 0), uword *);
+
+  n_frees = 0;
+  while (p)
+    {
+      next = uword_to_pointer (p[0], uword *);
+      mheap_put (v, (void *) p - v);
+      p = next;
+      n_frees++;
+    }
+
+  h->stats.n_remote_frees += n_frees;
+}
+
+always_inline uword mheap_slab_class (uword n_user_data_bytes)
+{
+  return (n_user_data_bytes <= 8
+	  ? 0
+	  : (n_user_data_bytes - 8 + MHEAP_SLAB_ALIGN - 1) / MHEAP_SLAB_ALIGN);
+}
+
+always_inline uword mheap_slab_class_bytes (uword c)
+{ return 8 + c * MHEAP_SLAB_ALIGN; }
+
+always_inline uword mheap_slab_stride (uword c)
+{ return mheap_slab_class_bytes (c) + MHEAP_ELT_OVERHEAD_BYTES; }
+
+always_inline uword
+mheap_is_slab_object (mheap_t * h, uword uoffset)
+{
+  uword i = uoffset >> MHEAP_LOG2_SLAB_PAGE_BYTES;
+  return (h->slab_page_bitmap
+	  && (h->slab_page_bitmap[i / BITS (uword)] >> (i % BITS (uword))) & 1);
+}
+
+always_inline void
+mheap_slab_set_page_bit (mheap_t * h, uword page_uoffset, uword is_slab)
+{
+  uword i = page_uoffset >> MHEAP_LOG2_SLAB_PAGE_BYTES;
+  uword m = (uword) 1 << (i % BITS (uword));
+  if (is_slab)
+    h->slab_page_bitmap[i / BITS (uword)] |= m;
+  else
+    h->slab_page_bitmap[i / BITS (uword)] &= ~m;
+}
+
+static void
+mheap_slab_list_add (void * v, uword c, uword page_uoffset)
+{
+  mheap_t * h = mheap_header (v);
+  mheap_slab_page_t * p = v + page_uoffset;
+
+  p->prev_uoffset = ~0;
+  p->next_uoffset = h->slab_partial_pages[c];
+  if (p->next_uoffset != ~0)
+    ((mheap_slab_page_t *) (v + p->next_uoffset))->prev_uoffset = page_uoffset;
+  h->slab_partial_pages[c] = page_uoffset;
+}
+
+static void
+mheap_slab_list_remove (void * v, uword c, uword page_uoffset)
+{
+  mheap_t * h = mheap_header (v);
+  mheap_slab_page_t * p = v + page_uoffset;
+
+  if (p->prev_uoffset != ~0)
+    ((mheap_slab_page_t *) (v + p->prev_uoffset))->next_uoffset = p->next_uoffset;
+  else
+    h->slab_partial_pages[c] = p->next_uoffset;
+  if (p->next_uoffset != ~0)
+    ((mheap_slab_page_t *) (v + p->next_uoffset))->prev_uoffset = p->prev_uoffset;
+}
+
+/* Carve new slab page for given class out of heap.  Caller holds heap lock. */
+static uword
+mheap_slab_new_page (void * v, uword c)
+{
+  mheap_t * h = mheap_header (v);
+  mheap_slab_page_t * p;
+  uword i, o, n_bytes, n_words;
+
+  if (! h->slab_page_bitmap)
+    {
+      n_words = ((h->max_size >> MHEAP_LOG2_SLAB_PAGE_BYTES) + BITS (uword)) / BITS (uword);
+      n_bytes = n_words * sizeof (uword);
+      v = mheap_get_no_lock (v, n_bytes, sizeof (uword), 0, &o);
+      if (o == ~0)
+	return ~0;
+      h->slab_page_bitmap = v + o;
+      memset (h->slab_page_bitmap, 0, n_bytes);
+    }
+
+  v = mheap_get_no_lock (v, MHEAP_SLAB_PAGE_BYTES, MHEAP_SLAB_PAGE_BYTES, 0, &o);
+  if (o == ~0)
+    return ~0;
+
+  p = v + o;
+  memset (p, 0, sizeof (p[0]));
+  p->class = c;
+  p->n_slots = (MHEAP_SLAB_PAGE_BYTES - MHEAP_SLAB_FIRST_SLOT_OFFSET) / mheap_slab_stride (c);
+  p->n_free_slots = p->n_slots;
+
+  for (i = 0; i < p->n_slots; i++)
+    p->free_slots[i / BITS (uword)] |= (uword) 1 << (i % BITS (uword));
+
+  /* Element headers for each slot plus one after last slot so that
+     forward and backward sizes of each slot agree. */
+  for (i = 0; i <= p->n_slots; i++)
+    {
+      mheap_elt_t * e = mheap_elt_at_uoffset (v, o + MHEAP_SLAB_FIRST_SLOT_OFFSET + i * mheap_slab_stride (c));
+      e->prev_n_user_data = mheap_slab_class_bytes (c) / MHEAP_USER_DATA_WORD_BYTES;
+      e->prev_is_free = 0;
+      e->n_user_data = i < p->n_slots ? e->prev_n_user_data : 0;
+      e->is_free = 0;
+    }
+
+  mheap_slab_set_page_bit (h, o, /* is_slab */ 1);
+  mheap_slab_list_add (v, c, o);
+  h->n_slab_pages += 1;
+
+  return o;
+}
+
+/* Allocate object from slab of its size class.  Caller holds heap lock. */
+static uword
+mheap_slab_get (void * v, uword n_user_data_bytes)
+{
+  mheap_t * h = mheap_header (v);
+  mheap_slab_page_t * p;
+  uword c, o, i, s;
+
+  c = mheap_slab_class (n_user_data_bytes);
+  o = h->slab_partial_pages[c];
+  if (o == (u32) ~0)
+    {
+      o = mheap_slab_new_page (v, c);
+      if (o == ~0)
+	return ~0;
+    }
+
+  p = v + o;
+  ASSERT (p->n_free_slots > 0);
+
+  for (i = 0; p->free_slots[i] == 0; i++)
+    ;
+
+  s = i * BITS (uword) + log2_first_set (p->free_slots[i]);
+  p->free_slots[i] &= p->free_slots[i] - 1;
+
+  p->n_free_slots -= 1;
+  if (p->n_free_slots == 0)
+    mheap_slab_list_remove (v, c, o);
+
+  h->n_slab_objects += 1;
+
+  return o + MHEAP_SLAB_FIRST_SLOT_OFFSET + s * mheap_slab_stride (c);
+}
+
 void * mheap_get_aligned (void * v,
 			  uword n_user_data_bytes,
 			  uword align,
@@ -590,11 +987,23 @@ void * mheap_get_aligned (void * v,
 			  uword * offset_return)
 {
   mheap_t * h;
-  uword offset;
+  mheap_per_cpu_t * pc;
+  mheap_stats_t * st;
+  uword offset, bin, size_bin;
   u64 cpu_times[2];
 
+  /* Fast path: allocate from this cpu's magazine without locking. */
+  offset = mheap_magazine_get (v, n_user_data_bytes, align, align_offset);
+  if (offset != ~0)
+    {
+      *offset_return = offset;
+      return v;
+    }
+
   cpu_times[0] = clib_cpu_time_now ();
 
+  size_bin = mheap_log2_bin (n_user_data_bytes, MHEAP_N_LOG2_SIZE_BINS);
+
   align = clib_max (align, STRUCT_SIZE_OF (mheap_elt_t, user_data[0]));
   align = max_pow2 (align);
 
@@ -619,31 +1028,69 @@ void * mheap_get_aligned (void * v,
 	os_panic ();
     }
 
-  mheap_maybe_lock (v);
-
   h = mheap_header (v);
 
+  /* Arenas always allocate at end of heap: no lock, free lists or tracing. */
+  if (h->flags & MHEAP_FLAG_ARENA)
+    {
+      v = mheap_get_extend_vector (v, n_user_data_bytes, align, align_offset, offset_return);
+      h = mheap_header (v);
+      h->n_elts += *offset_return != ~0;
+      h->stats.n_arena_gets += 1;
+      return v;
+    }
+
+  if (PREDICT_FALSE (h->remote_free_list != 0)
+      && h->owner_cpu == os_get_cpu_number ())
+    {
+      mheap_drain_remote_frees (v);
+
+      /* Objects we just freed may have landed on magazines. */
+      offset = mheap_magazine_get (v, n_user_data_bytes, align, align_offset);
+      if (offset != ~0)
+	{
+	  *offset_return = offset;
+	  return v;
+	}
+    }
+
+  mheap_maybe_lock (v);
+
   if (h->flags & MHEAP_FLAG_VALIDATE)
     mheap_validate (v);
 
-  /* First search free lists for object. */
-  offset = mheap_get_search_free_list (v, &n_user_data_bytes, align, align_offset);
+  if (h->flags & MHEAP_FLAG_GUARD)
+    mheap_guard_check (v, MHEAP_GUARD_CHECKS_PER_CALL);
 
-  h = mheap_header (v);
+  /* Shared heaps keep statistics per cpu. */
+  if (h->flags & MHEAP_FLAG_THREAD_SAFE)
+    mheap_get_per_cpu (v);
+  st = mheap_cpu_stats (h);
+  st->n_gets_by_log2_size[size_bin] += 1;
+
+  bin = mheap_magazine_bin (n_user_data_bytes);
+  pc = 0;
+  if (bin < MHEAP_N_MAGAZINE_BINS
+      && align == MHEAP_USER_DATA_WORD_BYTES
+      && align_offset == 0
+      && (h->flags & (MHEAP_FLAG_MAGAZINES | MHEAP_FLAG_TRACE | MHEAP_FLAG_VALIDATE)) == MHEAP_FLAG_MAGAZINES)
+    pc = mheap_get_per_cpu (v);
+
+  if (pc)
+    offset = mheap_magazine_refill (v, pc, bin);
+  else if ((h->flags & MHEAP_FLAG_SLAB)
+	   && n_user_data_bytes <= MHEAP_SLAB_MAX_USER_DATA_BYTES
+	   && align <= MHEAP_SLAB_ALIGN
+	   && align_offset == 0)
+    offset = mheap_slab_get (v, n_user_data_bytes);
+  else
+    v = mheap_get_no_lock (v, n_user_data_bytes, align, align_offset, &offset);
 
-  /* If that fails allocate object at end of heap by extending vector. */
-  if (offset == ~0 && _vec_len (v) < h->max_size)
-    {
-      v = mheap_get_extend_vector (v, n_user_data_bytes, align, align_offset, &offset);
-      h = mheap_header (v);
-      h->stats.n_vector_expands += offset != ~0;
-    }
+  h = mheap_header (v);
 
   *offset_return = offset;
   if (offset != ~0)
     {
-      h->n_elts += 1;
-
       if (h->flags & MHEAP_FLAG_TRACE)
 	{
 	  /* Recursion block for case when we are traceing main clib heap. */
@@ -653,6 +1100,16 @@ void * mheap_get_aligned (void * v,
 
 	  h->flags |= MHEAP_FLAG_TRACE;
 	}
+      else if ((h->flags & MHEAP_FLAG_TRACE_SAMPLE)
+	       && mheap_trace_sample_countdown (h, n_user_data_bytes))
+	{
+	  h->flags &= ~MHEAP_FLAG_TRACE_SAMPLE;
+
+	  /* Trace actual object size so free subtracts same amount. */
+	  mheap_get_trace (v, offset, mheap_data_bytes (v, offset));
+
+	  h->flags |= MHEAP_FLAG_TRACE_SAMPLE;
+	}
     }
 
   if (h->flags & MHEAP_FLAG_VALIDATE)
@@ -661,8 +1118,8 @@ void * mheap_get_aligned (void * v,
   mheap_maybe_unlock (v);
 
   cpu_times[1] = clib_cpu_time_now ();
-  h->stats.n_clocks_get += cpu_times[1] - cpu_times[0];
-  h->stats.n_gets += 1;
+  st->n_clocks_get += cpu_times[1] - cpu_times[0];
+  st->n_gets += 1;
 
   return v;
 }
@@ -670,6 +1127,12 @@ void * mheap_get_aligned (void * v,
 static void free_last_elt (void * v, mheap_elt_t * e)
 {
   mheap_t * h = mheap_header (v);
+  uword len;
+
+  ASSERT (v != 0);
+  len = _vec_len (v);
+  if (len > h->trim_tail_end)
+    h->trim_tail_end = len;
 
   /* Possibly delete preceeding free element also. */
   if (e->prev_is_free)
@@ -694,34 +1157,63 @@ static void free_last_elt (void * v, mheap_elt_t * e)
     }
 }
 
-void mheap_put (void * v, uword uoffset)
+/* Free arena object: only last object in heap is given back; all
+   others stay allocated until mheap_arena_reset. */
+static void mheap_arena_put (void * v, uword uoffset)
 {
-  mheap_t * h;
-  uword n_user_data_bytes, bin;
+  mheap_t * h = mheap_header (v);
   mheap_elt_t * e, * n;
-  uword trace_uoffset, trace_n_user_data_bytes;
-  u64 cpu_times[2];
 
-  cpu_times[0] = clib_cpu_time_now ();
+  e = mheap_elt_at_uoffset (v, uoffset);
+  n = mheap_next_elt (e);
 
-  h = mheap_header (v);
+  if (e->is_free || e->n_user_data != n->prev_n_user_data)
+    os_panic ();
 
-  mheap_maybe_lock (v);
+  if (n->n_user_data == MHEAP_N_USER_DATA_INVALID)
+    {
+      ASSERT (h->n_elts > 0);
+      h->n_elts--;
+      free_last_elt (v, e);
+    }
+}
 
-  if (h->flags & MHEAP_FLAG_VALIDATE)
-    mheap_validate (v);
+/* Give back all objects in arena at once. */
+void mheap_arena_reset (void * v)
+{
+  mheap_t * h = mheap_header (v);
+  uword len;
+
+  ASSERT (v != 0 && (h->flags & MHEAP_FLAG_ARENA));
+
+  len = _vec_len (v);
+  if (len > h->trim_tail_end)
+    h->trim_tail_end = len;
+  _vec_len (v) = 0;
+  h->n_elts = 0;
+  h->stats.n_arena_resets += 1;
+
+  /* Alignment padding may have left free elements. */
+  memset (h->first_free_elt_uoffset_by_bin, ~0, sizeof (h->first_free_elt_uoffset_by_bin));
+  memset (h->non_empty_free_elt_heads, 0, sizeof (h->non_empty_free_elt_heads));
+}
+
+/* Free object.  Caller holds heap lock. */
+static void mheap_put_no_lock (void * v, uword uoffset)
+{
+  mheap_t * h;
+  uword n_user_data_bytes, bin;
+  mheap_elt_t * e, * n;
+
+  h = mheap_header (v);
 
   ASSERT (h->n_elts > 0);
   h->n_elts--;
-  h->stats.n_puts += 1;
 
   e = mheap_elt_at_uoffset (v, uoffset);
   n = mheap_next_elt (e);
   n_user_data_bytes = mheap_elt_data_bytes (e);
 
-  trace_uoffset = uoffset;
-  trace_n_user_data_bytes = n_user_data_bytes;
-
   bin = user_data_size_to_bin_index (n_user_data_bytes);
   if (MHEAP_HAVE_SMALL_OBJECT_CACHE
       && bin < 255
@@ -729,7 +1221,7 @@ void mheap_put (void * v, uword uoffset)
     {
       uoffset = mheap_put_small_object (h, bin, uoffset);
       if (uoffset == 0)      
-	goto done;
+	return;
 
       e = mheap_elt_at_uoffset (v, uoffset);
       n = mheap_next_elt (e);
@@ -776,51 +1268,409 @@ void mheap_put (void * v, uword uoffset)
 	  n_combine++;
 	}
 
-      if (n_combine)
-	mheap_elt_set_size (v, f0, f1 - f0, /* is_free */ 1);
-      else
-	e->is_free = n->prev_is_free = 1;
-      mheap_set_free_elt (v, f0, f1 - f0);
+      /* Elements merged into free element no longer exist. */
+      if (h->guard_check_uoffset > f0 && h->guard_check_uoffset <= f1)
+	h->guard_check_uoffset = f0;
+
+      if (n_combine)
+	mheap_elt_set_size (v, f0, f1 - f0, /* is_free */ 1);
+      else
+	e->is_free = n->prev_is_free = 1;
+      mheap_set_free_elt (v, f0, f1 - f0);
+
+      if (! (h->flags & MHEAP_FLAG_DISABLE_VM))
+	mheap_vm_elt (v, MHEAP_VM_UNMAP, f0);
+    }
+}
+
+/* Give back object leaving quarantine after checking that it was not
+   written to while free.  Caller holds heap lock. */
+static void mheap_guard_release (void * v, uword uoffset)
+{
+  mheap_elt_t * e = mheap_elt_at_uoffset (v, uoffset);
+  u64 * d = v + uoffset;
+  uword i, n_words;
+
+  if (! mheap_guard_canary_is_valid (v, uoffset, /* is_quarantined */ 1))
+    {
+      mheap_guard_corrupt (v, uoffset, "mheap: canary of free object overwritten\n");
+      return;
+    }
+
+  n_words = clib_min (mheap_elt_data_bytes (e) - MHEAP_GUARD_CANARY_BYTES,
+		      (uword) MHEAP_GUARD_POISON_BYTES) / sizeof (d[0]);
+  for (i = 0; i < n_words; i++)
+    if (d[i] != MHEAP_GUARD_POISON)
+      {
+	mheap_guard_corrupt (v, uoffset, "mheap: object written after free\n");
+	return;
+      }
+
+  mheap_put_no_lock (v, uoffset);
+}
+
+/* Free object into quarantine; oldest quarantined object is given back
+   to heap when quarantine is full.  Caller holds heap lock. */
+static void mheap_guard_put (void * v, uword uoffset)
+{
+  mheap_t * h = mheap_header (v);
+  mheap_elt_t * e, * n;
+  u64 * d = v + uoffset;
+  uword i, n_words;
+
+  e = mheap_elt_at_uoffset (v, uoffset);
+  n = mheap_next_elt (e);
+  if (e->is_free || e->n_user_data != n->prev_n_user_data)
+    {
+      mheap_guard_corrupt (v, uoffset, "mheap: free of invalid object\n");
+      return;
+    }
+
+  if (mheap_guard_canary_is_valid (v, uoffset, /* is_quarantined */ 1))
+    {
+      mheap_guard_corrupt (v, uoffset, "mheap: object freed twice\n");
+      return;
+    }
+
+  if (! mheap_guard_canary_is_valid (v, uoffset, /* is_quarantined */ 0))
+    {
+      mheap_guard_corrupt (v, uoffset, "mheap: canary overwritten\n");
+      return;
+    }
+
+  if (! h->guard_quarantine)
+    {
+      uword offset;
+      v = mheap_get_no_lock (v, MHEAP_GUARD_QUARANTINE_SIZE * sizeof (h->guard_quarantine[0]),
+			     sizeof (h->guard_quarantine[0]), 0, &offset);
+      if (offset == ~0)
+	{
+	  mheap_put_no_lock (v, uoffset);
+	  return;
+	}
+      h->guard_quarantine = v + offset;
+    }
+
+  n_words = clib_min (mheap_elt_data_bytes (e) - MHEAP_GUARD_CANARY_BYTES,
+		      (uword) MHEAP_GUARD_POISON_BYTES) / sizeof (d[0]);
+  for (i = 0; i < n_words; i++)
+    d[i] = MHEAP_GUARD_POISON;
+  mheap_guard_set_canary (v, uoffset, /* is_quarantined */ 1);
+
+  if (h->guard_n_quarantine < MHEAP_GUARD_QUARANTINE_SIZE)
+    {
+      i = (h->guard_quarantine_head + h->guard_n_quarantine) % MHEAP_GUARD_QUARANTINE_SIZE;
+      h->guard_n_quarantine += 1;
+    }
+  else
+    {
+      i = h->guard_quarantine_head;
+      h->guard_quarantine_head = (i + 1) % MHEAP_GUARD_QUARANTINE_SIZE;
+      mheap_guard_release (v, h->guard_quarantine[i]);
+    }
+  h->guard_quarantine[i] = uoffset;
+}
+
+/* Free slab object; releases slab page when all its slots are free and
+   class has other pages with free slots.  Caller holds heap lock. */
+static void
+mheap_slab_put (void * v, uword uoffset)
+{
+  mheap_t * h = mheap_header (v);
+  mheap_slab_page_t * p;
+  uword o, c, i, s, m;
+
+  o = uoffset &~ (MHEAP_SLAB_PAGE_BYTES - 1);
+  p = v + o;
+  c = p->class;
+  s = (uoffset - o - MHEAP_SLAB_FIRST_SLOT_OFFSET) / mheap_slab_stride (c);
+
+  /* Offset must be start of a slot. */
+  if (uoffset != o + MHEAP_SLAB_FIRST_SLOT_OFFSET + s * mheap_slab_stride (c)
+      || s >= p->n_slots)
+    os_panic ();
+
+  i = s / BITS (uword);
+  m = (uword) 1 << (s % BITS (uword));
+
+  /* Object was already freed. */
+  if (p->free_slots[i] & m)
+    os_panic ();
+
+  p->free_slots[i] |= m;
+  p->n_free_slots += 1;
+  h->n_slab_objects -= 1;
+
+  if (p->n_free_slots == 1)
+    mheap_slab_list_add (v, c, o);
+
+  /* Keep one page per class around to avoid thrashing. */
+  else if (p->n_free_slots == p->n_slots
+	   && (p->next_uoffset != ~0 || p->prev_uoffset != ~0))
+    {
+      mheap_slab_list_remove (v, c, o);
+      mheap_slab_set_page_bit (h, o, /* is_slab */ 0);
+      h->n_slab_pages -= 1;
+      mheap_put_no_lock (v, o);
+    }
+}
+
+void mheap_put (void * v, uword uoffset)
+{
+  mheap_t * h;
+  mheap_per_cpu_t * pc;
+  mheap_stats_t * st;
+  uword n_user_data_bytes, bin;
+  u64 cpu_times[2];
+
+  /* Fast path: free to this cpu's magazine without locking. */
+  if (mheap_magazine_put (v, uoffset))
+    return;
+
+  h = mheap_header (v);
+
+  /* Sampled objects and frees from cpus without magazines skip
+     mheap_magazine_put's check. */
+  if ((h->flags & MHEAP_FLAG_MAGAZINES)
+      && ! mheap_elt_at_uoffset (v, uoffset)->is_free
+      && PREDICT_FALSE (mheap_magazine_is_held (v, uoffset)))
+    os_panic ();
+
+  if (h->flags & MHEAP_FLAG_ARENA)
+    {
+      mheap_arena_put (v, uoffset);
+      return;
+    }
+
+  cpu_times[0] = clib_cpu_time_now ();
+
+  mheap_maybe_lock (v);
+
+  if (h->flags & MHEAP_FLAG_VALIDATE)
+    mheap_validate (v);
+
+  st = mheap_cpu_stats (h);
+  st->n_puts += 1;
+
+  n_user_data_bytes = mheap_data_bytes (v, uoffset);
+
+  /* Magazine is full: drain half of it back into heap to make room. */
+  pc = mheap_magazines_for_cpu (v);
+  bin = mheap_magazine_bin (n_user_data_bytes);
+  if (mheap_is_slab_object (h, uoffset))
+    mheap_slab_put (v, uoffset);
+  else if (pc
+      && bin < MHEAP_N_MAGAZINE_BINS
+      && ! mheap_elt_at_uoffset (v, uoffset)->is_free)
+    {
+      mheap_magazine_t * m = pc->magazines + bin;
+
+      st->n_magazine_drains += 1;
+      while (m->n_offsets > MHEAP_MAGAZINE_SIZE / 2)
+	{
+	  m->n_offsets -= 1;
+	  mheap_magazine_set_held (v, m->offsets[m->n_offsets], 0);
+	  mheap_put_no_lock (v, m->offsets[m->n_offsets]);
+	}
+
+      mheap_magazine_set_held (v, uoffset, 1);
+      m->offsets[m->n_offsets] = uoffset;
+      m->n_offsets += 1;
+    }
+  else if (h->flags & MHEAP_FLAG_GUARD)
+    mheap_guard_put (v, uoffset);
+  else
+    mheap_put_no_lock (v, uoffset);
+
+  h = mheap_header (v);
+
+  if (h->flags & MHEAP_FLAG_GUARD)
+    mheap_guard_check (v, MHEAP_GUARD_CHECKS_PER_CALL);
+
+  if (h->flags & MHEAP_FLAG_TRACE)
+    {
+      /* Recursion block for case when we are traceing main clib heap. */
+      h->flags &= ~MHEAP_FLAG_TRACE;
+
+      mheap_put_trace (v, uoffset, n_user_data_bytes);
+
+      h->flags |= MHEAP_FLAG_TRACE;
+    }
+  else if ((h->flags & MHEAP_FLAG_TRACE_SAMPLE)
+	   && mheap_trace_maybe_sampled (h, uoffset))
+    {
+      h->flags &= ~MHEAP_FLAG_TRACE_SAMPLE;
+
+      mheap_put_trace (v, uoffset, n_user_data_bytes);
+
+      h->flags |= MHEAP_FLAG_TRACE_SAMPLE;
+    }
+
+  if (h->flags & MHEAP_FLAG_VALIDATE)
+    mheap_validate (v);
+
+  mheap_maybe_unlock (v);
+
+  cpu_times[1] = clib_cpu_time_now ();
+  st->n_clocks_put += cpu_times[1] - cpu_times[0];
+}
+
+/* Grow object into following free element or, for last object in heap,
+   by extending heap vector.  Caller holds heap lock. */
+static uword
+mheap_realloc_no_lock (void * v, uword uoffset, uword n_user_data_bytes)
+{
+  mheap_t * h = mheap_header (v);
+  mheap_elt_t * e, * n, * m;
+  uword f0, f1, n_avail;
+  word n_left;
+
+  e = mheap_elt_at_uoffset (v, uoffset);
+  n = mheap_next_elt (e);
+
+  /* Object must be allocated. */
+  if (e->is_free || e->n_user_data != n->prev_n_user_data)
+    os_panic ();
+
+  if (n_user_data_bytes <= mheap_elt_data_bytes (e))
+    return 1;
+
+  /* Last object in heap: extend heap vector. */
+  if (n->n_user_data == MHEAP_N_USER_DATA_INVALID)
+    {
+      f0 = _vec_len (v);
+      f1 = uoffset + n_user_data_bytes + MHEAP_ELT_OVERHEAD_BYTES;
+      if (f1 > h->max_size)
+	return 0;
+
+      _vec_len (v) = f1;
+
+      if (! (h->flags & MHEAP_FLAG_DISABLE_VM))
+	{
+	  mheap_elt_t * f0_elt = mheap_elt_at_uoffset (v, f0);
+	  mheap_elt_t * f1_elt = mheap_elt_at_uoffset (v, f1);
+
+	  uword f0_page = mheap_page_round (h, pointer_to_uword (f0_elt->user_data));
+	  uword f1_page = mheap_page_round (h, pointer_to_uword (f1_elt->user_data));
+
+	  if (f1_page > f0_page)
+	    mheap_vm (v, MHEAP_VM_MAP, f0_page, f1_page - f0_page);
+	}
+
+      mheap_elt_set_size (v, uoffset, n_user_data_bytes, /* is_free */ 0);
+
+      /* Mark last element. */
+      mheap_elt_at_uoffset (v, f1)->n_user_data = MHEAP_N_USER_DATA_INVALID;
+      return 1;
+    }
+
+  if (! n->is_free)
+    return 0;
+
+  /* Bytes from start of object up to header of element after free element. */
+  m = mheap_next_elt (n);
+  n_avail = (void *) m - (void *) e->user_data;
+  n_left = n_avail - n_user_data_bytes;
+  if (n_left < 0)
+    return 0;
+
+  remove_free_elt2 (v, n);
+
+  /* Remainder too small to be a free element: give it to object. */
+  if (n_left < (word) (MHEAP_ELT_OVERHEAD_BYTES + MHEAP_MIN_USER_DATA_BYTES))
+    {
+      n_user_data_bytes = n_avail;
+      n_left = 0;
+    }
+
+  /* Pages inside free element (past its free list links) may be unmapped. */
+  if (! (h->flags & (MHEAP_FLAG_DISABLE_VM | MHEAP_FLAG_HUGE_PAGES)))
+    {
+      uword f_page_start, f_page_end, o_page_end;
+
+      f_page_start = mheap_page_round (h, pointer_to_uword (n + 1));
+      f_page_end = mheap_page_truncate (h, pointer_to_uword (m));
+      o_page_end = mheap_page_round (h, (pointer_to_uword (e->user_data)
+					 + n_user_data_bytes + sizeof (mheap_elt_t)));
+      if (o_page_end > f_page_end)
+	o_page_end = f_page_end;
+
+      if (o_page_end > f_page_start)
+	clib_mem_vm_map (uword_to_pointer (f_page_start, void *),
+			 o_page_end - f_page_start);
+    }
 
+  mheap_elt_set_size (v, uoffset, n_user_data_bytes, /* is_free */ 0);
+
+  if (n_left > 0)
+    {
+      f0 = uoffset + n_user_data_bytes + MHEAP_ELT_OVERHEAD_BYTES;
+      new_free_elt (v, f0, n_left - MHEAP_ELT_OVERHEAD_BYTES);
       if (! (h->flags & MHEAP_FLAG_DISABLE_VM))
 	mheap_vm_elt (v, MHEAP_VM_UNMAP, f0);
     }
 
- done:
+  return 1;
+}
+
+uword mheap_realloc (void * v, uword uoffset, uword n_user_data_bytes)
+{
+  mheap_t * h;
+  uword ok;
+
+  if (! v)
+    return 0;
+
   h = mheap_header (v);
 
-  if (h->flags & MHEAP_FLAG_TRACE)
-    {
-      /* Recursion block for case when we are traceing main clib heap. */
-      h->flags &= ~MHEAP_FLAG_TRACE;
+  /* Trace keeps per object sizes and guard keeps canary after object:
+     let caller copy. */
+  if ((h->flags & (MHEAP_FLAG_TRACE | MHEAP_FLAG_GUARD))
+      || mheap_trace_maybe_sampled (h, uoffset))
+    return 0;
 
-      mheap_put_trace (v, trace_uoffset, trace_n_user_data_bytes);
+  n_user_data_bytes = clib_max (n_user_data_bytes, MHEAP_MIN_USER_DATA_BYTES);
+  n_user_data_bytes = round_pow2 (n_user_data_bytes, MHEAP_USER_DATA_WORD_BYTES);
 
-      h->flags |= MHEAP_FLAG_TRACE;
-    }
+  mheap_maybe_lock (v);
+
+  if (h->flags & MHEAP_FLAG_VALIDATE)
+    mheap_validate (v);
+
+  ok = mheap_realloc_no_lock (v, uoffset, n_user_data_bytes);
+  h->stats.n_reallocs_in_place += ok;
 
   if (h->flags & MHEAP_FLAG_VALIDATE)
     mheap_validate (v);
 
   mheap_maybe_unlock (v);
 
-  cpu_times[1] = clib_cpu_time_now ();
-  h->stats.n_clocks_put += cpu_times[1] - cpu_times[0];
+  return ok;
 }
 
 void * mheap_alloc_with_flags (void * memory, uword memory_size, uword flags)
 {
   mheap_t * h;
   void * v;
-  uword size;
+  uword size, page_size, is_transparent;
 
-  if (! mheap_page_size)
-    mheap_page_size = clib_mem_get_page_size ();
+  page_size = clib_mem_get_page_size ();
+  is_transparent = 0;
 
   if (! memory)
     {
       /* No memory given, try to VM allocate some. */
-      memory = clib_mem_vm_alloc (memory_size);
+      if (flags & MHEAP_FLAG_HUGE_PAGES)
+	{
+	  memory = clib_mem_vm_alloc_huge (memory_size, &page_size, &is_transparent);
+	  memory_size = round_pow2 (memory_size, CLIB_MEM_HUGE_PAGE_BYTES);
+
+	  /* Kernel would not give us huge pages: use normal pages. */
+	  if (page_size < CLIB_MEM_HUGE_PAGE_BYTES)
+	    flags &= ~MHEAP_FLAG_HUGE_PAGES;
+	}
+      else
+	memory = clib_mem_vm_alloc (memory_size);
       if (! memory)
 	return 0;
 
@@ -828,17 +1678,27 @@ void * mheap_alloc_with_flags (void * memory, uword memory_size, uword flags)
       flags &= ~MHEAP_FLAG_DISABLE_VM;
     }
 
+  /* Arenas keep pages mapped so that reset and re-use make no system calls. */
+  if (flags & MHEAP_FLAG_ARENA)
+    flags = ((flags | MHEAP_FLAG_DISABLE_VM)
+	     &~ (MHEAP_FLAG_MAGAZINES | MHEAP_FLAG_SMALL_OBJECT_CACHE | MHEAP_FLAG_SLAB
+		 | MHEAP_FLAG_REMOTE_FREE | MHEAP_FLAG_TRACE_SAMPLE | MHEAP_FLAG_GUARD));
+
   /* Make sure that given memory is page aligned. */
   {
     uword am, av, ah;
 
+    /* Caller supplied memory is assumed to be huge page aligned. */
+    if (flags & MHEAP_FLAG_HUGE_PAGES)
+      page_size = CLIB_MEM_HUGE_PAGE_BYTES;
+
     am = pointer_to_uword (memory);
-    av = mheap_page_round (am);
+    av = (am + page_size - 1) &~ (page_size - 1);
     v = uword_to_pointer (av, void *);
     h = mheap_header (v);
     ah = pointer_to_uword (h);
     while (ah < am)
-      ah += mheap_page_size;
+      ah += page_size;
 
     h = uword_to_pointer (ah, void *);
     v = mheap_vector (h);
@@ -852,12 +1712,27 @@ void * mheap_alloc_with_flags (void * memory, uword memory_size, uword flags)
 
   h->vm_alloc_offset_from_header = (void *) h - memory;
   h->vm_alloc_size = memory_size;
+  h->vm_page_size = page_size;
+  h->vm_huge_pages_are_transparent = is_transparent;
+  h->numa_node = ~0;
 
   h->max_size = size;
 
   /* Set flags based on those given less builtin-flags. */
   h->flags |= (flags &~ MHEAP_FLAG_TRACE);
 
+  /* Slabs take the place of magazines and small object cache. */
+  if (h->flags & MHEAP_FLAG_SLAB)
+    h->flags &= ~(MHEAP_FLAG_MAGAZINES | MHEAP_FLAG_SMALL_OBJECT_CACHE);
+  memset (h->slab_partial_pages, ~0, sizeof (h->slab_partial_pages));
+
+  /* Guard checks every free: objects must not be cached on the side. */
+  if (h->flags & MHEAP_FLAG_GUARD)
+    {
+      h->flags &= ~(MHEAP_FLAG_MAGAZINES | MHEAP_FLAG_SMALL_OBJECT_CACHE | MHEAP_FLAG_SLAB);
+      h->guard_secret = clib_cpu_time_now () ^ ((u64) pointer_to_uword (h) << 16);
+    }
+
   /* Unmap remainder of heap until we will be ready to use it. */
   if (! (h->flags & MHEAP_FLAG_DISABLE_VM))
     mheap_vm (v, MHEAP_VM_UNMAP | MHEAP_VM_ROUND_UP,
@@ -878,18 +1753,37 @@ void * mheap_alloc_with_flags (void * memory, uword memory_size, uword flags)
   return v;
 }
 
-void * mheap_alloc (void * memory, uword size)
+/* Flags used by mheap_alloc for given memory. */
+uword mheap_default_flags (void * memory)
 {
   uword flags = 0;
 
   if (memory != 0)
     flags |= MHEAP_FLAG_DISABLE_VM;
 
+  /* Per-cpu magazines take a few kilobytes of heap per cpu: not
+     worth it for small user supplied heaps (e.g. mheap_foreach's stack heap). */
+  else
+    flags |= MHEAP_FLAG_MAGAZINES;
+
 #if CLIB_VECTOR_WORD_BITS >= 128
   flags |= MHEAP_FLAG_SMALL_OBJECT_CACHE;
 #endif
 
-  return mheap_alloc_with_flags (memory, size, flags);
+  return flags;
+}
+
+void * mheap_alloc (void * memory, uword size)
+{ return mheap_alloc_with_flags (memory, size, mheap_default_flags (memory)); }
+
+/* Bind heap's memory (mapped now or later) to given NUMA node. */
+void mheap_set_numa_node (void * v, uword node)
+{
+  mheap_t * h = mheap_header (v);
+  void * memory = (void *) h - h->vm_alloc_offset_from_header;
+
+  h->numa_node = node;
+  clib_mem_vm_bind_numa_node (memory, h->vm_alloc_size, node);
 }
 
 void * _mheap_free (void * v)
@@ -961,10 +1855,46 @@ mheap_bytes_overhead (void * v)
 uword mheap_bytes (void * v)
 { return mheap_bytes_overhead (v) + vec_bytes (v); }
 
+/* Count objects and bytes sitting on magazines of all cpus. */
+static void
+mheap_magazine_usage (void * v, uword * n_objects_return, uword * n_bytes_return)
+{
+  mheap_t * h = mheap_header (v);
+  uword cpu, bin, i, n_objects = 0, n_bytes = 0;
+
+  for (cpu = 0; h->per_cpu && cpu < h->n_per_cpu; cpu++)
+    for (bin = 0; h->per_cpu[cpu] && bin < MHEAP_N_MAGAZINE_BINS; bin++)
+      {
+	mheap_magazine_t * m = h->per_cpu[cpu]->magazines + bin;
+	for (i = 0; i < m->n_offsets; i++)
+	  n_bytes += mheap_data_bytes (v, m->offsets[i]);
+	n_objects += m->n_offsets;
+      }
+
+  *n_objects_return = n_objects;
+  *n_bytes_return = n_bytes;
+}
+
+/* Bytes in free slots of slab pages. */
+static uword
+mheap_slab_free_bytes (void * v)
+{
+  mheap_t * h = mheap_header (v);
+  uword c, o, n_bytes = 0;
+
+  for (c = 0; c < MHEAP_SLAB_N_CLASSES; c++)
+    for (o = h->slab_partial_pages[c]; o != (u32) ~0; o = ((mheap_slab_page_t *) (v + o))->next_uoffset)
+      n_bytes += ((mheap_slab_page_t *) (v + o))->n_free_slots * mheap_slab_class_bytes (c);
+
+  return n_bytes;
+}
+
 static void mheap_usage_no_lock (void * v, clib_mem_usage_t * usage)
 {
   mheap_t * h = mheap_header (v);
   uword used = 0, free = 0, free_vm_unmapped = 0;
+  uword n_magazine_objects = 0, n_magazine_bytes = 0;
+  uword n_slab_objects = 0;
 
   if (vec_len (v) > 0)
     {
@@ -985,15 +1915,138 @@ static void mheap_usage_no_lock (void * v, clib_mem_usage_t * usage)
 	  else
 	    used += size;
 	}
+
+      /* Objects on magazines are free as far as users are concerned. */
+      mheap_magazine_usage (v, &n_magazine_objects, &n_magazine_bytes);
+      used -= n_magazine_bytes;
+      free += n_magazine_bytes;
+
+      /* Count slab objects instead of slab pages (and page bitmap). */
+      if (h->slab_page_bitmap)
+	{
+	  uword n_slab_free_bytes = mheap_slab_free_bytes (v);
+	  used -= n_slab_free_bytes;
+	  free += n_slab_free_bytes;
+	  n_slab_objects = h->n_slab_objects - h->n_slab_pages - 1;
+	}
     }
 
-  usage->object_count = mheap_elts (v);
+  usage->object_count = mheap_elts (v) - n_magazine_objects + n_slab_objects;
   usage->bytes_total = mheap_bytes (v);
   usage->bytes_overhead = mheap_bytes_overhead (v);
   usage->bytes_max = mheap_max_size (v);
   usage->bytes_used = used;
   usage->bytes_free = free;
   usage->bytes_free_reclaimed = free_vm_unmapped;
+  usage->bytes_trimmed = v ? h->stats.n_bytes_trimmed : 0;
+}
+
+/* Free this cpu's magazines and small object cache back into heap.
+   Other cpus' magazines are only touched by their owners.
+   Caller holds heap lock. */
+static void mheap_flush_caches (void * v)
+{
+  mheap_t * h = mheap_header (v);
+  mheap_per_cpu_t * pc = mheap_magazines_for_cpu (v);
+  uword i;
+
+  for (i = 0; pc && i < MHEAP_N_MAGAZINE_BINS; i++)
+    {
+      mheap_magazine_t * m = pc->magazines + i;
+      while (m->n_offsets > 0)
+	{
+	  m->n_offsets -= 1;
+	  mheap_magazine_set_held (v, m->offsets[m->n_offsets], 0);
+	  mheap_put_no_lock (v, m->offsets[m->n_offsets]);
+	}
+    }
+
+  if (MHEAP_HAVE_SMALL_OBJECT_CACHE
+      && (h->flags & MHEAP_FLAG_SMALL_OBJECT_CACHE))
+    {
+      mheap_small_object_cache_t * c = &h->small_object_cache;
+
+      /* Disable cache so that objects really get freed.  Cached objects
+	 are not counted as allocated: count them for mheap_put_no_lock. */
+      h->flags &= ~MHEAP_FLAG_SMALL_OBJECT_CACHE;
+      for (i = 0; i < BITS (uword); i++)
+	if (c->bins.as_u8[i] != 0)
+	  {
+	    c->bins.as_u8[i] = 0;
+	    h->n_elts += 1;
+	    mheap_put_no_lock (v, c->offsets[i]);
+	  }
+      h->flags |= MHEAP_FLAG_SMALL_OBJECT_CACHE;
+    }
+}
+
+/* Release pages strictly inside address range keeping it mapped. */
+static uword mheap_trim_range (mheap_t * h, uword start, uword end)
+{
+  start = mheap_page_round (h, start);
+  end = mheap_page_truncate (h, end);
+  if (end <= start)
+    return 0;
+  clib_mem_vm_release (uword_to_pointer (start, void *), end - start);
+  return end - start;
+}
+
+uword mheap_trim (void * v, uword target_bytes)
+{
+  mheap_t * h;
+  uword n_trimmed = 0;
+
+  if (! v)
+    return 0;
+
+  h = mheap_header (v);
+
+  mheap_maybe_lock (v);
+
+  mheap_flush_caches (v);
+
+  /* Heaps with virtual memory unmap pages of free elements as objects
+     are freed.  Others keep them resident until trimmed. */
+  if (h->flags & MHEAP_FLAG_DISABLE_VM)
+    {
+      uword i, bin;
+      u32 uo;
+      mheap_elt_t * e;
+
+      /* Pages past end of heap. */
+      if (h->trim_tail_end > vec_len (v))
+	n_trimmed += mheap_trim_range (h, pointer_to_uword (v + vec_len (v)),
+				       pointer_to_uword (v + clib_min (h->trim_tail_end, h->max_size)));
+      h->trim_tail_end = 0;
+
+      /* Pages inside free elements: largest bins first. */
+      for (i = ARRAY_LEN (h->non_empty_free_elt_heads); i > 0 && n_trimmed < target_bytes; i--)
+	{
+	  uword heads = h->non_empty_free_elt_heads[i - 1];
+	  while (heads != 0 && n_trimmed < target_bytes)
+	    {
+	      bin = min_log2 (heads);
+	      heads ^= (uword) 1 << bin;
+	      bin += (i - 1) * BITS (uword);
+
+	      for (uo = h->first_free_elt_uoffset_by_bin[bin];
+		   uo != ~0 && n_trimmed < target_bytes;
+		   uo = e->free_elt.next_uoffset)
+		{
+		  e = mheap_elt_at_uoffset (v, uo);
+		  n_trimmed += mheap_trim_range (h, pointer_to_uword (e + 1),
+						 pointer_to_uword (mheap_next_elt (e)));
+		}
+	    }
+	}
+    }
+
+  h->stats.n_trims += 1;
+  h->stats.n_bytes_trimmed += n_trimmed;
+
+  mheap_maybe_unlock (v);
+
+  return n_trimmed;
 }
 
 void mheap_usage (void * v, clib_mem_usage_t * usage)
@@ -1042,12 +2095,66 @@ static mheap_elt_t * mheap_first_corrupt (void * v)
   return 0;
 }
 
+/* Sum heap's statistics and those kept by each cpu.  Per-cpu
+   statistics are read without locking so sums may be slightly stale. */
+void mheap_get_stats (void * v, mheap_stats_t * result)
+{
+  mheap_t * h = mheap_header (v);
+  u64 * r = (u64 *) result;
+  uword cpu, i;
+
+  result[0] = h->stats;
+  for (cpu = 0; h->per_cpu && cpu < h->n_per_cpu; cpu++)
+    if (h->per_cpu[cpu])
+      {
+	u64 * c = (u64 *) &h->per_cpu[cpu]->stats;
+	for (i = 0; i < sizeof (result[0]) / sizeof (r[0]); i++)
+	  r[i] += c[i];
+      }
+}
+
+/* Non-empty bins of log2 histogram, one per line. */
+static u8 * format_mheap_log2_histogram (u8 * s, va_list * va)
+{
+  u64 * counts = va_arg (*va, u64 *);
+  uword n_bins = va_arg (*va, uword);
+  int is_bytes = va_arg (*va, int);
+  uword indent = format_get_indent (s);
+  uword i, n_lines;
+  u64 total = 0;
+
+  for (i = 0; i < n_bins; i++)
+    total += counts[i];
+
+  n_lines = 0;
+  for (i = 0; i < n_bins; i++)
+    {
+      if (counts[i] == 0)
+	continue;
+      if (n_lines++ > 0)
+	s = format (s, "\n%U", format_white_space, indent);
+      /* Bin i is [2^i, 2^(i+1)); bin 0 includes zero. */
+      if (is_bytes)
+	s = format (s, "%U - %U", format_mheap_byte_count, i == 0 ? 0 : (uword) 1 << i,
+		    format_mheap_byte_count, (uword) 2 << i);
+      else
+	s = format (s, "%wd - %wd", i == 0 ? 0 : (uword) 1 << i, (uword) 2 << i);
+      if (i == n_bins - 1)
+	s = format (s, "+");
+      s = format (s, ": %Ld (%.2f%%)", counts[i], 100. * (f64) counts[i] / (f64) total);
+    }
+
+  return s;
+}
+
 static u8 * format_mheap_stats (u8 * s, va_list * va)
 {
   mheap_t * h = va_arg (*va, mheap_t *);
-  mheap_stats_t * st = &h->stats;
+  mheap_stats_t _st, * st = &_st;
   uword indent = format_get_indent (s);
 
+  mheap_get_stats (mheap_vector (h), st);
+
   s = format (s, "alloc. from small object cache: %Ld hits %Ld attempts (%.2f%%) replacements %d",
 	      st->n_small_object_cache_hits,
 	      st->n_small_object_cache_attempts,
@@ -1056,6 +2163,39 @@ static u8 * format_mheap_stats (u8 * s, va_list * va)
 	       : 0.),
 	      h->small_object_cache.replacement_index);
 
+  if (h->flags & MHEAP_FLAG_MAGAZINES)
+    {
+      u64 n_hits = st->n_magazine_hits;
+
+      s = format (s, "\n%Ualloc. from magazines: %Ld hits %Ld misses (%.2f%%) %Ld drains",
+		  format_white_space, indent,
+		  n_hits, st->n_magazine_misses,
+		  (n_hits + st->n_magazine_misses != 0
+		   ? 100. * (f64) n_hits / (f64) (n_hits + st->n_magazine_misses)
+		   : 0.),
+		  st->n_magazine_drains);
+    }
+
+  if (h->flags & MHEAP_FLAG_SLAB)
+    s = format (s, "\n%Uslab: %wd objects in %d pages",
+		format_white_space, indent,
+		h->n_slab_objects, h->n_slab_pages);
+
+  if (h->flags & MHEAP_FLAG_GUARD)
+    s = format (s, "\n%Uguard: %d objects in quarantine, %Ld elements checked",
+		format_white_space, indent,
+		h->guard_n_quarantine, st->n_guard_elts_checked);
+
+  if (h->flags & MHEAP_FLAG_ARENA)
+    s = format (s, "\n%Uarena: %Ld allocations, %Ld resets",
+		format_white_space, indent,
+		st->n_arena_gets, st->n_arena_resets);
+
+  if (h->flags & MHEAP_FLAG_REMOTE_FREE)
+    s = format (s, "\n%Ufrees from other cpus: %Ld",
+		format_white_space, indent,
+		st->n_remote_frees);
+
   s = format (s, "\n%Ualloc. from free-list: %Ld attempts, %Ld hits (%.2f%%), %Ld considered (per-attempt %.2f)",
 	      format_white_space, indent,
 	      st->free_list.n_search_attempts,
@@ -1072,15 +2212,33 @@ static u8 * format_mheap_stats (u8 * s, va_list * va)
 	      format_white_space, indent,
 	      st->n_vector_expands);
 
+  s = format (s, "\n%Ureallocs in place: %Ld",
+	      format_white_space, indent,
+	      st->n_reallocs_in_place);
+
   s = format (s, "\n%Uallocs: %Ld %.2f clocks/call",
 	      format_white_space, indent,
 	      st->n_gets,
-	      (f64) st->n_clocks_get / (f64) st->n_gets);
+	      st->n_gets != 0 ? (f64) st->n_clocks_get / (f64) st->n_gets : 0.);
 
   s = format (s, "\n%Ufrees: %Ld %.2f clocks/call",
 	      format_white_space, indent,
 	      st->n_puts,
-	      (f64) st->n_clocks_put / (f64) st->n_puts);
+	      st->n_puts != 0 ? (f64) st->n_clocks_put / (f64) st->n_puts : 0.);
+
+  if (st->n_gets + st->n_magazine_hits > 0)
+    s = format (s, "\n%Urequested sizes:\n%U%U",
+		format_white_space, indent,
+		format_white_space, indent + 2,
+		format_mheap_log2_histogram, st->n_gets_by_log2_size,
+		(uword) MHEAP_N_LOG2_SIZE_BINS, /* is_bytes */ 1);
+
+  if (st->free_list.n_search_attempts > 0)
+    s = format (s, "\n%Ufree objects examined per free-list search:\n%U%U",
+		format_white_space, indent,
+		format_white_space, indent + 2,
+		format_mheap_log2_histogram, st->free_list.n_searches_by_log2_length,
+		(uword) MHEAP_N_LOG2_SEARCH_BINS, /* is_bytes */ 0);
 	      
   return s;
 }
@@ -1111,9 +2269,20 @@ u8 * format_mheap (u8 * s, va_list * va)
 	      format_mheap_byte_count, usage.bytes_free_reclaimed,
 	      format_mheap_byte_count, usage.bytes_overhead);
 
+  if (usage.bytes_trimmed > 0)
+    s = format (s, ", %U trimmed", format_mheap_byte_count, usage.bytes_trimmed);
+
   if (usage.bytes_max != ~0)
     s = format (s, ", %U capacity", format_mheap_byte_count, usage.bytes_max);
 
+  if (v)
+    s = format (s, ", %U%s pages",
+		format_mheap_byte_count, h->vm_page_size,
+		h->vm_huge_pages_are_transparent ? " transparent" : "");
+
+  if (v && h->numa_node != ~0)
+    s = format (s, ", numa node %d", h->numa_node);
+
   /* Show histogram of sizes. */
   if (verbose > 1)
     {
@@ -1200,6 +2369,29 @@ u8 * format_mheap (u8 * s, va_list * va)
       vec_free (traces_copy);
   }
 
+  if ((h->flags & MHEAP_FLAG_TRACE_SAMPLE) && vec_len (h->trace_main.traces) > 0)
+    {
+      mheap_trace_t * t;
+      u64 live_bytes = 0, total_bytes = 0;
+
+      vec_foreach (t, h->trace_main.traces)
+	{
+	  live_bytes += t->live_bytes;
+	  total_bytes += t->total_bytes;
+	}
+
+      s = format (s, "\n%U%U estimated live, %U allocated, sampled every %U; live bytes by call site:\n%U",
+		  format_white_space, indent + 2,
+		  format_mheap_byte_count, (uword) live_bytes,
+		  format_mheap_byte_count, (uword) total_bytes,
+		  format_mheap_byte_count, h->trace_main.sample_period_bytes,
+		  format_mheap_trace_folded, v, /* use_total_bytes */ 0);
+
+      if (verbose)
+	s = format (s, "allocated bytes by call site:\n%U",
+		    format_mheap_trace_folded, v, /* use_total_bytes */ 1);
+    }
+
   first_corrupt = mheap_first_corrupt (v);
   if (first_corrupt)
     {
@@ -1338,6 +2530,48 @@ void mheap_validate (void * v)
 	}
     }
 
+  /* Objects on magazines must be allocated. */
+  {
+    uword cpu, bin;
+
+    for (cpu = 0; h->per_cpu && cpu < h->n_per_cpu; cpu++)
+      for (bin = 0; h->per_cpu[cpu] && bin < MHEAP_N_MAGAZINE_BINS; bin++)
+	{
+	  mheap_magazine_t * m = h->per_cpu[cpu]->magazines + bin;
+
+	  CHECK (m->n_offsets <= MHEAP_MAGAZINE_SIZE);
+	  for (i = 0; i < m->n_offsets; i++)
+	    {
+	      mheap_elt_t * e = mheap_elt_at_uoffset (v, m->offsets[i]);
+	      CHECK (! e->is_free);
+	      CHECK (mheap_magazine_is_held (v, m->offsets[i]));
+	      CHECK (mheap_magazine_bin (mheap_elt_data_bytes (e)) >= bin);
+	    }
+	}
+  }
+
+  /* Slab pages with free slots must be allocated slabs of their class
+     with free slot bitmap agreeing with free count. */
+  {
+    uword c, o, n_free;
+
+    for (c = 0; c < MHEAP_SLAB_N_CLASSES; c++)
+      for (o = h->slab_partial_pages[c]; o != (u32) ~0; o = ((mheap_slab_page_t *) (v + o))->next_uoffset)
+	{
+	  mheap_slab_page_t * p = v + o;
+
+	  CHECK (! mheap_elt_at_uoffset (v, o)->is_free);
+	  CHECK (mheap_is_slab_object (h, o));
+	  CHECK (p->class == c);
+	  CHECK (p->n_free_slots > 0 && p->n_free_slots <= p->n_slots);
+
+	  n_free = 0;
+	  for (i = 0; i < ARRAY_LEN (p->free_slots); i++)
+	    n_free += count_set_bits (p->free_slots[i]);
+	  CHECK (n_free == p->n_free_slots);
+	}
+  }
+
   {
     mheap_elt_t * e, * n;
     uword elt_free_size, elt_free_count;
@@ -1365,6 +2599,9 @@ void mheap_validate (void * v)
 	    elt_free_count++;
 	    elt_free_size += s;
 	  }
+	else if (h->flags & MHEAP_FLAG_GUARD)
+	  CHECK (mheap_guard_canary_is_valid (v, mheap_elt_uoffset (v, e), 0)
+		 || mheap_guard_canary_is_valid (v, mheap_elt_uoffset (v, e), 1));
 
 	/* Consecutive free objects should have been combined. */
 	CHECK (! (e->prev_is_free && n->prev_is_free));
@@ -1395,7 +2632,78 @@ void mheap_validate (void * v)
   h->validate_serial += 1;
 }
 
-static void mheap_get_trace (void * v, uword offset, uword size)
+/* 1 - exp (-x) for x >= 0 without libm: Taylor series for small x,
+   squaring exp (-x / 2^k) for larger x. */
+static f64 mheap_one_minus_exp_neg (f64 x)
+{
+  f64 e;
+  uword k = 0;
+
+  if (x > 40)
+    return 1;
+
+  while (x > (1. / 16))
+    {
+      x *= .5;
+      k++;
+    }
+
+  /* 1 - exp (-x) to 4th order. */
+  e = x * (1 - x * (1./2 - x * (1./6 - x * (1./24))));
+  while (k-- > 0)
+    e = e * (2 - e);
+
+  return e;
+}
+
+/* Bytes represented by traced object of given size.  A sample stands
+   for all bytes allocated since previous sample: size scaled by inverse
+   of probability that object of this size was sampled. */
+static u64 mheap_trace_weight (mheap_trace_main_t * tm, uword size)
+{
+  f64 p;
+
+  if (tm->sample_period_bytes == 0)
+    return size;
+
+  p = mheap_one_minus_exp_neg ((f64) size / (f64) tm->sample_period_bytes);
+  return p > 0 ? (f64) size / p : tm->sample_period_bytes;
+}
+
+/* Pick exponentially distributed number of bytes until next sample
+   so that every allocated byte is equally likely to be sampled:
+   -log (u) * period for u uniform in (0, 1].  Log is approximated
+   from u's exponent and mantissa (error < 1%); sampling does not
+   need more. */
+static void mheap_trace_sample_reset (mheap_trace_main_t * tm)
+{
+  uword q = 1 + (random_u32 (&tm->sample_seed) & ((1 << 26) - 1));
+  uword e = min_log2 (q);
+  f64 m, log2_q;
+
+  /* q = 2^e (1 + m) with 0 <= m < 1. */
+  m = (f64) (q - ((uword) 1 << e)) / (f64) ((uword) 1 << e);
+  log2_q = e + m * (1 + 0.346607 * (1 - m));
+
+  /* -log (q / 2^26) = (26 - log2 (q)) * log (2). */
+  tm->bytes_until_sample = 1 + (word) ((26 - log2_q) * 0.693147 * (f64) tm->sample_period_bytes);
+}
+
+/* Returns non-zero if allocation of given size is to be sampled. */
+static uword mheap_trace_sample_countdown (mheap_t * h, uword size)
+{
+  mheap_trace_main_t * tm = &h->trace_main;
+
+  tm->bytes_until_sample -= size;
+  if (tm->bytes_until_sample > 0)
+    return 0;
+
+  mheap_trace_sample_reset (tm);
+  return 1;
+}
+
+/* Not inlined so that backtrace frame count below is right. */
+static never_inline void mheap_get_trace (void * v, uword offset, uword size)
 {
   mheap_t * h;
   mheap_trace_main_t * tm;
@@ -1461,13 +2769,23 @@ static void mheap_get_trace (void * v, uword offset, uword size)
       t[0] = trace;
       t->n_allocations = 0;
       t->n_bytes = 0;
+      t->live_bytes = 0;
+      t->total_bytes = 0;
       hash_set_mem (tm->trace_by_callers, t->callers, trace_index);
     }
 
   t->n_allocations += 1;
   t->n_bytes += size;
+  t->live_bytes += mheap_trace_weight (tm, size);
+  t->total_bytes += mheap_trace_weight (tm, size);
   t->offset = offset;           /* keep a sample to autopsy */
   hash_set (tm->trace_index_by_offset, offset, t - tm->traces);
+
+  if (tm->sample_filter)
+    {
+      u8 * f = tm->sample_filter + mheap_trace_sample_filter_index (offset);
+      f[0] += f[0] < 255;
+    }
 }
 
 static void mheap_put_trace (void * v, uword offset, uword size)
@@ -1492,7 +2810,17 @@ static void mheap_put_trace (void * v, uword offset, uword size)
   ASSERT (t->n_bytes >= size);
   t->n_allocations -= 1;
   t->n_bytes -= size;
-  if (t->n_allocations == 0)
+  t->live_bytes -= clib_min (t->live_bytes, mheap_trace_weight (tm, size));
+
+  if (tm->sample_filter)
+    {
+      u8 * f = tm->sample_filter + mheap_trace_sample_filter_index (offset);
+      ASSERT (f[0] > 0);
+      f[0] -= f[0] < 255;
+    }
+
+  /* Sampled traces are kept to report total bytes allocated. */
+  if (t->n_allocations == 0 && tm->sample_period_bytes == 0)
     {
       hash_unset_mem (tm->trace_by_callers, t->callers);
       vec_add1 (tm->trace_free_list, trace_index);
@@ -1506,7 +2834,7 @@ static int mheap_trace_sort (const void * _t1, const void * _t2)
   const mheap_trace_t * t2 = _t2;
   word cmp;
 
-  cmp = (word) t2->n_bytes - (word) t1->n_bytes;
+  cmp = t2->live_bytes < t1->live_bytes ? -1 : t2->live_bytes > t1->live_bytes;
   if (! cmp)
     cmp = (word) t2->n_allocations - (word) t1->n_allocations;
   return cmp;
@@ -1519,6 +2847,8 @@ mheap_trace_main_free (mheap_trace_main_t * tm)
   vec_free (tm->trace_free_list);
   hash_free (tm->trace_by_callers);
   hash_free (tm->trace_index_by_offset);
+  vec_free (tm->sample_filter);
+  tm->sample_period_bytes = 0;
 }
 
 void mheap_trace (void * v, int enable)
@@ -1527,6 +2857,13 @@ void mheap_trace (void * v, int enable)
 
   h = mheap_header (v);
 
+  /* Full tracing replaces sampling. */
+  if (enable || (h->flags & MHEAP_FLAG_TRACE_SAMPLE))
+    {
+      h->flags &= ~MHEAP_FLAG_TRACE_SAMPLE;
+      mheap_trace_main_free (&h->trace_main);
+    }
+
   if (enable)
     {
       h->flags |= MHEAP_FLAG_TRACE;
@@ -1537,3 +2874,68 @@ void mheap_trace (void * v, int enable)
       h->flags &= ~MHEAP_FLAG_TRACE;
     }
 }
+
+/* Trace one allocation for about every sample_period_bytes allocated;
+   zero period turns sampling off. */
+void mheap_trace_sample (void * v, uword sample_period_bytes)
+{
+  mheap_t * h = mheap_header (v);
+  mheap_trace_main_t * tm = &h->trace_main;
+  void * old_heap;
+
+  /* Clear flags first so trace vectors are not traced. */
+  h->flags &= ~(MHEAP_FLAG_TRACE | MHEAP_FLAG_TRACE_SAMPLE);
+
+  /* Sample filter lives in traced heap. */
+  old_heap = clib_mem_set_heap (v);
+
+  mheap_trace_main_free (tm);
+
+  if (sample_period_bytes > 0)
+    {
+      tm->sample_period_bytes = sample_period_bytes;
+      tm->sample_seed = pointer_to_uword (v);
+      vec_validate (tm->sample_filter, MHEAP_TRACE_SAMPLE_FILTER_SIZE - 1);
+      mheap_trace_sample_reset (tm);
+      h->flags |= MHEAP_FLAG_TRACE_SAMPLE;
+    }
+
+  clib_mem_set_heap (old_heap);
+}
+
+/* Sampled allocation profile in folded stack format: one line per
+   call site with frames outermost first separated by semicolons
+   followed by estimated live (or total) bytes. */
+u8 * format_mheap_trace_folded (u8 * s, va_list * va)
+{
+  void * v = va_arg (*va, void *);
+  int use_total_bytes = va_arg (*va, int);
+  mheap_t * h = mheap_header (v);
+  mheap_trace_t * t, * traces_copy;
+  word i;
+
+  /* Copy since formatting may allocate from (and sample) this heap. */
+  traces_copy = vec_dup (h->trace_main.traces);
+  qsort (traces_copy, vec_len (traces_copy), sizeof (traces_copy[0]),
+	 mheap_trace_sort);
+
+  vec_foreach (t, traces_copy)
+    {
+      u64 n_bytes = use_total_bytes ? t->total_bytes : t->live_bytes;
+
+      if (n_bytes == 0)
+	continue;
+
+      for (i = ARRAY_LEN (t->callers) - 1; i >= 0; i--)
+	{
+	  if (! t->callers[i])
+	    continue;
+	  s = format (s, "%U%s", format_symbol_name, t->callers[i], i > 0 ? ";" : "");
+	}
+      s = format (s, " %Ld\n", n_bytes);
+    }
+
+  vec_free (traces_copy);
+
+  return s;
+}
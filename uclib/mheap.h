@@ -32,6 +32,11 @@ always_inline void * mheap_get (void * v, uword size, uword * offset_return)
 /* Create allocation heap of given size. */
 void * mheap_alloc (void * memory, uword memory_bytes);
 void * mheap_alloc_with_flags (void * memory, uword memory_bytes, uword flags);
+uword mheap_default_flags (void * memory);
+void mheap_set_numa_node (void * v, uword node);
+
+/* Free all objects in heap made with MHEAP_FLAG_ARENA. */
+void mheap_arena_reset (void * v);
 
 #define mheap_free(v) (v) = _mheap_free(v)
 void * _mheap_free (void * v);
@@ -42,6 +47,7 @@ void mheap_foreach (void * v,
 
 /* Format mheap data structures as string. */
 u8 * format_mheap (u8 * s, va_list * va);
+u8 * format_mheap_trace_folded (u8 * s, va_list * va);
 
 /* Validate internal consistency. */
 void mheap_validate (void * h);
@@ -51,7 +57,23 @@ uword mheap_bytes (void * v);
 
 void mheap_usage (void * v, clib_mem_usage_t * usage);
 
+/* Give free memory back to operating system until at least
+   target_bytes have been given back (~0 for all).  Returns bytes given
+   back with madvise; heaps with virtual memory unmap free pages as objects
+   are freed so for them trim only flushes this cpu's caches. */
+uword mheap_trim (void * v, uword target_bytes);
+
+/* Heap statistics summed over all cpus. */
+void mheap_get_stats (void * v, mheap_stats_t * stats);
+
+/* Called when MHEAP_FLAG_GUARD finds heap corruption instead of
+   panicking.  Corrupt object is left alone (never given back to heap)
+   and its offset stays in guard_corrupt_uoffset. */
+typedef void mheap_guard_corrupt_handler_t (void * arg, void * v, uword uoffset, char * why);
+void mheap_guard_register_corrupt_handler (mheap_guard_corrupt_handler_t * f, void * arg);
+
 /* Enable disable traceing. */
 void mheap_trace (void * v, int enable);
+void mheap_trace_sample (void * v, uword sample_period_bytes);
 
 #endif /* included_mheap_h */
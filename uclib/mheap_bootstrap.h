@@ -82,11 +82,31 @@ typedef struct {
 
   /* Offset of this item */
   uword offset;    
+
+  /* Bytes live and bytes allocated since tracing started.  When
+     sampling these are estimates scaled by sample period. */
+  u64 live_bytes, total_bytes;
 } mheap_trace_t;
 
+/* Counts of sampled objects hashed by offset (MHEAP_FLAG_TRACE_SAMPLE).
+   Lets free fast path skip objects which cannot have been sampled. */
+#define MHEAP_TRACE_SAMPLE_FILTER_SIZE 4096
+
 typedef struct {
   mheap_trace_t * traces;
 
+  /* Sampling: mean number of bytes allocated between samples
+     (zero when every allocation is traced). */
+  uword sample_period_bytes;
+
+  /* Bytes left to allocate before next sample. */
+  word bytes_until_sample;
+
+  u32 sample_seed;
+
+  /* Vector of MHEAP_TRACE_SAMPLE_FILTER_SIZE counts; count saturates at 255. */
+  u8 * sample_filter;
+
   /* Indices of free traces. */
   u32 * trace_free_list;
 
@@ -107,11 +127,26 @@ typedef struct {
   (MHEAP_N_SMALL_OBJECT_BINS						\
    + (STRUCT_BITS_OF (mheap_elt_t, user_data[0]) - MHEAP_LOG2_N_SMALL_OBJECT_BINS))
 
+/* Histogram bin i counts values in [2^i, 2^(i+1)); last bin counts
+   everything larger. */
+#define MHEAP_N_LOG2_SIZE_BINS 32
+#define MHEAP_N_LOG2_SEARCH_BINS 16
+
+always_inline uword mheap_log2_bin (uword x, uword n_bins)
+{
+  uword l = x > 1 ? min_log2 (x) : 0;
+  return l < n_bins ? l : n_bins - 1;
+}
+
+/* All fields are u64 so that per-cpu statistics can be summed as arrays. */
 typedef struct {
   struct {
     u64 n_search_attempts;
     u64 n_objects_searched;
     u64 n_objects_found;
+
+    /* Histogram of number of free objects examined per search. */
+    u64 n_searches_by_log2_length[MHEAP_N_LOG2_SEARCH_BINS];
   } free_list;
 
   u64 n_vector_expands;
@@ -119,10 +154,100 @@ typedef struct {
   u64 n_small_object_cache_hits;
   u64 n_small_object_cache_attempts;
 
+  /* Allocations satisfied from per-cpu magazines. */
+  u64 n_magazine_hits;
+  u64 n_magazine_misses;
+
+  /* Number of times a full magazine was drained back into heap. */
+  u64 n_magazine_drains;
+
+  /* Objects freed by other cpus and returned via remote free list. */
+  u64 n_remote_frees;
+
+  /* Objects grown in place by mheap_realloc. */
+  u64 n_reallocs_in_place;
+
+  /* Arena (MHEAP_FLAG_ARENA) allocations and resets. */
+  u64 n_arena_gets, n_arena_resets;
+
+  /* Elements checked incrementally (MHEAP_FLAG_GUARD). */
+  u64 n_guard_elts_checked;
+
+  /* Calls to mheap_trim and bytes given back to operating system. */
+  u64 n_trims, n_bytes_trimmed;
+
+  /* Slow path calls and time spent in them. */
   u64 n_gets, n_puts;
   u64 n_clocks_get, n_clocks_put;
+
+  /* Histogram of requested sizes of all allocations. */
+  u64 n_gets_by_log2_size[MHEAP_N_LOG2_SIZE_BINS];
 } mheap_stats_t;
 
+/* Per-cpu magazines: size-classed stacks of freed small objects.
+   Objects on magazines are still allocated as far as the heap is concerned.
+   Magazines are refilled from and drained back to the heap in batches
+   so that the common alloc/free pair does not touch free lists or heap lock. */
+#define MHEAP_N_MAGAZINE_BINS 64
+#define MHEAP_MAGAZINE_SIZE 32
+
+typedef struct {
+  /* Number of valid offsets in stack. */
+  u32 n_offsets;
+
+  /* Stack of user offsets of objects for this bin. */
+  u32 offsets[MHEAP_MAGAZINE_SIZE];
+} mheap_magazine_t;
+
+/* Cache aligned so that cpus never share a cache line. */
+typedef struct {
+  mheap_magazine_t magazines[MHEAP_N_MAGAZINE_BINS];
+
+  /* Statistics kept by this cpu; summed with heap's by mheap_get_stats.
+     Avoids sharing statistics cache lines between cpus. */
+  mheap_stats_t stats;
+} __attribute__ ((aligned (CLIB_CACHE_LINE_BYTES))) mheap_per_cpu_t;
+
+/* Slab allocator (MHEAP_FLAG_SLAB): small objects are carved out of
+   page sized slabs, one size class per slab, with a bitmap of free slots.
+   Each slot is preceded by an mheap_elt_t so that clib_mem_size and
+   clib_mem_is_heap_object work as for any other heap object.
+   Class c holds objects of 8 + 16 c bytes so that with element
+   header slot size is a multiple of 16 and user data is 16 byte aligned. */
+#define MHEAP_LOG2_SLAB_PAGE_BYTES 12
+#define MHEAP_SLAB_PAGE_BYTES (1 << MHEAP_LOG2_SLAB_PAGE_BYTES)
+#define MHEAP_SLAB_ALIGN 16
+#define MHEAP_SLAB_N_CLASSES 17
+#define MHEAP_SLAB_MAX_USER_DATA_BYTES (8 + MHEAP_SLAB_ALIGN * (MHEAP_SLAB_N_CLASSES - 1))
+#define MHEAP_SLAB_MAX_SLOTS 256
+
+/* Header at start of each slab page. */
+typedef struct {
+  /* Bitmap of free slots. */
+  uword free_slots[MHEAP_SLAB_MAX_SLOTS / BITS (uword)];
+
+  /* Doubly linked list of pages of this class with free slots. */
+  u32 next_uoffset, prev_uoffset;
+
+  u16 n_slots, n_free_slots;
+
+  /* Size class. */
+  u16 class;
+} mheap_slab_page_t;
+
+/* Offset of first slot's user data from start of slab page. */
+#define MHEAP_SLAB_FIRST_SLOT_OFFSET \
+  ((sizeof (mheap_slab_page_t) + MHEAP_ELT_OVERHEAD_BYTES + MHEAP_SLAB_ALIGN - 1) &~ (MHEAP_SLAB_ALIGN - 1))
+
+/* Guard mode: canary occupies last 8 bytes of each object.
+   Freed objects have canary inverted and first bytes poisoned while
+   in quarantine; both are checked when object leaves quarantine. */
+#define MHEAP_GUARD_CANARY_BYTES sizeof (u64)
+#define MHEAP_GUARD_POISON_BYTES 64
+#define MHEAP_GUARD_POISON 0xdfdfdfdfdfdfdfdfULL
+#define MHEAP_GUARD_QUARANTINE_SIZE 256
+#define MHEAP_GUARD_CHECKS_PER_CALL 4
+
 /* Without vector instructions don't bother with small object cache. */
 #if CLIB_VECTOR_WORD_BITS >= 128
 #define MHEAP_HAVE_SMALL_OBJECT_CACHE 1
@@ -162,10 +287,53 @@ typedef struct {
 #define MHEAP_FLAG_THREAD_SAFE			(1 << 2)
 #define MHEAP_FLAG_SMALL_OBJECT_CACHE		(1 << 3)
 #define MHEAP_FLAG_VALIDATE			(1 << 4)
+#define MHEAP_FLAG_MAGAZINES			(1 << 5)
+#define MHEAP_FLAG_REMOTE_FREE			(1 << 6)
+#define MHEAP_FLAG_HUGE_PAGES			(1 << 7)
+#define MHEAP_FLAG_SLAB				(1 << 8)
+#define MHEAP_FLAG_TRACE_SAMPLE			(1 << 9)
+  /* Arena: objects are bump allocated from end of heap and only
+     given back all at once by mheap_arena_reset.  Frees are ignored
+     except for last object in heap.  Pages stay mapped across resets. */
+#define MHEAP_FLAG_ARENA			(1 << 10)
+  /* Guard: canary after each object, quarantine of freed objects and
+     incremental checks of a few elements on each get and put. */
+#define MHEAP_FLAG_GUARD			(1 << 11)
+
+  /* Heap which was current when arena was pushed by clib_arena_push.
+     Objects outside of arena are assumed to be from this heap. */
+  void * arena_parent_heap;
 
   /* Lock use when MHEAP_FLAG_THREAD_SAFE is set. */
   clib_smp_lock_t * smp_lock;
 
+  /* Per-cpu magazines (MHEAP_FLAG_MAGAZINES) indexed by cpu number.
+     Allocated from heap itself when a cpu first allocates from heap;
+     null for cpus which never have. */
+  mheap_per_cpu_t ** per_cpu;
+  u32 n_per_cpu;
+
+  /* Slab pages with free slots for each size class (MHEAP_FLAG_SLAB);
+     ~0 means none. */
+  u32 slab_partial_pages[MHEAP_SLAB_N_CLASSES];
+  u32 n_slab_pages;
+  uword n_slab_objects;
+
+  /* Bit for each page sized chunk of heap: set if chunk is a slab.
+     Allocated from heap with first slab. */
+  uword * slab_page_bitmap;
+
+  /* Cpu which owns heap (MHEAP_FLAG_REMOTE_FREE). */
+  u32 owner_cpu;
+
+  /* Lock-free list of objects freed by cpus other than owner.  Pushed
+     by any cpu; drained by owner on its next allocation.  Objects are
+     linked through their first word.  Padded so that pushes by other
+     cpus do not share a cache line with the rest of the heap header. */
+  u8 remote_free_pad0[CLIB_CACHE_LINE_BYTES];
+  volatile uword remote_free_list;
+  u8 remote_free_pad1[CLIB_CACHE_LINE_BYTES - sizeof (uword)];
+
   /* Number of allocated objects. */
   uword n_elts;
 
@@ -176,6 +344,35 @@ typedef struct {
   uword vm_alloc_offset_from_header;
   uword vm_alloc_size;
 
+  /* Granularity at which heap memory is mapped and unmapped.
+     Huge page heaps (MHEAP_FLAG_HUGE_PAGES) stay mapped and give
+     free pages back to the kernel a huge page at a time. */
+  uword vm_page_size;
+
+  /* Huge pages are transparent huge pages (madvise) not hugetlbfs. */
+  u8 vm_huge_pages_are_transparent;
+
+  /* NUMA node heap pages are bound to or ~0 if not bound.
+     Pages are re-bound each time they are mapped. */
+  u32 numa_node;
+
+  /* Guard mode (MHEAP_FLAG_GUARD).  Canaries are secret xor'ed with
+     object offset.  Quarantine is a fifo of offsets of freed objects
+     allocated from heap itself.  Check offset is next element
+     for incremental checks. */
+  u64 guard_secret;
+  u32 * guard_quarantine;
+  u32 guard_quarantine_head, guard_n_quarantine;
+  u32 guard_check_uoffset;
+
+  /* Offset of object found corrupt; left for debugger. */
+  u32 guard_corrupt_uoffset;
+
+  /* Heap vector length before heap last shrank.  Pages between current
+     end of heap and here may still be resident (e.g. MHEAP_FLAG_DISABLE_VM
+     heaps and arenas never unmap); mheap_trim gives them back. */
+  uword trim_tail_end;
+
   /* Each successful mheap_validate call increments this serial number.
      Used to debug heap corruption problems.  GDB breakpoints can be
      made conditional on validate_serial. */
@@ -215,7 +412,13 @@ always_inline uword mheap_elt_data_bytes (mheap_elt_t * e)
 always_inline uword mheap_data_bytes (void * v, uword uo)
 {
   mheap_elt_t * e = mheap_elt_at_uoffset (v, uo);
-  return mheap_elt_data_bytes (e);
+  uword n_bytes = mheap_elt_data_bytes (e);
+
+  /* Canary is not part of user's object. */
+  if (PREDICT_FALSE (mheap_header (v)->flags & MHEAP_FLAG_GUARD))
+    n_bytes -= MHEAP_GUARD_CANARY_BYTES;
+
+  return n_bytes;
 }
 
 #define mheap_len(v,d) (mheap_data_bytes((v),(void *) (d) - (void *) (v)) / sizeof ((d)[0]))
@@ -234,6 +437,169 @@ always_inline mheap_elt_t * mheap_prev_elt (mheap_elt_t * e)
 	  - MHEAP_ELT_OVERHEAD_BYTES);
 }
 
+/* Small object bin for given size (same as mheap.c's bin for small sizes). */
+always_inline uword mheap_magazine_bin (uword n_user_data_bytes)
+{
+  n_user_data_bytes = clib_max (n_user_data_bytes, MHEAP_MIN_USER_DATA_BYTES);
+  return ((n_user_data_bytes + MHEAP_USER_DATA_WORD_BYTES - 1) / MHEAP_USER_DATA_WORD_BYTES
+	  - MHEAP_MIN_USER_DATA_BYTES / MHEAP_USER_DATA_WORD_BYTES);
+}
+
+/* Returns this cpu's magazines or null if heap has no magazines
+   (or they are disabled by tracing/validation). */
+always_inline mheap_per_cpu_t * mheap_magazines_for_cpu (void * v)
+{
+  mheap_t * h = mheap_header (v);
+  uword cpu;
+
+  if (PREDICT_FALSE ((h->flags & (MHEAP_FLAG_MAGAZINES
+				  | MHEAP_FLAG_TRACE
+				  | MHEAP_FLAG_VALIDATE))
+		     != MHEAP_FLAG_MAGAZINES))
+    return 0;
+
+  cpu = os_get_cpu_number ();
+  if (PREDICT_FALSE (! h->per_cpu || cpu >= h->n_per_cpu))
+    return 0;
+
+  return h->per_cpu[cpu];
+}
+
+always_inline uword mheap_trace_sample_filter_index (uword uoffset)
+{ return ((uoffset >> 3) ^ (uoffset >> 15)) & (MHEAP_TRACE_SAMPLE_FILTER_SIZE - 1); }
+
+/* Zero if object at given offset was certainly not sampled. */
+always_inline uword mheap_trace_maybe_sampled (mheap_t * h, uword uoffset)
+{
+  u8 * f = h->trace_main.sample_filter;
+  return f && f[mheap_trace_sample_filter_index (uoffset)] != 0;
+}
+
+/* Objects held on magazines are allocated as far as heap is concerned
+   so is_free does not catch a second free.  Instead first two user data
+   words (free list links of free objects) are marked while held. */
+#define MHEAP_MAGAZINE_HELD_MAGIC 0x6d61677a
+
+always_inline void
+mheap_magazine_set_held (void * v, uword uoffset, uword is_held)
+{
+  mheap_elt_t * e = mheap_elt_at_uoffset (v, uoffset);
+  e->free_elt.next_uoffset = is_held ? MHEAP_MAGAZINE_HELD_MAGIC : 0;
+  e->free_elt.prev_uoffset = is_held ? MHEAP_MAGAZINE_HELD_MAGIC ^ uoffset : 0;
+}
+
+always_inline uword
+mheap_magazine_is_held (void * v, uword uoffset)
+{
+  mheap_elt_t * e = mheap_elt_at_uoffset (v, uoffset);
+  return (e->free_elt.next_uoffset == MHEAP_MAGAZINE_HELD_MAGIC
+	  && e->free_elt.prev_uoffset == (MHEAP_MAGAZINE_HELD_MAGIC ^ uoffset));
+}
+
+/* Fast path allocation from this cpu's magazine.
+   Returns offset or ~0 when magazine is empty. */
+always_inline uword
+mheap_magazine_get (void * v, uword n_user_data_bytes, uword align, uword align_offset)
+{
+  mheap_per_cpu_t * pc;
+  mheap_magazine_t * m;
+  uword bin;
+
+  /* Magazine objects have minimum alignment and no alignment offset. */
+  if (! v
+      || align > MHEAP_USER_DATA_WORD_BYTES
+      || align_offset % MHEAP_USER_DATA_WORD_BYTES != 0)
+    return ~0;
+
+  /* Take slow path to drain objects freed by other cpus. */
+  if (PREDICT_FALSE (mheap_header (v)->remote_free_list != 0))
+    return ~0;
+
+  bin = mheap_magazine_bin (n_user_data_bytes);
+  if (bin >= MHEAP_N_MAGAZINE_BINS)
+    return ~0;
+
+  pc = mheap_magazines_for_cpu (v);
+  if (! pc)
+    return ~0;
+
+  m = pc->magazines + bin;
+  if (m->n_offsets == 0)
+    return ~0;
+
+  /* Leave allocation due to be sampled to slow path. */
+  if (PREDICT_FALSE (mheap_header (v)->flags & MHEAP_FLAG_TRACE_SAMPLE))
+    {
+      mheap_trace_main_t * tm = &mheap_header (v)->trace_main;
+      if (tm->bytes_until_sample <= (word) n_user_data_bytes)
+	return ~0;
+      tm->bytes_until_sample -= n_user_data_bytes;
+    }
+
+  pc->stats.n_magazine_hits += 1;
+  pc->stats.n_gets_by_log2_size[mheap_log2_bin (n_user_data_bytes, MHEAP_N_LOG2_SIZE_BINS)] += 1;
+  m->n_offsets -= 1;
+  mheap_magazine_set_held (v, m->offsets[m->n_offsets], 0);
+  return m->offsets[m->n_offsets];
+}
+
+/* Fast path free to this cpu's magazine.  Returns zero when object
+   does not belong on a magazine or magazine is full. */
+always_inline uword
+mheap_magazine_put (void * v, uword uoffset)
+{
+  mheap_per_cpu_t * pc;
+  mheap_magazine_t * m;
+  mheap_elt_t * e;
+  uword bin;
+
+  pc = mheap_magazines_for_cpu (v);
+  if (! pc)
+    return 0;
+
+  /* Sampled objects must be untraced by mheap_put. */
+  if (PREDICT_FALSE (mheap_trace_maybe_sampled (mheap_header (v), uoffset)))
+    return 0;
+
+  e = mheap_elt_at_uoffset (v, uoffset);
+
+  /* Let mheap_put catch double frees of objects on free lists. */
+  if (e->is_free)
+    return 0;
+
+  /* Double free of object already held on a magazine. */
+  if (PREDICT_FALSE (mheap_magazine_is_held (v, uoffset)))
+    os_panic ();
+
+  bin = mheap_magazine_bin (mheap_elt_data_bytes (e));
+  if (bin >= MHEAP_N_MAGAZINE_BINS)
+    return 0;
+
+  m = pc->magazines + bin;
+  if (m->n_offsets >= MHEAP_MAGAZINE_SIZE)
+    return 0;
+
+  mheap_magazine_set_held (v, uoffset, 1);
+  m->offsets[m->n_offsets] = uoffset;
+  m->n_offsets += 1;
+  return 1;
+}
+
+/* Free object from a cpu other than heap's owner (MHEAP_FLAG_REMOTE_FREE).
+   Object is pushed onto heap's remote free list without locking. */
+always_inline void
+mheap_put_remote (void * v, uword uoffset)
+{
+  mheap_t * h = mheap_header (v);
+  uword * p = v + uoffset;
+  uword old;
+
+  do {
+    old = h->remote_free_list;
+    p[0] = old;
+  } while (clib_smp_compare_and_swap (&h->remote_free_list, pointer_to_uword (p), old) != old);
+}
+
 /* Exported operations. */
 
 always_inline uword mheap_elts (void * v)
@@ -249,4 +615,7 @@ void mheap_put (void * v, uword offset);
 void * mheap_get_aligned (void * v, uword size, uword align, uword align_offset,
 			  uword * offset_return);
 
+/* Grow object in place.  Returns 0 if caller must allocate and copy. */
+uword mheap_realloc (void * v, uword offset, uword size);
+
 #endif /* included_mem_mheap_h */
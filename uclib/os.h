@@ -13,10 +13,24 @@ always_inline uword
 os_get_cpu_number (void)
 {
   u8 variable_on_stack;
-  uword offset = pointer_to_uword (&variable_on_stack) - pointer_to_uword (clib_smp_main.vm_base);
-  uword my_cpu = (offset >> clib_smp_main.log2_n_per_cpu_vm_bytes);
-  uword n_cpus = clib_smp_main.n_cpus;
-  return my_cpu < n_cpus ? my_cpu : n_cpus;
+  uword offset, my_cpu, n_cpus;
+
+  my_cpu = clib_smp_cpu_index_plus_one;
+  if (PREDICT_TRUE (my_cpu != 0))
+    return my_cpu - 1;
+
+  /* Before clib_smp_init there is only one heap. */
+  if (! clib_smp_main.vm_base)
+    return 0;
+
+  /* Threads on per-cpu stacks are found by stack address; all others
+     share main thread's index until they register. */
+  offset = pointer_to_uword (&variable_on_stack) - pointer_to_uword (clib_smp_main.vm_base);
+  my_cpu = (offset >> clib_smp_main.log2_n_per_cpu_vm_bytes);
+  n_cpus = clib_smp_main.n_cpus;
+  my_cpu = my_cpu < n_cpus ? my_cpu : n_cpus;
+  clib_smp_cpu_index_plus_one = my_cpu + 1;
+  return my_cpu;
 }
 
 #endif /* included_uclib_os_h */
@@ -0,0 +1,473 @@
+/*
+  Copyright (c) 2014 Eliot Dresselhaus
+
+  Permission is hereby granted, free of charge, to any person obtaining
+  a copy of this software and associated documentation files (the
+  "Software"), to deal in the Software without restriction, including
+  without limitation the rights to use, copy, modify, merge, publish,
+  distribute, sublicense, and/or sell copies of the Software, and to
+  permit persons to whom the Software is furnished to do so, subject to
+  the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+  LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+  WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+typedef struct {
+  u64 sum;
+
+  /* Key or offset in key_data as for slots. */
+  uword key;
+
+  uword value;
+} perfect_hash_build_key_t;
+
+/* Tries before giving up on a bucket and choosing new seed. */
+#define PERFECT_HASH_MAX_DISPLACEMENT (1 << 20)
+
+/* Average keys per bucket. */
+#define PERFECT_HASH_KEYS_PER_BUCKET 4
+
+static uword perfect_hash_add_key (clib_perfect_hash_t * ph, void * key, uword n_bytes)
+{
+  u8 * k;
+  u32 * l;
+
+  vec_add2 (ph->key_data, k, sizeof (l[0]) + round_pow2 (n_bytes, sizeof (l[0])));
+  l = (u32 *) k;
+  l[0] = n_bytes;
+  memcpy (l + 1, key, n_bytes);
+  return (u8 *) (l + 1) - ph->key_data;
+}
+
+always_inline u64
+perfect_hash_key_sum (clib_perfect_hash_t * ph, perfect_hash_build_key_t * k)
+{
+  u8 * d;
+
+  if (ph->key_type == CLIB_PERFECT_HASH_KEY_UWORD)
+    return clib_perfect_hash_sum_uword (ph, k->key);
+
+  d = ph->key_data + k->key;
+  return clib_perfect_hash_sum_mem (ph, d, ((u32 *) d)[-1]);
+}
+
+/* Returns 1 if displacements are found for all buckets with current seed. */
+static uword perfect_hash_try (clib_perfect_hash_t * ph, perfect_hash_build_key_t * keys)
+{
+  u32 n_keys = vec_len (keys), n_buckets = ph->n_buckets;
+  u32 * bucket_start = 0, * keys_by_bucket = 0, * buckets_by_size = 0, * size_start = 0;
+  u32 slots[64];
+  uword * occupied = 0;
+  uword i, j, b, d, n, max_size, free_slot, ok = 1;
+
+  vec_validate (bucket_start, n_buckets);
+  for (i = 0; i < n_keys; i++)
+    {
+      keys[i].sum = perfect_hash_key_sum (ph, &keys[i]);
+      bucket_start[clib_perfect_hash_bucket (ph, keys[i].sum)] += 1;
+    }
+
+  /* Counting sort keys by bucket. */
+  max_size = 0;
+  for (b = i = 0; b < n_buckets; b++)
+    {
+      n = bucket_start[b];
+      max_size = clib_max (max_size, n);
+      bucket_start[b] = i;
+      i += n;
+    }
+  bucket_start[n_buckets] = n_keys;
+
+  /* Hopeless: too many collisions for this seed. */
+  if (max_size > ARRAY_LEN (slots))
+    {
+      ok = 0;
+      goto done;
+    }
+
+  vec_validate (keys_by_bucket, n_keys - 1);
+  {
+    u32 * fill = vec_dup (bucket_start);
+    for (i = 0; i < n_keys; i++)
+      keys_by_bucket[fill[clib_perfect_hash_bucket (ph, keys[i].sum)]++] = i;
+    vec_free (fill);
+  }
+
+  /* Counting sort buckets by decreasing size. */
+  vec_validate (size_start, max_size + 1);
+  for (b = 0; b < n_buckets; b++)
+    size_start[max_size - (bucket_start[b + 1] - bucket_start[b])] += 1;
+  for (n = i = 0; n <= max_size; n++)
+    {
+      j = size_start[n];
+      size_start[n] = i;
+      i += j;
+    }
+  vec_validate (buckets_by_size, n_buckets - 1);
+  for (b = 0; b < n_buckets; b++)
+    buckets_by_size[size_start[max_size - (bucket_start[b + 1] - bucket_start[b])]++] = b;
+
+  clib_bitmap_alloc (occupied, n_keys);
+  vec_reset_length (ph->displacements);
+  vec_validate (ph->displacements, n_buckets - 1);
+
+  free_slot = 0;
+  for (i = 0; i < n_buckets; i++)
+    {
+      u32 * k;
+
+      b = buckets_by_size[i];
+      k = keys_by_bucket + bucket_start[b];
+      n = bucket_start[b + 1] - bucket_start[b];
+
+      if (n == 0)
+	continue;
+
+      /* Single key buckets take next free slot directly. */
+      if (n == 1)
+	{
+	  while (clib_bitmap_get_no_check (occupied, free_slot))
+	    free_slot++;
+	  occupied = clib_bitmap_set (occupied, free_slot, 1);
+	  ph->displacements[b] = CLIB_PERFECT_HASH_DIRECT | free_slot;
+	  continue;
+	}
+
+      for (d = 0; d < PERFECT_HASH_MAX_DISPLACEMENT; d++)
+	{
+	  for (j = 0; j < n; j++)
+	    {
+	      uword l;
+	      slots[j] = clib_perfect_hash_slot_index (keys[k[j]].sum, d, n_keys);
+	      if (clib_bitmap_get_no_check (occupied, slots[j]))
+		break;
+	      for (l = 0; l < j; l++)
+		if (slots[l] == slots[j])
+		  break;
+	      if (l < j)
+		break;
+	    }
+	  if (j >= n)
+	    break;
+	}
+
+      if (d >= PERFECT_HASH_MAX_DISPLACEMENT)
+	{
+	  ok = 0;
+	  goto done;
+	}
+
+      ph->displacements[b] = d;
+      for (j = 0; j < n; j++)
+	occupied = clib_bitmap_set (occupied, slots[j], 1);
+    }
+
+ done:
+  vec_free (bucket_start);
+  vec_free (keys_by_bucket);
+  vec_free (buckets_by_size);
+  vec_free (size_start);
+  clib_bitmap_free (occupied);
+  return ok;
+}
+
+static clib_error_t *
+perfect_hash_build (clib_perfect_hash_t * ph, perfect_hash_build_key_t * keys)
+{
+  clib_error_t * error = 0;
+  uword i, n_keys = vec_len (keys);
+  u32 seed = 1;
+
+  if (n_keys >= CLIB_PERFECT_HASH_DIRECT)
+    {
+      error = clib_error_return (0, "too many keys %wd", n_keys);
+      goto done;
+    }
+
+  if (n_keys == 0)
+    goto done;
+
+  ph->n_buckets = clib_max (1, n_keys / PERFECT_HASH_KEYS_PER_BUCKET);
+
+  for (i = 0; i < 16; i++)
+    {
+      ph->seed = random_u32 (&seed) | ((u64) random_u32 (&seed) << 32);
+      if (perfect_hash_try (ph, keys))
+	break;
+    }
+
+  if (i >= 16)
+    {
+      error = clib_error_return (0, "no perfect hash found for %wd keys", n_keys);
+      goto done;
+    }
+
+  vec_validate (ph->slots, n_keys - 1);
+  for (i = 0; i < n_keys; i++)
+    {
+      perfect_hash_build_key_t * k = keys + i;
+      u32 d = ph->displacements[clib_perfect_hash_bucket (ph, k->sum)];
+      clib_perfect_hash_slot_t * s = ph->slots + clib_perfect_hash_slot_index (k->sum, d, n_keys);
+      s->key = k->key;
+      s->value = k->value;
+    }
+
+ done:
+  vec_free (keys);
+  if (error)
+    clib_perfect_hash_free (ph);
+  return error;
+}
+
+clib_error_t * clib_perfect_hash_build_from_hash (clib_perfect_hash_t * ph, uword * hash)
+{
+  hash_t * h = hash_header (hash);
+  perfect_hash_build_key_t * keys = 0, * k;
+  hash_pair_t * p;
+  uword key_sum, value_bytes;
+
+  memset (ph, 0, sizeof (ph[0]));
+
+  if (! hash)
+    return 0;
+
+  value_bytes = hash_value_bytes (h);
+  if (value_bytes > sizeof (uword))
+    return clib_error_return (0, "values of %wd bytes are larger than a uword", value_bytes);
+
+  key_sum = pointer_to_uword (h->key_sum);
+  if (key_sum == KEY_FUNC_NONE)
+    ph->key_type = CLIB_PERFECT_HASH_KEY_UWORD;
+  else if (key_sum == KEY_FUNC_POINTER_UWORD || key_sum == KEY_FUNC_POINTER_U32)
+    {
+      ph->key_type = CLIB_PERFECT_HASH_KEY_FIXED;
+      ph->key_bytes = key_sum == KEY_FUNC_POINTER_U32 ? sizeof (u32) : sizeof (uword);
+    }
+  else if (key_sum == KEY_FUNC_STRING || key_sum == KEY_FUNC_STRING_WIDE)
+    ph->key_type = CLIB_PERFECT_HASH_KEY_C_STRING;
+  else if (key_sum == KEY_FUNC_MEM_WIDE || h->key_sum == mem_key_sum)
+    {
+      ph->key_type = CLIB_PERFECT_HASH_KEY_FIXED;
+      ph->key_bytes = h->user;
+    }
+  else if (key_sum == KEY_FUNC_VEC_WIDE || h->key_sum == vec_key_sum)
+    {
+      ph->key_type = CLIB_PERFECT_HASH_KEY_VEC;
+      ph->key_bytes = h->user;
+    }
+  else
+    return clib_error_return (0, "unsupported hash key function 0x%wx", key_sum);
+
+  hash_foreach_pair (p, hash, ({
+    void * m = uword_to_pointer (p->key, void *);
+
+    vec_add2 (keys, k, 1);
+    k->value = 0;
+    memcpy (&k->value, p->value, value_bytes);
+
+    switch (ph->key_type)
+      {
+      case CLIB_PERFECT_HASH_KEY_UWORD:
+	k->key = p->key;
+	break;
+      case CLIB_PERFECT_HASH_KEY_C_STRING:
+	k->key = perfect_hash_add_key (ph, m, strlen (m));
+	break;
+      case CLIB_PERFECT_HASH_KEY_VEC:
+	k->key = perfect_hash_add_key (ph, m, vec_len (m) * ph->key_bytes);
+	break;
+      default:
+	k->key = perfect_hash_add_key (ph, m, ph->key_bytes);
+	break;
+      }
+  }));
+
+  return perfect_hash_build (ph, keys);
+}
+
+clib_error_t * clib_perfect_hash_build_from_mhash (clib_perfect_hash_t * ph, mhash_t * mh)
+{
+  perfect_hash_build_key_t * keys = 0, * k;
+  uword value_bytes;
+  void * key;
+  uword * value;
+
+  memset (ph, 0, sizeof (ph[0]));
+
+  if (! mh->hash)
+    return 0;
+
+  value_bytes = mhash_value_bytes (mh);
+  if (value_bytes > sizeof (uword))
+    return clib_error_return (0, "values of %wd bytes are larger than a uword", value_bytes);
+
+  switch (mh->n_key_bytes)
+    {
+    case MHASH_C_STRING_KEY:
+      ph->key_type = CLIB_PERFECT_HASH_KEY_C_STRING;
+      break;
+    case MHASH_VEC_STRING_KEY:
+      ph->key_type = CLIB_PERFECT_HASH_KEY_VEC;
+      ph->key_bytes = 1;
+      break;
+    default:
+      ph->key_type = CLIB_PERFECT_HASH_KEY_FIXED;
+      ph->key_bytes = mh->n_key_bytes;
+      break;
+    }
+
+  mhash_foreach (key, value, mh, ({
+    uword n_bytes;
+
+    if (ph->key_type == CLIB_PERFECT_HASH_KEY_C_STRING)
+      n_bytes = strlen (key);
+    else if (ph->key_type == CLIB_PERFECT_HASH_KEY_VEC)
+      n_bytes = vec_len (key);
+    else
+      n_bytes = ph->key_bytes;
+
+    vec_add2 (keys, k, 1);
+    k->value = 0;
+    memcpy (&k->value, value, value_bytes);
+    k->key = perfect_hash_add_key (ph, key, n_bytes);
+  }));
+
+  return perfect_hash_build (ph, keys);
+}
+
+void clib_perfect_hash_free (clib_perfect_hash_t * ph)
+{
+  vec_free (ph->displacements);
+  vec_free (ph->slots);
+  vec_free (ph->key_data);
+  memset (ph, 0, sizeof (ph[0]));
+}
+
+void serialize_clib_perfect_hash (serialize_main_t * m, va_list * va)
+{
+  clib_perfect_hash_t * ph = va_arg (*va, clib_perfect_hash_t *);
+  clib_perfect_hash_slot_t * s;
+
+  serialize_integer (m, clib_arch_is_big_endian, sizeof (u8));
+  serialize_integer (m, ph->seed, sizeof (ph->seed));
+  serialize_integer (m, ph->n_buckets, sizeof (ph->n_buckets));
+  serialize_integer (m, ph->key_type, sizeof (u8));
+  serialize_integer (m, ph->key_bytes, sizeof (ph->key_bytes));
+  vec_serialize (m, ph->displacements, serialize_vec_32);
+
+  serialize_integer (m, vec_len (ph->slots), sizeof (u32));
+  vec_foreach (s, ph->slots)
+    {
+      serialize_integer (m, s->key, sizeof (u64));
+      serialize_integer (m, s->value, sizeof (u64));
+    }
+
+  vec_serialize (m, ph->key_data, serialize_vec_8);
+}
+
+/* Lookups trust displacements and key offsets: check them for tables
+   read from outside. */
+static clib_error_t * perfect_hash_validate (clib_perfect_hash_t * ph)
+{
+  clib_perfect_hash_slot_t * s;
+  uword n_slots = vec_len (ph->slots);
+  uword n_key_data = vec_len (ph->key_data);
+  u32 * d, n;
+
+  if (n_slots == 0)
+    return 0;
+
+  if (ph->n_buckets == 0 || vec_len (ph->displacements) != ph->n_buckets)
+    return clib_error_return (0, "perfect hash has %d displacements for %d buckets",
+			      vec_len (ph->displacements), ph->n_buckets);
+
+  vec_foreach (d, ph->displacements)
+    if ((d[0] & CLIB_PERFECT_HASH_DIRECT)
+	&& (d[0] &~ CLIB_PERFECT_HASH_DIRECT) >= n_slots)
+      return clib_error_return (0, "perfect hash bucket %d: slot index %d out of range (%d slots)",
+				d - ph->displacements, d[0] &~ CLIB_PERFECT_HASH_DIRECT, n_slots);
+
+  if (ph->key_type == CLIB_PERFECT_HASH_KEY_UWORD)
+    return 0;
+
+  vec_foreach (s, ph->slots)
+    {
+      if (s->key < sizeof (u32) || s->key % sizeof (u32) != 0 || s->key > n_key_data)
+	return clib_error_return (0, "perfect hash slot %d: key offset %wd out of range (%wd bytes)",
+				  s - ph->slots, s->key, n_key_data);
+      n = ((u32 *) (ph->key_data + s->key))[-1];
+      if (n > n_key_data - s->key)
+	return clib_error_return (0, "perfect hash slot %d: %d byte key at offset %wd out of range (%wd bytes)",
+				  s - ph->slots, n, s->key, n_key_data);
+    }
+
+  return 0;
+}
+
+void unserialize_clib_perfect_hash (serialize_main_t * m, va_list * va)
+{
+  clib_perfect_hash_t * ph = va_arg (*va, clib_perfect_hash_t *);
+  clib_perfect_hash_slot_t * s;
+  clib_error_t * error;
+  u8 is_big_endian, key_type;
+  u32 n_slots;
+  u64 x;
+
+  memset (ph, 0, sizeof (ph[0]));
+
+  /* Key sums depend on byte order. */
+  unserialize_integer (m, &is_big_endian, sizeof (u8));
+  if (is_big_endian != clib_arch_is_big_endian)
+    serialize_error_return (m, "perfect hash built with different byte order");
+
+  unserialize_integer (m, &ph->seed, sizeof (ph->seed));
+  unserialize_integer (m, &ph->n_buckets, sizeof (ph->n_buckets));
+  unserialize_integer (m, &key_type, sizeof (key_type));
+  if (key_type > CLIB_PERFECT_HASH_KEY_VEC)
+    serialize_error_return (m, "perfect hash has unknown key type %d", key_type);
+  ph->key_type = key_type;
+  unserialize_integer (m, &ph->key_bytes, sizeof (ph->key_bytes));
+  vec_unserialize (m, &ph->displacements, unserialize_vec_32);
+
+  unserialize_integer (m, &n_slots, sizeof (n_slots));
+  vec_resize (ph->slots, n_slots);
+  vec_foreach (s, ph->slots)
+    {
+      unserialize_integer (m, &x, sizeof (x));
+      s->key = x;
+      unserialize_integer (m, &x, sizeof (x));
+      s->value = x;
+    }
+
+  vec_unserialize (m, &ph->key_data, unserialize_vec_8);
+
+  if ((error = perfect_hash_validate (ph)))
+    {
+      clib_perfect_hash_free (ph);
+      serialize_error (&m->header, error);
+    }
+}
+
+u8 * format_clib_perfect_hash (u8 * s, va_list * va)
+{
+  clib_perfect_hash_t * ph = va_arg (*va, clib_perfect_hash_t *);
+  uword n_bytes;
+
+  n_bytes = (vec_bytes (ph->displacements) + vec_bytes (ph->slots)
+	     + vec_bytes (ph->key_data));
+
+  s = format (s, "perfect hash: %d keys, %d buckets, %wd bytes (%.2f per key)",
+	      vec_len (ph->slots), ph->n_buckets, n_bytes,
+	      (f64) n_bytes / clib_max (1, vec_len (ph->slots)));
+  return s;
+}
@@ -0,0 +1,193 @@
+/*
+  Copyright (c) 2014 Eliot Dresselhaus
+
+  Permission is hereby granted, free of charge, to any person obtaining
+  a copy of this software and associated documentation files (the
+  "Software"), to deal in the Software without restriction, including
+  without limitation the rights to use, copy, modify, merge, publish,
+  distribute, sublicense, and/or sell copies of the Software, and to
+  permit persons to whom the Software is furnished to do so, subject to
+  the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+  LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+  WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef included_clib_perfect_hash_h
+#define included_clib_perfect_hash_h
+
+/* Minimal perfect hash for tables that never change once built
+   (hash, displace and compress).
+
+   Keys are hashed to buckets of about 4 keys.  Each bucket has a
+   displacement d chosen at build time so that its keys land in distinct
+   free slots: slot = (f1 + d * f2) scaled to number of slots.  Buckets
+   with one key store their slot directly.  There is one slot per key:
+   lookup costs a displacement load plus one slot load (and one key
+   load for memory keys). */
+
+typedef struct {
+  /* Key itself for uword keys, otherwise byte offset of key in key_data. */
+  uword key;
+
+  uword value;
+} clib_perfect_hash_slot_t;
+
+typedef enum {
+  /* Keys are uwords compared by value (as with hash_create). */
+  CLIB_PERFECT_HASH_KEY_UWORD,
+  /* Keys are pointers to key_bytes bytes. */
+  CLIB_PERFECT_HASH_KEY_FIXED,
+  /* Keys are null terminated c strings. */
+  CLIB_PERFECT_HASH_KEY_C_STRING,
+  /* Keys are vectors with key_bytes bytes per element. */
+  CLIB_PERFECT_HASH_KEY_VEC,
+} clib_perfect_hash_key_type_t;
+
+typedef struct {
+  u64 seed;
+
+  /* Number of displacement buckets. */
+  u32 n_buckets;
+
+  /* A clib_perfect_hash_key_type_t. */
+  u32 key_type;
+
+  /* Fixed key size or bytes per vector element. */
+  u32 key_bytes;
+
+  /* Per bucket displacement; with high bit set it is slot index. */
+  u32 * displacements;
+#define CLIB_PERFECT_HASH_DIRECT (1 << 31)
+
+  /* One slot per key. */
+  clib_perfect_hash_slot_t * slots;
+
+  /* Memory keys each preceded by u32 length and padded to 4 bytes. */
+  u8 * key_data;
+} clib_perfect_hash_t;
+
+/* Build from hash table with uword values (or no values).  Supports
+   KEY_FUNC_* tables and hash_create_mem/vec tables.  Keys are copied
+   so table may be freed afterwards.  ph is overwritten: free any
+   previous table first. */
+clib_error_t * clib_perfect_hash_build_from_hash (clib_perfect_hash_t * ph, uword * hash);
+
+/* Build from mhash with values of at most one uword. */
+clib_error_t * clib_perfect_hash_build_from_mhash (clib_perfect_hash_t * ph, mhash_t * mh);
+
+void clib_perfect_hash_free (clib_perfect_hash_t * ph);
+
+/* Serialized tables can only be loaded on machines with the same
+   byte order as they were built on. */
+serialize_function_t serialize_clib_perfect_hash, unserialize_clib_perfect_hash;
+
+format_function_t format_clib_perfect_hash;
+
+always_inline uword
+clib_perfect_hash_elts (clib_perfect_hash_t * ph)
+{ return vec_len (ph->slots); }
+
+always_inline u64
+clib_perfect_hash_sum_uword (clib_perfect_hash_t * ph, uword key)
+{
+  u64 k = key;
+  return hash_memory_wide (&k, sizeof (k), ph->seed);
+}
+
+always_inline u64
+clib_perfect_hash_sum_mem (clib_perfect_hash_t * ph, void * key, uword n_bytes)
+{ return hash_memory_wide (key, n_bytes, ph->seed); }
+
+/* Scale 32 bit x to [0, n). */
+always_inline u32
+clib_perfect_hash_scale (u32 x, u32 n)
+{ return ((u64) x * n) >> 32; }
+
+always_inline u32
+clib_perfect_hash_bucket (clib_perfect_hash_t * ph, u64 sum)
+{ return clib_perfect_hash_scale (sum >> 32, ph->n_buckets); }
+
+/* Slot for key with given sum and bucket displacement. */
+always_inline u32
+clib_perfect_hash_slot_index (u64 sum, u32 d, u32 n_slots)
+{
+  u32 f1 = sum;
+  u32 f2 = ((sum * 0x9e3779b97f4a7c15ULL) >> 32) | 1;
+
+  if (d & CLIB_PERFECT_HASH_DIRECT)
+    return d &~ CLIB_PERFECT_HASH_DIRECT;
+  return clib_perfect_hash_scale (f1 + d * f2, n_slots);
+}
+
+always_inline clib_perfect_hash_slot_t *
+clib_perfect_hash_slot_for_sum (clib_perfect_hash_t * ph, u64 sum)
+{
+  u32 d = ph->displacements[clib_perfect_hash_bucket (ph, sum)];
+  return ph->slots + clib_perfect_hash_slot_index (sum, d, vec_len (ph->slots));
+}
+
+/* Fetch value for uword key; zero if not found. */
+always_inline uword *
+clib_perfect_hash_get (clib_perfect_hash_t * ph, uword key)
+{
+  clib_perfect_hash_slot_t * s;
+
+  ASSERT (ph->key_type == CLIB_PERFECT_HASH_KEY_UWORD);
+  if (vec_len (ph->slots) == 0)
+    return 0;
+
+  s = clib_perfect_hash_slot_for_sum (ph, clib_perfect_hash_sum_uword (ph, key));
+  return s->key == key ? &s->value : 0;
+}
+
+/* Fetch value for memory key of given size. */
+always_inline uword *
+clib_perfect_hash_get_bytes (clib_perfect_hash_t * ph, void * key, uword n_bytes)
+{
+  clib_perfect_hash_slot_t * s;
+  u8 * k;
+
+  ASSERT (ph->key_type != CLIB_PERFECT_HASH_KEY_UWORD);
+  if (vec_len (ph->slots) == 0)
+    return 0;
+
+  s = clib_perfect_hash_slot_for_sum (ph, clib_perfect_hash_sum_mem (ph, key, n_bytes));
+  k = ph->key_data + s->key;
+  if (((u32 *) k)[-1] != n_bytes || memcmp (k, key, n_bytes))
+    return 0;
+  return &s->value;
+}
+
+/* Fetch value for memory key with size given by table's key type. */
+always_inline uword *
+clib_perfect_hash_get_mem (clib_perfect_hash_t * ph, void * key)
+{
+  uword n_bytes;
+
+  switch (ph->key_type)
+    {
+    case CLIB_PERFECT_HASH_KEY_C_STRING:
+      n_bytes = strlen (key);
+      break;
+    case CLIB_PERFECT_HASH_KEY_VEC:
+      n_bytes = vec_len (key) * ph->key_bytes;
+      break;
+    default:
+      n_bytes = ph->key_bytes;
+      break;
+    }
+
+  return clib_perfect_hash_get_bytes (ph, key, n_bytes);
+}
+
+#endif /* included_clib_perfect_hash_h */
@@ -0,0 +1,90 @@
+/*
+  Copyright (c) 2014 Eliot Dresselhaus
+
+  Permission is hereby granted, free of charge, to any person obtaining
+  a copy of this software and associated documentation files (the
+  "Software"), to deal in the Software without restriction, including
+  without limitation the rights to use, copy, modify, merge, publish,
+  distribute, sublicense, and/or sell copies of the Software, and to
+  permit persons to whom the Software is furnished to do so, subject to
+  the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+  LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+  WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+void * _pool_compact (void * v, uword n_bytes_per_elt, uword align,
+		      u32 ** remap_return,
+		      pool_compact_function_t * f, void * f_arg)
+{
+  pool_header_t * p, * new_p;
+  void * new;
+  u32 * remap;
+  uword i, l, lo, hi, n_live;
+
+  if (! v)
+    {
+      if (remap_return)
+	vec_reset_length (*remap_return);
+      return v;
+    }
+
+  p = pool_header (v);
+  l = vec_len (v);
+  n_live = l - vec_len (p->free_indices);
+
+  remap = 0;
+  if (remap_return)
+    {
+      remap = *remap_return;
+      vec_reset_length (remap);
+      vec_resize (remap, l);
+      for (i = 0; i < l; i++)
+	remap[i] = clib_bitmap_get (p->free_bitmap, i) ? ~0 : i;
+    }
+
+  /* Fill holes below n_live lowest first with live elements from
+     top of pool.  Holes below n_live and live elements at or above it
+     come in equal numbers; other elements do not move. */
+  hi = l;
+  for (lo = clib_bitmap_next_set (p->free_bitmap, 0);
+       lo < n_live;
+       lo = clib_bitmap_next_set (p->free_bitmap, lo + 1))
+    {
+      do {
+	hi--;
+      } while (clib_bitmap_get (p->free_bitmap, hi));
+
+      ASSERT (hi >= n_live);
+      memcpy (v + lo*n_bytes_per_elt, v + hi*n_bytes_per_elt, n_bytes_per_elt);
+
+      if (remap)
+	remap[hi] = lo;
+      if (f)
+	f (f_arg, hi, lo);
+    }
+
+  /* Copy to exactly sized vector to give memory back. */
+  new = _vec_resize (0, n_live, 0, n_bytes_per_elt, sizeof (pool_header_t), align);
+  memcpy (new, v, n_live * n_bytes_per_elt);
+  new_p = pool_header (new);
+  new_p->flags = p->flags;
+
+  clib_bitmap_free (p->free_bitmap);
+  vec_free (p->free_indices);
+  vec_free_h (v, sizeof (pool_header_t));
+
+  if (remap_return)
+    *remap_return = remap;
+
+  return new;
+}
@@ -32,8 +32,14 @@ typedef struct {
   /* Bitmap of indices of free objects. */
   uword * free_bitmap;
 
-  /* Vector of free indices.  One element for each set bit in bitmap. */
+  /* Vector of free indices.  One element for each set bit in bitmap.
+     Binary min-heap with POOL_FLAG_ASCENDING. */
   u32 * free_indices;
+
+  u32 flags;
+  /* Hand out lowest free index first so that active elements stay
+     packed at start of pool after churn.  See pool_set_ascending. */
+#define POOL_FLAG_ASCENDING (1 << 0)
 } pool_header_t;
 
 /* Get pool header from user pool pointer */
@@ -114,6 +120,58 @@ pool_free_elts (void * v)
   return vec_len (p->free_indices);
 }
 
+/* Free index heap for POOL_FLAG_ASCENDING: smallest index is h[0]. */
+always_inline void
+pool_free_heap_sift_up (u32 * h, uword i)
+{
+  u32 x = h[i];
+
+  while (i > 0)
+    {
+      uword parent = (i - 1) / 2;
+      if (h[parent] <= x)
+	break;
+      h[i] = h[parent];
+      i = parent;
+    }
+  h[i] = x;
+}
+
+always_inline void
+pool_free_heap_sift_down (u32 * h, uword i, uword n)
+{
+  u32 x = h[i];
+
+  while (1)
+    {
+      uword c = 2*i + 1;
+      if (c >= n)
+	break;
+      c += c + 1 < n && h[c + 1] < h[c];
+      if (x <= h[c])
+	break;
+      h[i] = h[c];
+      i = c;
+    }
+  h[i] = x;
+}
+
+/* Remove smallest index from heap of N elements.  Callers already
+   know N, so it is not read again from the vector header. */
+always_inline u32
+pool_free_heap_pop (u32 * h, uword n)
+{
+  u32 min = h[0];
+
+  ASSERT (n > 0 && n == vec_len (h));
+  n--;
+  h[0] = h[n];
+  _vec_len (h) = n;
+  if (n > 0)
+    pool_free_heap_sift_down (h, 0, n);
+  return min;
+}
+
 always_inline void *
 pool_get_free_index_aligned (void * v, uword n_bytes_per_elt, uword align, uword * result)
 {
@@ -124,9 +182,14 @@ pool_get_free_index_aligned (void * v, uword n_bytes_per_elt, uword align, uword
   if (l > 0)
     {
       /* Return free element from free list. */
-      i = p->free_indices[l - 1];
+      if (p->flags & POOL_FLAG_ASCENDING)
+	i = pool_free_heap_pop (p->free_indices, l);
+      else
+	{
+	  i = p->free_indices[l - 1];
+	  _vec_len (p->free_indices) = l - 1;
+	}
       p->free_bitmap = clib_bitmap_andnoti (p->free_bitmap, i);
-      _vec_len (p->free_indices) = l - 1;
     }
   else
     {
@@ -175,6 +238,57 @@ do {									\
 
 #define pool_set_elt(P,E) pool_set_elt_aligned(P,E,0)
 
+/* Allocate N indices at once into RESULT (array of at least N u32s).
+   Free list is used first, then vector is grown once for the rest. */
+always_inline void *
+pool_get_free_indices_aligned (void * v, uword n_bytes_per_elt, uword align,
+			       u32 * result, uword n)
+{
+  pool_header_t * p = pool_header (v);
+  uword i, l, n_free;
+
+  l = v ? vec_len (p->free_indices) : 0;
+  n_free = clib_min (l, n);
+
+  if (n_free > 0)
+    {
+      if (p->flags & POOL_FLAG_ASCENDING)
+	for (i = 0; i < n_free; i++)
+	  result[i] = pool_free_heap_pop (p->free_indices, l - i);
+      else
+	{
+	  /* Same order as n calls to pool_get. */
+	  for (i = 0; i < n_free; i++)
+	    result[i] = p->free_indices[l - 1 - i];
+	  _vec_len (p->free_indices) = l - n_free;
+	}
+
+      /* Free bits are all within bitmap: trim it once at end. */
+      for (i = 0; i < n_free; i++)
+	clib_bitmap_set_no_check (p->free_bitmap, result[i], 0);
+      p->free_bitmap = _clib_bitmap_remove_trailing_zeros (p->free_bitmap);
+    }
+
+  if (n > n_free)
+    {
+      l = vec_len (v);
+      v = _vec_resize (v, n - n_free, l, n_bytes_per_elt,
+		       sizeof (pool_header_t), align);
+      for (i = n_free; i < n; i++)
+	result[i] = l + i - n_free;
+    }
+
+  return v;
+}
+
+/* Allocate N objects from pool P; their indices are stored in I. */
+#define pool_get_n_aligned(P,I,N,A)					\
+do {									\
+  (P) = pool_get_free_indices_aligned ((P), sizeof (P[0]), (A), (I), (N)); \
+} while (0)
+
+#define pool_get_n(P,I,N) pool_get_n_aligned(P,I,N,0)
+
 /* Use free bitmap to query whether given index is free */
 always_inline uword
 pool_is_free_index (void * v, uword i)
@@ -199,11 +313,76 @@ pool_put_index (void * v, uword i)
   ASSERT (! pool_is_free_index (v, i));
   p->free_bitmap = clib_bitmap_ori (p->free_bitmap, i);
   vec_add1 (p->free_indices, i);
+  if (p->flags & POOL_FLAG_ASCENDING)
+    pool_free_heap_sift_up (p->free_indices, vec_len (p->free_indices) - 1);
 }
 
 /* Free an object E in pool P */
 #define pool_put(P,E) pool_put_index ((P), (E) - (P))
 
+/* Free N pool elements with given indices. */
+always_inline void
+pool_put_indices (void * v, u32 * indices, uword n)
+{
+  pool_header_t * p = pool_header (v);
+  uword i, l, max_index, was_free;
+
+  if (n == 0)
+    return;
+
+  max_index = 0;
+  for (i = 0; i < n; i++)
+    {
+      ASSERT (indices[i] < vec_len (v));
+      max_index = clib_max (max_index, indices[i]);
+    }
+
+  /* Validate bitmap once, then set bits without checks. */
+  clib_bitmap_vec_validate (p->free_bitmap, max_index / BITS (uword));
+  for (i = 0; i < n; i++)
+    {
+      was_free = clib_bitmap_set_no_check (p->free_bitmap, indices[i], 1);
+      ASSERT (! was_free);
+    }
+
+  l = vec_len (p->free_indices);
+  vec_add (p->free_indices, indices, n);
+  if (p->flags & POOL_FLAG_ASCENDING)
+    for (i = l; i < l + n; i++)
+      pool_free_heap_sift_up (p->free_indices, i);
+}
+
+/* Free N objects in pool P with indices given by I. */
+#define pool_put_n(P,I,N) pool_put_indices ((P), (I), (N))
+
+/* Hand out free indices lowest first from now on (POOL_FLAG_ASCENDING).
+   Costs O(log free elements) per get and put instead of O(1).
+   Not saved by serialize_pool: set again after unserialize. */
+always_inline void *
+_pool_set_ascending (void * v, uword n_bytes_per_elt)
+{
+  pool_header_t * p;
+  word i, n;
+
+  /* Allocate header for empty pool. */
+  if (! v)
+    v = _vec_resize (v, 0, 0, n_bytes_per_elt, sizeof (pool_header_t), 0);
+
+  p = pool_header (v);
+  if (! (p->flags & POOL_FLAG_ASCENDING))
+    {
+      /* Make heap of existing free list. */
+      n = vec_len (p->free_indices);
+      for (i = n / 2 - 1; i >= 0; i--)
+	pool_free_heap_sift_down (p->free_indices, i, n);
+      p->flags |= POOL_FLAG_ASCENDING;
+    }
+
+  return v;
+}
+
+#define pool_set_ascending(P) (P) = _pool_set_ascending ((P), sizeof (P[0]))
+
 /* Allocate space for N more elements to pool (general version). */
 #define pool_alloc_aligned(P,N,A)					\
 do {									\
@@ -225,6 +404,32 @@ do {									\
 /* Allocate N more free elements to pool (unspecified alignment) */
 #define pool_alloc(P,N) pool_alloc_aligned(P,N,0)
 
+/* Called for each element moved by pool_compact. */
+typedef void (pool_compact_function_t) (void * arg, uword old_index, uword new_index);
+
+/* low-level compact pool operator (do not call directly) */
+void * _pool_compact (void * v, uword n_bytes_per_elt, uword align,
+		      u32 ** remap_return,
+		      pool_compact_function_t * f, void * f_arg);
+
+/* Move active elements down into free slots so that pool has no holes;
+   then shrink pool vector and free bitmap.  Active elements below
+   pool_elts (P) stay put.  If R is non-zero, *R is set to a vector
+   mapping old index to new index (~0 for indices that were free).
+   Callers must fix up stored indices and pointers into pool.  The
+   vector is copied, so even elements that do not move change address. */
+#define pool_compact_aligned(P,R,A) \
+  (P) = _pool_compact ((P), sizeof (P[0]), (A), (R), 0, 0)
+
+#define pool_compact(P,R) pool_compact_aligned(P,R,0)
+
+/* As above but call F (ARG, OLD_INDEX, NEW_INDEX) for each moved element. */
+#define pool_compact_with_function_aligned(P,F,ARG,A) \
+  (P) = _pool_compact ((P), sizeof (P[0]), (A), 0, (F), (ARG))
+
+#define pool_compact_with_function(P,F,ARG) \
+  pool_compact_with_function_aligned(P,F,ARG,0)
+
 /* low-level free pool operator (do not call directly) */
 always_inline void * _pool_free (void * v)
 {
@@ -0,0 +1,283 @@
+/*
+  Copyright (c) 2014 Eliot Dresselhaus
+
+  Permission is hereby granted, free of charge, to any person obtaining
+  a copy of this software and associated documentation files (the
+  "Software"), to deal in the Software without restriction, including
+  without limitation the rights to use, copy, modify, merge, publish,
+  distribute, sublicense, and/or sell copies of the Software, and to
+  permit persons to whom the Software is furnished to do so, subject to
+  the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+  LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+  WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+static clib_rcu_hash_table_t *
+rcu_hash_table_alloc (uword n_buckets)
+{
+  clib_rcu_hash_table_t * t;
+  uword n_bytes;
+
+  n_buckets = max_pow2 (clib_max (n_buckets, 4));
+  n_bytes = sizeof (t[0]) + n_buckets * sizeof (t->buckets[0]);
+  t = clib_mem_alloc_aligned (n_bytes, CLIB_CACHE_LINE_BYTES);
+  memset (t, 0, n_bytes);
+  t->bucket_mask = n_buckets - 1;
+  return t;
+}
+
+always_inline clib_rcu_hash_node_t * volatile *
+rcu_hash_bucket (clib_rcu_hash_t * h, clib_rcu_hash_table_t * t, uword key)
+{ return t->buckets + (key_sum (&h->key_funcs, key) & t->bucket_mask); }
+
+void clib_rcu_hash_init (clib_rcu_hash_t * h, uword n_elts,
+			 hash_key_sum_function_t * key_sum,
+			 hash_key_equal_function_t * key_equal,
+			 uword user)
+{
+  clib_smp_main_t * m = &clib_smp_main;
+  uword n_readers;
+
+  memset (h, 0, sizeof (h[0]));
+
+  h->key_funcs.key_sum = key_sum;
+  h->key_funcs.key_equal = key_equal;
+  h->key_funcs.user = user;
+
+  h->table = rcu_hash_table_alloc (n_elts);
+  h->epoch = 1;
+
+  /* One reader slot per cpu index (as for clib_smp_lock_init). */
+  n_readers = m->n_cpus < 2 ? 1 : clib_smp_n_thread_slots (m);
+  vec_validate_aligned (h->readers, n_readers - 1, CLIB_CACHE_LINE_BYTES);
+
+  clib_smp_lock_init (&h->writer_lock);
+}
+
+static void rcu_hash_free_nodes (clib_rcu_hash_table_t * t)
+{
+  clib_rcu_hash_node_t * n, * next;
+  uword i;
+
+  for (i = 0; i <= t->bucket_mask; i++)
+    for (n = t->buckets[i]; n; n = next)
+      {
+	next = n->next;
+	clib_mem_free (n);
+      }
+}
+
+void clib_rcu_hash_free (clib_rcu_hash_t * h)
+{
+  clib_rcu_hash_retired_t * r;
+
+  vec_foreach (r, h->retired)
+    clib_mem_free (r->object);
+  vec_free (h->retired);
+
+  if (h->table)
+    {
+      rcu_hash_free_nodes (h->table);
+      clib_mem_free (h->table);
+    }
+
+  vec_free (h->readers);
+  clib_smp_lock_free (&h->writer_lock);
+  memset (h, 0, sizeof (h[0]));
+}
+
+void clib_rcu_hash_reclaim (clib_rcu_hash_t * h)
+{
+  clib_rcu_hash_reader_t * rd;
+  clib_rcu_hash_retired_t * r;
+  uword i, min_epoch, n_left;
+
+  if (vec_len (h->retired) == 0)
+    return;
+
+  /* Unlinks must be visible before readers can see new epoch. */
+  CLIB_MEMORY_BARRIER ();
+  h->epoch += 1;
+  CLIB_MEMORY_BARRIER ();
+
+  /* Readers with epoch after retirement entered after object was unlinked. */
+  min_epoch = h->epoch;
+  vec_foreach (rd, h->readers)
+    {
+      uword e = rd->epoch;
+      if (e != 0 && e < min_epoch)
+	min_epoch = e;
+    }
+
+  n_left = 0;
+  for (i = 0; i < vec_len (h->retired); i++)
+    {
+      r = vec_elt_at_index (h->retired, i);
+      if (r->epoch < min_epoch)
+	clib_mem_free (r->object);
+      else
+	h->retired[n_left++] = r[0];
+    }
+  _vec_len (h->retired) = n_left;
+  h->n_retired_after_reclaim = n_left;
+}
+
+always_inline void
+rcu_hash_retire_no_reclaim (clib_rcu_hash_t * h, void * object)
+{
+  clib_rcu_hash_retired_t * r;
+
+  vec_add2 (h->retired, r, 1);
+  r->object = object;
+  r->epoch = h->epoch;
+}
+
+void clib_rcu_hash_retire (clib_rcu_hash_t * h, void * object)
+{
+  rcu_hash_retire_no_reclaim (h, object);
+  if (vec_len (h->retired) >= h->n_retired_after_reclaim + CLIB_RCU_HASH_RECLAIM_THRESHOLD)
+    clib_rcu_hash_reclaim (h);
+}
+
+/* Copy nodes into a table twice as large.  Readers keep walking the old
+   table (which is never modified) until they exit. */
+static void rcu_hash_resize (clib_rcu_hash_t * h)
+{
+  clib_rcu_hash_table_t * old = h->table, * new;
+  clib_rcu_hash_node_t * n, * m, * volatile * b;
+  uword i;
+
+  new = rcu_hash_table_alloc (2 * (old->bucket_mask + 1));
+
+  for (i = 0; i <= old->bucket_mask; i++)
+    for (n = old->buckets[i]; n; n = n->next)
+      {
+	m = clib_mem_alloc (sizeof (m[0]));
+	m->key = n->key;
+	m->value = n->value;
+	b = rcu_hash_bucket (h, new, n->key);
+	m->next = b[0];
+	b[0] = m;
+	/* Old nodes are still reachable: no reclaim until table is replaced. */
+	rcu_hash_retire_no_reclaim (h, n);
+      }
+
+  /* Nodes must be complete before table is published. */
+  CLIB_MEMORY_BARRIER ();
+  h->table = new;
+  clib_rcu_hash_retire (h, old);
+}
+
+uword * clib_rcu_hash_get (clib_rcu_hash_t * h, uword key)
+{
+  clib_rcu_hash_table_t * t = h->table;
+  clib_rcu_hash_node_t * n;
+
+  for (n = rcu_hash_bucket (h, t, key)[0]; n; n = n->next)
+    if (key_equal (&h->key_funcs, n->key, key))
+      return &n->value;
+
+  return 0;
+}
+
+uword clib_rcu_hash_set (clib_rcu_hash_t * h, uword key, uword value, uword * old_value)
+{
+  clib_rcu_hash_table_t * t;
+  clib_rcu_hash_node_t * n, * m, * volatile * b, * volatile * prev;
+  uword found = 0;
+
+  clib_smp_lock (h->writer_lock);
+
+  t = h->table;
+  b = rcu_hash_bucket (h, t, key);
+
+  for (prev = b; (n = prev[0]); prev = &n->next)
+    if (key_equal (&h->key_funcs, n->key, key))
+      break;
+
+  m = clib_mem_alloc (sizeof (m[0]));
+  m->key = key;
+  m->value = value;
+
+  if (n)
+    {
+      /* Replace node so readers never see a partially updated value. */
+      found = 1;
+      if (old_value)
+	old_value[0] = n->value;
+      m->next = n->next;
+      CLIB_MEMORY_BARRIER ();
+      prev[0] = m;
+      clib_rcu_hash_retire (h, n);
+    }
+  else
+    {
+      m->next = b[0];
+      CLIB_MEMORY_BARRIER ();
+      b[0] = m;
+      h->elts += 1;
+      if (h->elts > 2 * (t->bucket_mask + 1))
+	rcu_hash_resize (h);
+    }
+
+  clib_smp_unlock (h->writer_lock);
+
+  return found;
+}
+
+uword clib_rcu_hash_unset (clib_rcu_hash_t * h, uword key, uword * old_value)
+{
+  clib_rcu_hash_node_t * n, * volatile * prev;
+  uword found = 0;
+
+  clib_smp_lock (h->writer_lock);
+
+  for (prev = rcu_hash_bucket (h, h->table, key); (n = prev[0]); prev = &n->next)
+    if (key_equal (&h->key_funcs, n->key, key))
+      break;
+
+  if (n)
+    {
+      found = 1;
+      if (old_value)
+	old_value[0] = n->value;
+      /* Readers already on n still see the rest of the chain through n->next. */
+      prev[0] = n->next;
+      h->elts -= 1;
+      clib_rcu_hash_retire (h, n);
+    }
+
+  clib_smp_unlock (h->writer_lock);
+
+  return found;
+}
+
+u8 * format_clib_rcu_hash (u8 * s, va_list * va)
+{
+  clib_rcu_hash_t * h = va_arg (*va, clib_rcu_hash_t *);
+  clib_rcu_hash_table_t * t = h->table;
+  clib_rcu_hash_node_t * n;
+  uword i, l, max_len = 0, n_used = 0;
+
+  for (i = 0; i <= t->bucket_mask; i++)
+    {
+      for (l = 0, n = t->buckets[i]; n; n = n->next)
+	l++;
+      n_used += l > 0;
+      max_len = clib_max (max_len, l);
+    }
+
+  s = format (s, "rcu hash: %wd elts, %wd buckets (%wd used, longest chain %wd), epoch %wd, %d retired",
+	      h->elts, t->bucket_mask + 1, n_used, max_len, h->epoch, vec_len (h->retired));
+  return s;
+}
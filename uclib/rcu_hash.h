@@ -0,0 +1,149 @@
+/*
+  Copyright (c) 2014 Eliot Dresselhaus
+
+  Permission is hereby granted, free of charge, to any person obtaining
+  a copy of this software and associated documentation files (the
+  "Software"), to deal in the Software without restriction, including
+  without limitation the rights to use, copy, modify, merge, publish,
+  distribute, sublicense, and/or sell copies of the Software, and to
+  permit persons to whom the Software is furnished to do so, subject to
+  the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+  LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+  WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef included_clib_rcu_hash_h
+#define included_clib_rcu_hash_h
+
+/* Concurrent hash table for read mostly data shared between cpus.
+
+   Readers take no locks and write only to their own cpu's cache line:
+     clib_rcu_hash_reader_enter (h);
+     p = clib_rcu_hash_get (h, key);
+     ... use p[0] ...
+     clib_rcu_hash_reader_exit (h);
+   Value pointers are valid until reader exits.  Readers must not nest
+   and must run with distinct cpu indices (os_get_cpu_number).
+
+   Writers (set, unset) are serialized by a lock.  Nodes are never
+   modified once visible to readers: set and unset link in new nodes
+   and retire old ones.  Retired memory is freed with clib_mem_free
+   (on whichever per-cpu heap it came from) once every reader active
+   when it was retired has exited.  Epochs tell which readers those are.
+
+   Keys are uwords with hash.c key_sum/key_equal functions (or KEY_FUNC_*). */
+
+typedef struct clib_rcu_hash_node {
+  struct clib_rcu_hash_node * volatile next;
+  uword key;
+  uword value;
+} clib_rcu_hash_node_t;
+
+typedef struct {
+  /* Number of buckets minus one (power of 2 buckets). */
+  uword bucket_mask;
+
+  clib_rcu_hash_node_t * volatile buckets[0];
+} clib_rcu_hash_table_t;
+
+typedef struct {
+  /* Global epoch when reader entered or zero when not reading. */
+  volatile uword epoch;
+} __attribute__ ((aligned (CLIB_CACHE_LINE_BYTES))) clib_rcu_hash_reader_t;
+
+typedef struct {
+  void * object;
+
+  /* Global epoch when object was retired. */
+  uword epoch;
+} clib_rcu_hash_retired_t;
+
+typedef struct {
+  /* Current table; replaced (not modified in place) on resize. */
+  clib_rcu_hash_table_t * volatile table;
+
+  /* Global epoch; starts at 1 since 0 means reader is idle.
+     Only advanced by writers. */
+  volatile uword epoch;
+
+  /* Number of keys in table. */
+  uword elts;
+
+  /* Per cpu reader state indexed by cpu index. */
+  clib_rcu_hash_reader_t * readers;
+
+  /* Memory waiting for readers to exit. */
+  clib_rcu_hash_retired_t * retired;
+
+  /* Retired objects still in use after last reclaim. */
+  uword n_retired_after_reclaim;
+
+  /* Serializes writers. */
+  clib_smp_lock_t * writer_lock;
+
+  /* Key sum/equal functions and user data as for hash_create2.
+     Other fields are not used. */
+  hash_t key_funcs;
+} clib_rcu_hash_t;
+
+/* Reclaim retired memory once this many objects have been retired
+   since last reclaim. */
+#define CLIB_RCU_HASH_RECLAIM_THRESHOLD 64
+
+void clib_rcu_hash_init (clib_rcu_hash_t * h, uword n_elts,
+			 hash_key_sum_function_t * key_sum,
+			 hash_key_equal_function_t * key_equal,
+			 uword user);
+
+/* Free table.  There must be no active readers. */
+void clib_rcu_hash_free (clib_rcu_hash_t * h);
+
+/* Writers.  Return 1 and copy previous value to old_value (if non-zero)
+   if key was in table. */
+uword clib_rcu_hash_set (clib_rcu_hash_t * h, uword key, uword value, uword * old_value);
+uword clib_rcu_hash_unset (clib_rcu_hash_t * h, uword key, uword * old_value);
+
+/* Free object with clib_mem_free after all current readers exit.
+   E.g. memory of a pointer key after unset.  Must be called by a writer
+   (under writer lock) or with no concurrent writers. */
+void clib_rcu_hash_retire (clib_rcu_hash_t * h, void * object);
+
+/* Advance epoch and free retired memory no reader can still see. */
+void clib_rcu_hash_reclaim (clib_rcu_hash_t * h);
+
+/* Fetch value of key; zero if not found.  Call between reader enter/exit. */
+uword * clib_rcu_hash_get (clib_rcu_hash_t * h, uword key);
+
+format_function_t format_clib_rcu_hash;
+
+always_inline uword clib_rcu_hash_elts (clib_rcu_hash_t * h)
+{ return h->elts; }
+
+always_inline void clib_rcu_hash_reader_enter (clib_rcu_hash_t * h)
+{
+  clib_rcu_hash_reader_t * r = vec_elt_at_index (h->readers, os_get_cpu_number ());
+  ASSERT (r->epoch == 0);
+  r->epoch = h->epoch;
+  /* Epoch must be visible to writers before we load any node pointers. */
+  CLIB_MEMORY_BARRIER ();
+}
+
+always_inline void clib_rcu_hash_reader_exit (clib_rcu_hash_t * h)
+{
+  clib_rcu_hash_reader_t * r = vec_elt_at_index (h->readers, os_get_cpu_number ());
+  /* Finish all reads of nodes before marking reader idle. */
+  CLIB_MEMORY_BARRIER ();
+  r->epoch = 0;
+}
+
+#endif /* included_clib_rcu_hash_h */
@@ -0,0 +1,70 @@
+/*
+  Copyright (c) 2014 Eliot Dresselhaus
+
+  Permission is hereby granted, free of charge, to any person obtaining
+  a copy of this software and associated documentation files (the
+  "Software"), to deal in the Software without restriction, including
+  without limitation the rights to use, copy, modify, merge, publish,
+  distribute, sublicense, and/or sell copies of the Software, and to
+  permit persons to whom the Software is furnished to do so, subject to
+  the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+  LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+  WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+void clib_spsc_ring_init (clib_spsc_ring_t ** pr, uword n_elts)
+{
+  clib_spsc_ring_t * r;
+
+  n_elts = max_pow2 (clib_max (n_elts, 2));
+  r = clib_mem_alloc_aligned (sizeof (r[0]) + n_elts * sizeof (r->elts[0]),
+			      CLIB_CACHE_LINE_BYTES);
+  memset (r, 0, sizeof (r[0]));
+  r->mask = n_elts - 1;
+  *pr = r;
+}
+
+void clib_spsc_ring_free (clib_spsc_ring_t ** pr)
+{
+  if (*pr)
+    clib_mem_free (*pr);
+  *pr = 0;
+}
+
+void clib_mpmc_ring_init (clib_mpmc_ring_t ** pr, uword n_elts)
+{
+  clib_mpmc_ring_t * r;
+  uword i;
+
+  n_elts = max_pow2 (clib_max (n_elts, 2));
+  r = clib_mem_alloc_aligned (sizeof (r[0]) + n_elts * sizeof (r->slots[0]),
+			      CLIB_CACHE_LINE_BYTES);
+  memset (r, 0, sizeof (r[0]));
+  r->mask = n_elts - 1;
+
+  /* All slots writable for first lap. */
+  for (i = 0; i < n_elts; i++)
+    {
+      r->slots[i].sequence = i;
+      r->slots[i].data = 0;
+    }
+
+  *pr = r;
+}
+
+void clib_mpmc_ring_free (clib_mpmc_ring_t ** pr)
+{
+  if (*pr)
+    clib_mem_free (*pr);
+  *pr = 0;
+}
@@ -0,0 +1,270 @@
+/*
+  Copyright (c) 2014 Eliot Dresselhaus
+
+  Permission is hereby granted, free of charge, to any person obtaining
+  a copy of this software and associated documentation files (the
+  "Software"), to deal in the Software without restriction, including
+  without limitation the rights to use, copy, modify, merge, publish,
+  distribute, sublicense, and/or sell copies of the Software, and to
+  permit persons to whom the Software is furnished to do so, subject to
+  the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+  LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+  WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef included_clib_ring_h
+#define included_clib_ring_h
+
+/* Bounded lock-free rings of uwords (pointers, pool indices, ...) for
+   passing work between cpus.  Unlike clib_fifo they never grow: size is
+   fixed at init (rounded up to a power of 2).
+
+   clib_spsc_ring_t has one producer cpu and one consumer cpu.
+   clib_mpmc_ring_t allows any number of each (Vyukov's bounded queue:
+   each slot has a sequence number telling whether it may be written
+   or read in current lap around ring).
+
+   Producer and consumer indices live on separate cache lines.
+   Indices count up forever; index & mask gives slot.
+
+   The _n functions move as many elements as they can (at most n) and
+   return number moved.  Single element versions return 1 on success and
+   0 when ring is full (enqueue) or empty (dequeue). */
+
+typedef struct {
+  /* Next index to enqueue.  Written by producer only. */
+  volatile uword head;
+
+  /* Producer's copy of tail; re-read only when ring looks full. */
+  uword producer_tail;
+
+  u8 pad0[CLIB_CACHE_LINE_BYTES - 2 * sizeof (uword)];
+
+  /* Next index to dequeue.  Written by consumer only. */
+  volatile uword tail;
+
+  /* Consumer's copy of head; re-read only when ring looks empty. */
+  uword consumer_head;
+
+  u8 pad1[CLIB_CACHE_LINE_BYTES - 2 * sizeof (uword)];
+
+  /* Number of slots minus one. */
+  uword mask;
+
+  u8 pad2[CLIB_CACHE_LINE_BYTES - 1 * sizeof (uword)];
+
+  uword elts[0];
+} clib_spsc_ring_t;
+
+typedef struct {
+  /* Equal to index when slot may be written for index;
+     index + 1 when it may be read. */
+  volatile uword sequence;
+
+  uword data;
+} clib_mpmc_ring_slot_t;
+
+typedef struct {
+  /* Next index to enqueue.  Claimed by producers with compare and swap. */
+  volatile uword head;
+
+  u8 pad0[CLIB_CACHE_LINE_BYTES - 1 * sizeof (uword)];
+
+  /* Next index to dequeue.  Claimed by consumers with compare and swap. */
+  volatile uword tail;
+
+  u8 pad1[CLIB_CACHE_LINE_BYTES - 1 * sizeof (uword)];
+
+  /* Number of slots minus one. */
+  uword mask;
+
+  u8 pad2[CLIB_CACHE_LINE_BYTES - 1 * sizeof (uword)];
+
+  clib_mpmc_ring_slot_t slots[0];
+} clib_mpmc_ring_t;
+
+/* Allocate ring with at least n_elts slots from current heap. */
+void clib_spsc_ring_init (clib_spsc_ring_t ** r, uword n_elts);
+void clib_spsc_ring_free (clib_spsc_ring_t ** r);
+void clib_mpmc_ring_init (clib_mpmc_ring_t ** r, uword n_elts);
+void clib_mpmc_ring_free (clib_mpmc_ring_t ** r);
+
+always_inline uword
+clib_spsc_ring_enqueue_n (clib_spsc_ring_t * r, uword * elts, uword n_elts)
+{
+  uword h = r->head, n_free, i;
+
+  n_free = r->mask + 1 - (h - r->producer_tail);
+  if (n_free < n_elts)
+    {
+      /* Acquire: consumer is done reading slots before tail. */
+      r->producer_tail = clib_smp_load_acquire (&r->tail);
+      n_free = r->mask + 1 - (h - r->producer_tail);
+      n_elts = clib_min (n_elts, n_free);
+      if (n_elts == 0)
+	return 0;
+    }
+
+  for (i = 0; i < n_elts; i++)
+    r->elts[(h + i) & r->mask] = elts[i];
+
+  clib_smp_store_release (&r->head, h + n_elts);
+  return n_elts;
+}
+
+always_inline uword
+clib_spsc_ring_dequeue_n (clib_spsc_ring_t * r, uword * elts, uword n_elts)
+{
+  uword t = r->tail, n_used, i;
+
+  n_used = r->consumer_head - t;
+  if (n_used < n_elts)
+    {
+      r->consumer_head = clib_smp_load_acquire (&r->head);
+      n_used = r->consumer_head - t;
+      n_elts = clib_min (n_elts, n_used);
+      if (n_elts == 0)
+	return 0;
+    }
+
+  for (i = 0; i < n_elts; i++)
+    elts[i] = r->elts[(t + i) & r->mask];
+
+  clib_smp_store_release (&r->tail, t + n_elts);
+  return n_elts;
+}
+
+always_inline uword
+clib_spsc_ring_enqueue (clib_spsc_ring_t * r, uword x)
+{ return clib_spsc_ring_enqueue_n (r, &x, 1); }
+
+always_inline uword
+clib_spsc_ring_dequeue (clib_spsc_ring_t * r, uword * x)
+{ return clib_spsc_ring_dequeue_n (r, x, 1); }
+
+/* Number of elements in ring; only a snapshot when other cpus are active. */
+always_inline uword
+clib_spsc_ring_elts (clib_spsc_ring_t * r)
+{
+  /* Read tail first so result can't underflow. */
+  uword t = r->tail;
+  return r->head - t;
+}
+
+always_inline uword
+clib_mpmc_ring_enqueue_n (clib_mpmc_ring_t * r, uword * elts, uword n_elts)
+{
+  clib_mpmc_ring_slot_t * s;
+  uword h, h1, i, n;
+
+  h = r->head;
+  while (1)
+    {
+      /* Count slots writable for this lap starting at h.  Writable slots
+	 stay writable until head moves past them. */
+      for (n = 0; n < n_elts; n++)
+	{
+	  s = r->slots + ((h + n) & r->mask);
+	  if (clib_smp_load_acquire (&s->sequence) != h + n)
+	    break;
+	}
+
+      if (n == 0)
+	{
+	  /* Full unless another producer has moved head. */
+	  h1 = r->head;
+	  if (h1 == h)
+	    return 0;
+	  h = h1;
+	  continue;
+	}
+
+      h1 = clib_smp_compare_and_swap (&r->head, h + n, h);
+      if (h1 == h)
+	break;
+
+      h = h1;
+      clib_smp_pause ();
+    }
+
+  for (i = 0; i < n; i++)
+    {
+      s = r->slots + ((h + i) & r->mask);
+      s->data = elts[i];
+      clib_smp_store_release (&s->sequence, h + i + 1);
+    }
+
+  return n;
+}
+
+always_inline uword
+clib_mpmc_ring_dequeue_n (clib_mpmc_ring_t * r, uword * elts, uword n_elts)
+{
+  clib_mpmc_ring_slot_t * s;
+  uword t, t1, i, n;
+
+  t = r->tail;
+  while (1)
+    {
+      for (n = 0; n < n_elts; n++)
+	{
+	  s = r->slots + ((t + n) & r->mask);
+	  if (clib_smp_load_acquire (&s->sequence) != t + n + 1)
+	    break;
+	}
+
+      if (n == 0)
+	{
+	  /* Empty unless another consumer has moved tail. */
+	  t1 = r->tail;
+	  if (t1 == t)
+	    return 0;
+	  t = t1;
+	  continue;
+	}
+
+      t1 = clib_smp_compare_and_swap (&r->tail, t + n, t);
+      if (t1 == t)
+	break;
+
+      t = t1;
+      clib_smp_pause ();
+    }
+
+  for (i = 0; i < n; i++)
+    {
+      s = r->slots + ((t + i) & r->mask);
+      elts[i] = s->data;
+      /* Slot is writable again for index one lap ahead. */
+      clib_smp_store_release (&s->sequence, t + i + r->mask + 1);
+    }
+
+  return n;
+}
+
+always_inline uword
+clib_mpmc_ring_enqueue (clib_mpmc_ring_t * r, uword x)
+{ return clib_mpmc_ring_enqueue_n (r, &x, 1); }
+
+always_inline uword
+clib_mpmc_ring_dequeue (clib_mpmc_ring_t * r, uword * x)
+{ return clib_mpmc_ring_dequeue_n (r, x, 1); }
+
+always_inline uword
+clib_mpmc_ring_elts (clib_mpmc_ring_t * r)
+{
+  uword t = r->tail;
+  return r->head - t;
+}
+
+#endif /* included_clib_ring_h */
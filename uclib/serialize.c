@@ -262,7 +262,9 @@ unserialize_vector_ha (serialize_main_t * m,
   if (l == 0)
     return 0;
 
-  p = v = _vec_resize (0, l, 0, elt_bytes, header_bytes, align);
+  /* Every element is unserialized below: skip zeroing. */
+  p = v = _vec_resize_with_flags (0, l, 0, elt_bytes, header_bytes, align,
+				  VEC_RESIZE_NO_ZERO);
 
   while (l != 0)
     {
@@ -824,6 +826,8 @@ static void * serialize_write_not_inline (serialize_main_header_t * m,
   if (n_left_o > 0 || n_left_b < n_bytes_to_write)
     {
       u8 * r;
+      /* Keep overflow bytes already copied into buffer above. */
+      s->current_buffer_index = cur_bi;
       vec_add2 (s->overflow_buffer, r, n_bytes_to_write);
       return r;
     }
@@ -994,9 +998,10 @@ static void serialize_vector_write (serialize_main_header_t * m, serialize_strea
 {
   if (! serialize_stream_is_end_of_stream (s))
     {
-      /* Double buffer size. */
+      /* Double buffer size.  Buffer is written before it is read. */
       uword l = vec_len (s->buffer);
-      vec_resize (s->buffer, l > 0 ? l : 64);
+      vec_resize_haf (s->buffer, l > 0 ? l : 64, 0, 0,
+		      VEC_RESIZE_GROW_EXACT | VEC_RESIZE_NO_ZERO);
       s->n_buffer_bytes = vec_len (s->buffer);
     }
 }
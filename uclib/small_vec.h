@@ -0,0 +1,138 @@
+/*
+  Copyright (c) 2014 Eliot Dresselhaus
+
+  Permission is hereby granted, free of charge, to any person obtaining
+  a copy of this software and associated documentation files (the
+  "Software"), to deal in the Software without restriction, including
+  without limitation the rights to use, copy, modify, merge, publish,
+  distribute, sublicense, and/or sell copies of the Software, and to
+  permit persons to whom the Software is furnished to do so, subject to
+  the following conditions:
+
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+  LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+  WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef included_clib_small_vec_h
+#define included_clib_small_vec_h
+
+/* Byte vector with inline storage for short strings (e.g. HTTP header
+   keys and values).  Data stays in the structure until it overflows
+   CLIB_SMALL_VEC_N_INLINE bytes and then spills to a heap vector.
+
+   clib_small_vec (s) is a normal looking vector: vec_len, format "%v",
+   hash_get_mem etc. all work on it.  It must only be grown with the
+   clib_small_vec_add* functions below, never with vec_add etc.
+   Structure may be copied; pointers from clib_small_vec are
+   invalidated by any add. */
+
+/* Whole structure is one 64 byte cache line. */
+#define CLIB_SMALL_VEC_N_INLINE (64 - sizeof (u8 *) - sizeof (vec_header_t))
+
+typedef struct {
+  /* Heap vector once spilled, zero while data is inline. */
+  u8 * heap;
+
+  /* Header must immediately precede inline data so that
+     inline data looks like a vector. */
+  vec_header_t inline_header;
+
+  u8 inline_data[CLIB_SMALL_VEC_N_INLINE];
+} clib_small_vec_t;
+
+always_inline void clib_small_vec_init (clib_small_vec_t * s)
+{
+  s->heap = 0;
+  s->inline_header.len = 0;
+}
+
+always_inline uword clib_small_vec_is_inline (clib_small_vec_t * s)
+{ return ! s->heap; }
+
+/* Vector for reading. */
+always_inline u8 * clib_small_vec (clib_small_vec_t * s)
+{ return s->heap ? s->heap : s->inline_data; }
+
+always_inline uword clib_small_vec_len (clib_small_vec_t * s)
+{ return s->heap ? vec_len (s->heap) : s->inline_header.len; }
+
+/* Add N uninitialized bytes to end; returns pointer to them. */
+always_inline u8 * clib_small_vec_add2 (clib_small_vec_t * s, uword n)
+{
+  uword l;
+  u8 * p;
+
+  if (PREDICT_TRUE (! s->heap))
+    {
+      l = s->inline_header.len;
+      if (PREDICT_TRUE (l + n <= CLIB_SMALL_VEC_N_INLINE))
+	{
+	  s->inline_header.len = l + n;
+	  return s->inline_data + l;
+	}
+
+      /* Spill inline data to heap. */
+      vec_add2_uninit (s->heap, p, l + n);
+      memcpy (p, s->inline_data, l);
+      return p + l;
+    }
+
+  vec_add2_uninit (s->heap, p, n);
+  return p;
+}
+
+always_inline void clib_small_vec_add (clib_small_vec_t * s, void * data, uword n)
+{ memcpy (clib_small_vec_add2 (s, n), data, n); }
+
+always_inline void clib_small_vec_add1 (clib_small_vec_t * s, u8 c)
+{
+  uword l = s->inline_header.len;
+  if (PREDICT_TRUE (! s->heap && l < CLIB_SMALL_VEC_N_INLINE))
+    {
+      s->inline_data[l] = c;
+      s->inline_header.len = l + 1;
+    }
+  else
+    clib_small_vec_add2 (s, 1)[0] = c;
+}
+
+/* Empty vector keeping heap memory (if any) for reuse. */
+always_inline void clib_small_vec_reset_length (clib_small_vec_t * s)
+{
+  if (s->heap)
+    _vec_len (s->heap) = 0;
+  else
+    s->inline_header.len = 0;
+}
+
+always_inline void clib_small_vec_free (clib_small_vec_t * s)
+{
+  vec_free (s->heap);
+  clib_small_vec_init (s);
+}
+
+/* Hand contents to caller as a heap vector (zero when empty) and
+   reset S.  Inline data is copied to an exactly sized vector. */
+always_inline u8 * clib_small_vec_to_vec (clib_small_vec_t * s)
+{
+  u8 * v = s->heap;
+  uword l = s->inline_header.len;
+
+  if (! v && l > 0)
+    vec_add (v, s->inline_data, l);
+  else if (v && vec_len (v) == 0)
+    vec_free (v);
+
+  clib_small_vec_init (s);
+  return v;
+}
+
+#endif /* included_clib_small_vec_h */
@@ -22,9 +22,103 @@
 */
 
 void clib_smp_free (clib_smp_main_t * m)
-{ clib_mem_vm_free (m->vm_base, (uword) ((1 + m->n_cpus) << m->log2_n_per_cpu_vm_bytes)); }
+{ clib_mem_vm_free (m->vm_base, clib_smp_n_vm_slots (m) << m->log2_n_per_cpu_vm_bytes); }
 
-static void allocate_per_cpu_mheap (uword cpu, uword mheap_flags)
+/* Parse sysfs list (e.g. "0-3,8-11") into bitmap.  Frees given vector. */
+static uword * clib_smp_parse_sysfs_list (u8 * s)
+{
+  unformat_input_t input;
+  uword * bitmap = 0;
+  u32 a, b;
+
+  unformat_init_vector (&input, s);
+  while (unformat_check_input (&input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (&input, "%d-%d", &a, &b))
+	;
+      else if (unformat (&input, "%d", &a))
+	b = a;
+      else if (unformat (&input, ","))
+	continue;
+      else
+	break;
+      if (b >= a)
+	bitmap = clib_bitmap_set_region (bitmap, a, 1, b + 1 - a);
+    }
+  unformat_free (&input);
+
+  return bitmap;
+}
+
+/* Read NUMA node of each OS cpu from /sys/devices/system/node. */
+static void clib_smp_read_numa_topology (clib_smp_main_t * m)
+{
+  uword * nodes, * cpus, node, cpu;
+  clib_error_t * error;
+  u8 * s = 0;
+
+  m->n_numa_nodes = 1;
+  vec_reset_length (m->numa_node_for_os_cpu);
+
+  /* No sysfs NUMA info: single node. */
+  error = unix_proc_file_contents ("/sys/devices/system/node/online", &s);
+  if (error)
+    {
+      clib_error_free (error);
+      return;
+    }
+
+  nodes = clib_smp_parse_sysfs_list (s);
+
+  clib_bitmap_foreach (node, nodes, ({
+    u8 * file = format (0, "/sys/devices/system/node/node%d/cpulist%c", node, 0);
+    s = 0;
+    error = unix_proc_file_contents ((char *) file, &s);
+    if (error)
+      clib_error_free (error);
+    else
+      {
+	cpus = clib_smp_parse_sysfs_list (s);
+	clib_bitmap_foreach (cpu, cpus, ({
+	  vec_validate (m->numa_node_for_os_cpu, cpu);
+	  m->numa_node_for_os_cpu[cpu] = node;
+	}));
+	clib_bitmap_free (cpus);
+      }
+    vec_free (file);
+    m->n_numa_nodes = node + 1;
+  }));
+
+  clib_bitmap_free (nodes);
+}
+
+always_inline uword clib_smp_numa_node_for_os_cpu (clib_smp_main_t * m, uword os_cpu)
+{ return os_cpu < vec_len (m->numa_node_for_os_cpu) ? m->numa_node_for_os_cpu[os_cpu] : 0; }
+
+/* NUMA node calling thread is running on. */
+static uword clib_smp_current_numa_node (clib_smp_main_t * m)
+{
+#if defined (__linux__) && defined (SYS_getcpu)
+  unsigned os_cpu, node;
+  if (syscall (SYS_getcpu, &os_cpu, &node, 0) == 0 && node < m->n_numa_nodes)
+    return node;
+#endif
+  return 0;
+}
+
+/* VM area for global heap of given NUMA node. */
+always_inline uword clib_smp_vm_slot_for_numa_node (clib_smp_main_t * m, uword node)
+{ return node == 0 ? m->n_cpus : clib_smp_n_thread_slots (m) + node - 1; }
+
+always_inline uword clib_smp_mheap_flags (clib_smp_main_t * m)
+{
+  uword flags = MHEAP_FLAG_SMALL_OBJECT_CACHE | MHEAP_FLAG_MAGAZINES;
+  if (m->use_huge_pages)
+    flags |= MHEAP_FLAG_HUGE_PAGES;
+  return flags;
+}
+
+static void allocate_per_cpu_mheap (uword cpu, uword numa_node)
 {
   clib_smp_main_t * m = &clib_smp_main;
   void * heap;
@@ -33,39 +127,151 @@ static void allocate_per_cpu_mheap (uword cpu, uword mheap_flags)
   vm_size = (uword) 1 << m->log2_n_per_cpu_vm_bytes;
   stack_size = (uword) 1 << m->log2_n_per_cpu_stack_bytes;
 
-  /* Heap extends up to start of stack. */
+  /* Foreign threads bring their own stacks. */
+  if (cpu > m->n_cpus)
+    stack_size = 0;
+
+  /* Heap extends up to start of stack.  Frees by other cpus go to
+     heap's remote free list. */
   heap = mheap_alloc_with_flags (clib_smp_vm_base_for_cpu (m, cpu),
 				 vm_size - stack_size,
-				 mheap_flags);
+				 clib_smp_mheap_flags (m) | MHEAP_FLAG_REMOTE_FREE);
+  mheap_header (heap)->owner_cpu = cpu;
+  mheap_header (heap)->vm_huge_pages_are_transparent = m->huge_pages_are_transparent;
+
+  /* Keep stack and heap on cpu's local memory. */
+  if (m->n_numa_nodes > 1)
+    {
+      if (stack_size > 0)
+	clib_mem_vm_bind_numa_node (clib_smp_stack_start_for_cpu (m, cpu), stack_size, numa_node);
+      mheap_set_numa_node (heap, numa_node);
+    }
+
   clib_mem_set_heap_for_cpu (heap, cpu);
   m->per_cpu_mains[cpu].index = cpu;
+  m->per_cpu_mains[cpu].numa_node = numa_node;
+  CLIB_MEMORY_BARRIER ();
   m->per_cpu_mains[cpu].heap = heap;
 }
 
+/* Allocate shared global heap (thread safe) for given NUMA node. */
+static void * allocate_numa_global_heap (uword numa_node)
+{
+  clib_smp_main_t * m = &clib_smp_main;
+  uword slot = clib_smp_vm_slot_for_numa_node (m, numa_node);
+  void * heap;
+
+  heap = mheap_alloc_with_flags (clib_smp_vm_base_for_cpu (m, slot),
+				 (uword) 1 << m->log2_n_per_cpu_vm_bytes,
+				 clib_smp_mheap_flags (m) | MHEAP_FLAG_THREAD_SAFE);
+  mheap_header (heap)->vm_huge_pages_are_transparent = m->huge_pages_are_transparent;
+  if (m->n_numa_nodes > 1)
+    mheap_set_numa_node (heap, numa_node);
+
+  return heap;
+}
+
 void clib_smp_init (void)
 {
   clib_smp_main_t * m = &clib_smp_main;
-  uword cpu, mheap_flags;
+  uword cpu, node, n_slots, vm_size;
+
+  clib_smp_read_numa_topology (m);
+
+  /* Per-cpu areas for cpus, global heap (main thread), foreign threads
+     and global heaps for other NUMA nodes. */
+  n_slots = clib_smp_n_thread_slots (m);
+  vm_size = clib_smp_n_vm_slots (m) << m->log2_n_per_cpu_vm_bytes;
+
+  if (m->use_huge_pages)
+    {
+      uword page_size, is_transparent;
+
+      /* Per cpu areas are huge page multiples so heaps stay aligned. */
+      ASSERT (m->log2_n_per_cpu_vm_bytes >= CLIB_MEM_LOG2_HUGE_PAGE_BYTES);
+      m->vm_base = clib_mem_vm_alloc_huge (vm_size, &page_size, &is_transparent);
+      m->use_huge_pages = page_size >= CLIB_MEM_HUGE_PAGE_BYTES;
+      m->huge_pages_are_transparent = is_transparent;
+    }
+  else
+    m->vm_base = clib_mem_vm_alloc (vm_size);
 
-  m->vm_base = clib_mem_vm_alloc ((uword) (m->n_cpus + 1) << m->log2_n_per_cpu_vm_bytes);
   if (! m->vm_base)
     clib_error ("error allocating virtual memory");
 
-  mheap_flags = MHEAP_FLAG_SMALL_OBJECT_CACHE;
+  /* Heap pointer for each cpu index.  Calling thread becomes main thread
+     and keeps its heap until global heap is made.  Bootstrap table has
+     only cpu 0, so index it directly: with vm_base set calling thread
+     already maps to main thread's index. */
+  {
+    void ** heaps = clib_mem_vm_alloc (n_slots * sizeof (heaps[0]));
+    if (! heaps)
+      clib_error ("error allocating virtual memory");
+    memset (heaps, 0, n_slots * sizeof (heaps[0]));
+    heaps[m->n_cpus] = clib_per_cpu_mheaps[0];
+    clib_per_cpu_mheaps = heaps;
+    clib_smp_cpu_index_plus_one = m->n_cpus + 1;
+  }
 
-  /* Allocate shared global heap (thread safe). */
-  m->global_heap =
-    mheap_alloc_with_flags (clib_smp_vm_base_for_cpu (m, m->n_cpus),
-                            (uword) 1 << m->log2_n_per_cpu_vm_bytes,
-                            mheap_flags | MHEAP_FLAG_THREAD_SAFE);
+  /* Main thread uses global heap of node 0. */
+  m->global_heap = allocate_numa_global_heap (0);
 
   clib_mem_set_heap_for_cpu (m->global_heap, m->n_cpus);
 
-  /* Now that we have a heap, allocate main structure on cpu 0. */
-  vec_resize (m->per_cpu_mains, m->n_cpus);
+  /* Now that we have a heap, allocate main structures for all cpu
+     indices and NUMA global heaps.  Never resized: other cpus read
+     it without locking. */
+  vec_resize (m->per_cpu_mains, clib_smp_n_vm_slots (m));
+  m->per_cpu_mains[m->n_cpus].index = m->n_cpus;
+  m->per_cpu_mains[m->n_cpus].heap = m->global_heap;
+
+  {
+    void ** heaps = 0;
+
+    vec_resize (heaps, m->n_numa_nodes);
+    heaps[0] = m->global_heap;
+    for (node = 1; node < m->n_numa_nodes; node++)
+      {
+	uword slot = clib_smp_vm_slot_for_numa_node (m, node);
+	heaps[node] = allocate_numa_global_heap (node);
+	m->per_cpu_mains[slot].index = slot;
+	m->per_cpu_mains[slot].numa_node = node;
+	m->per_cpu_mains[slot].heap = heaps[node];
+      }
+    m->numa_global_heaps = heaps;
+  }
 
   for (cpu = 0; cpu < m->n_cpus; cpu++)
-    allocate_per_cpu_mheap (cpu, mheap_flags);
+    allocate_per_cpu_mheap (cpu, clib_smp_numa_node_for_os_cpu (m, cpu));
+}
+
+/* Give calling thread (e.g. a pthread created by another library)
+   its own cpu index and heap.  Threads must have distinct cpu indices
+   to use thread safe heaps and locks.  Returns cpu index. */
+uword clib_smp_register_thread (void)
+{
+  clib_smp_main_t * m = &clib_smp_main;
+  uword i, cpu;
+
+  ASSERT (m->vm_base != 0);
+
+  if (clib_smp_cpu_index_plus_one != 0)
+    {
+      cpu = clib_smp_cpu_index_plus_one - 1;
+      if (cpu != m->n_cpus)
+	return cpu;
+    }
+
+  i = clib_smp_atomic_add (&m->n_foreign_threads, 1);
+  if (i >= m->max_foreign_threads)
+    clib_error ("more than %d foreign threads registered; increase max_foreign_threads",
+		m->max_foreign_threads);
+
+  cpu = m->n_cpus + 1 + i;
+  allocate_per_cpu_mheap (cpu, clib_smp_current_numa_node (m));
+
+  clib_smp_cpu_index_plus_one = cpu + 1;
+  return cpu;
 }
 
 void clib_smp_lock_init (clib_smp_lock_t ** pl)
@@ -81,9 +287,9 @@ void clib_smp_lock_init (clib_smp_lock_t ** pl)
       return;
     }
 
-  /* Need n_cpus - 1 elts in waiting fifo.  One CPU holds lock
-     and others could potentially be waiting. */
-  n_fifo_elts = clib_smp_main.n_cpus - 1;
+  /* Need one elt in waiting fifo for each cpu index less one.
+     One CPU holds lock and others could potentially be waiting. */
+  n_fifo_elts = clib_smp_n_thread_slots (&clib_smp_main) - 1;
 
   n_bytes = sizeof (l[0]) + n_fifo_elts * sizeof (l->waiting_fifo[0]);
   ASSERT_AND_PANIC (n_bytes % CLIB_CACHE_LINE_BYTES == 0);
@@ -49,6 +49,11 @@ clib_smp_get_per_cpu_main (uword for_cpu)
 #define clib_smp_swap(addr,new) __sync_lock_test_and_set(addr,new)
 #define clib_smp_atomic_add(addr,increment) __sync_fetch_and_add(addr,increment)
 
+/* Publish data written before store to cpus which read it after load.
+   Plain moves on x86; cheaper than CLIB_MEMORY_BARRIER. */
+#define clib_smp_load_acquire(addr) __atomic_load_n(addr,__ATOMIC_ACQUIRE)
+#define clib_smp_store_release(addr,value) __atomic_store_n(addr,value,__ATOMIC_RELEASE)
+
 #if defined (i386) || defined (__x86_64__)
 #define clib_smp_pause() do { asm volatile ("pause"); } while (0)
 #endif
@@ -262,12 +267,22 @@ always_inline void
 clib_smp_unlock_for_reader (clib_smp_lock_t * l)
 { clib_smp_unlock_inline (l, CLIB_SMP_LOCK_TYPE_READER); }
 
+/* Thread-safe global heap for NUMA node of calling cpu. */
+always_inline void *
+clib_smp_local_global_heap (void)
+{
+  clib_smp_main_t * m = &clib_smp_main;
+  if (m->numa_global_heaps)
+    return m->numa_global_heaps[m->per_cpu_mains[os_get_cpu_number ()].numa_node];
+  return m->global_heap;
+}
+
 #define clib_exec_on_global_heap(body)					\
 do {									\
   void * __clib_exec_on_global_heap_saved_heap;				\
 									\
   /* Switch to global (thread-safe) heap. */				\
-  __clib_exec_on_global_heap_saved_heap = clib_mem_set_heap (clib_smp_main.global_heap); \
+  __clib_exec_on_global_heap_saved_heap = clib_mem_set_heap (clib_smp_local_global_heap ()); \
 									\
   /* Execute body. */							\
   body;									\
@@ -282,4 +297,6 @@ uword os_smp_bootstrap (uword n_cpus,
 
 void clib_smp_init (void);
 
+uword clib_smp_register_thread (void);
+
 #endif /* included_clib_smp_h */
@@ -34,6 +34,9 @@ typedef struct {
 
   u32 thread_id;
 
+  /* NUMA node this cpu's stack and heap are bound to. */
+  u32 numa_node;
+
   /* OS specific stuff goes here (e.g. pthread_t). */
   uword opaque;
 } clib_smp_per_cpu_main_t;
@@ -43,18 +46,56 @@ typedef struct {
      This never includes the main thread (cpu index == n_cpus). */
   u32 n_cpus;
 
+  /* Threads not started on a per-cpu stack (e.g. pthreads created by
+     other libraries) may register to get their own cpu index and heap.
+     Foreign thread i has cpu index n_cpus + 1 + i. */
+  u32 max_foreign_threads;
+  volatile u32 n_foreign_threads;
+
   /* Log2 stack and vm (heap) size. */
   u8 log2_n_per_cpu_stack_bytes, log2_n_per_cpu_vm_bytes;
 
+  /* Set before clib_smp_init to back stacks/heaps with huge pages. */
+  u8 use_huge_pages;
+
+  /* Huge pages are transparent (madvise) rather than hugetlbfs. */
+  u8 huge_pages_are_transparent;
+
   /* Per cpus stacks/heaps start at these addresses. */
   void * vm_base;
 
-  /* Thread-safe global heap.  Objects here can be allocated/freed by any cpu. */
+  /* Thread-safe global heap.  Objects here can be allocated/freed by any cpu.
+     This is global heap for NUMA node 0. */
   void * global_heap;
 
+  /* Number of NUMA nodes (largest node id plus one) read from
+     /sys/devices/system/node by clib_smp_init.  One when machine
+     is not NUMA, in which case nothing is bound. */
+  u32 n_numa_nodes;
+
+  /* NUMA node for each OS cpu number.  Cpu index i is assumed
+     to run on OS cpu i. */
+  u32 * numa_node_for_os_cpu;
+
+  /* Thread-safe global heap for each NUMA node.  Node 0's heap lives
+     in main thread's area; others follow foreign thread areas. */
+  void ** numa_global_heaps;
+
   clib_smp_per_cpu_main_t * per_cpu_mains;
 } clib_smp_main_t;
 
 extern clib_smp_main_t clib_smp_main;
 
+/* This thread's cpu index plus one; zero until known. */
+extern __thread uword clib_smp_cpu_index_plus_one;
+
+/* Number of cpu indices: cpus, main thread and foreign threads. */
+always_inline uword clib_smp_n_thread_slots (clib_smp_main_t * m)
+{ return m->n_cpus + 1 + m->max_foreign_threads; }
+
+/* Number of per-cpu VM areas: one per cpu index plus one for
+   global heap of each NUMA node after the first. */
+always_inline uword clib_smp_n_vm_slots (clib_smp_main_t * m)
+{ return clib_smp_n_thread_slots (m) + (m->n_numa_nodes > 1 ? m->n_numa_nodes - 1 : 0); }
+
 #endif /* included_clib_smp_bootstrap_h */
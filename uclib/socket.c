@@ -237,7 +237,8 @@ clib_socket_rx (clib_socket_t * s, int n_bytes)
   fd = s->fd;
 
   n_bytes = clib_max (n_bytes, 4096);
-  vec_add2 (s->rx_buffer, buf, n_bytes);
+  /* read () fills buf; unread bytes are trimmed below. */
+  vec_add2_uninit (s->rx_buffer, buf, n_bytes);
 
   if ((n_read = read (fd, buf, n_bytes)) < 0)
     {
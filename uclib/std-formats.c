@@ -384,3 +384,15 @@ u8 * format_symbol_with_address (u8 * s, va_list * va)
 #endif
   return s;
 }
+
+/* Symbol + offset without white space (e.g. for folded stacks). */
+u8 * format_symbol_name (u8 * s, va_list * va)
+{
+  void * addr = va_arg (*va, void *);
+#ifdef CLIB_HAVE_ELF
+  s = format (s, "%U", format_clib_elf_symbol_name, addr);
+#else
+  s = format (s, "%p", addr);
+#endif
+  return s;
+}
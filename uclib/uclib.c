@@ -18,12 +18,17 @@
 #include <uclib/elog.c>
 #include <uclib/fheap.c>
 #include <uclib/fifo.c>
+#include <uclib/flat_hash.c>
 #include <uclib/hash.c>
 #include <uclib/heap.c>
 #include <uclib/http.c>
 #include <uclib/mhash.c>
+#include <uclib/perfect_hash.c>
+#include <uclib/pool.c>
 #include <uclib/random_isaac.c>
 #include <uclib/random_buffer.c>
+#include <uclib/rcu_hash.c>
+#include <uclib/ring.c>
 #include <uclib/serialize.c>
 #include <uclib/socket.c>
 #include <uclib/time.c>
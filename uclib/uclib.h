@@ -198,11 +198,14 @@ always_inline uword max_pow2 (uword x)
 #include <uclib/byte_order.h>
 #include <uclib/format.h>
 
+#include <uclib/arena.h>
 #include <uclib/base64.h>
 #include <uclib/bitops.h>
 #include <uclib/bitmap.h>
 #include <uclib/fifo.h>
 #include <uclib/hash.h>
+#include <uclib/flat_hash.h>
+#include <uclib/rcu_hash.h>
 #include <uclib/heap.h>
 #include <uclib/init.h>
 #include <uclib/mhash.h>
@@ -210,7 +213,10 @@ always_inline uword max_pow2 (uword x)
 #include <uclib/random.h>
 #include <uclib/random_isaac.h>
 #include <uclib/random_buffer.h>
+#include <uclib/ring.h>
 #include <uclib/serialize.h>
+#include <uclib/perfect_hash.h>
+#include <uclib/small_vec.h>
 #include <uclib/sparse_vec.h>
 #include <uclib/zvec.h>
 
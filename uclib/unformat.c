@@ -344,12 +344,21 @@ uword unformat_input (unformat_input_t * i, va_list * args)
 uword unformat_line (unformat_input_t * i, va_list * va)
 {
   u8 * line = 0, ** result = va_arg (*va, u8 **);
-  uword c;
+  uword c, n, l;
 
-  while ((c = unformat_get_input (i)) != '\n'
-	 && c != UNFORMAT_END_OF_INPUT)
+  /* Copy buffer up to newline a chunk at a time. */
+  while ((c = unformat_check_input (i)) != UNFORMAT_END_OF_INPUT)
     {
-      vec_add1 (line, c);
+      n = vec_len (i->buffer) - c;
+      l = clib_search_u8 (i->buffer + c, n, '\n');
+      if (l < n)
+	{
+	  vec_add (line, i->buffer + c, l);
+	  i->index = c + l + 1;
+	  break;
+	}
+      vec_add (line, i->buffer + c, n);
+      i->index = c + n;
     }
 
   *result = line;
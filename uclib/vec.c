@@ -1,14 +1,16 @@
 /* Vector resize operator.  Called as needed by various macros such as
-   vec_add1() when we need to allocate memory. */
+   vec_add1() when we need to allocate memory.
+   FLAGS select growth policy and whether added elements are zeroed. */
 void * vec_resize_allocate_memory (void * v,
 				   word length_increment,
 				   uword old_length,
 				   uword n_bytes_per_elt,
 				   uword header_bytes,
-				   uword data_align)
+				   uword data_align,
+				   uword flags)
 {
   vec_header_t * vh = _vec_find (v);
-  uword old_alloc_bytes, new_alloc_bytes;
+  uword old_alloc_bytes, new_alloc_bytes, zero_bytes;
   uword old_data_bytes, new_data_bytes;
   void * old, * new;
 
@@ -28,8 +30,14 @@ void * vec_resize_allocate_memory (void * v,
   if (! v)
     {
       new = clib_mem_alloc_aligned_at_offset (new_data_bytes, data_align, header_bytes);
-      new_data_bytes = clib_mem_size (new);
-      memset (new, 0, new_data_bytes);
+      new_alloc_bytes = clib_mem_size (new);
+      if (flags & VEC_RESIZE_NO_ZERO)
+	{
+	  memset (new, 0, header_bytes);
+	  memset (new + new_data_bytes, 0, new_alloc_bytes - new_data_bytes);
+	}
+      else
+	memset (new, 0, new_alloc_bytes);
       v = new + header_bytes;
       _vec_len (v) = length_increment;
       return v;
@@ -44,25 +52,52 @@ void * vec_resize_allocate_memory (void * v,
   if (new_data_bytes <= old_alloc_bytes)
     return v;
 
-  new_alloc_bytes = (old_alloc_bytes * 3) / 2;
+  switch (flags & VEC_RESIZE_GROW_MASK)
+    {
+    case VEC_RESIZE_GROW_DOUBLE:
+      new_alloc_bytes = 2 * old_alloc_bytes;
+      break;
+
+    case VEC_RESIZE_GROW_EXACT:
+      new_alloc_bytes = new_data_bytes;
+      break;
+
+    default:
+      new_alloc_bytes = (old_alloc_bytes * 3) / 2;
+      break;
+    }
   if (new_alloc_bytes < new_data_bytes)
     new_alloc_bytes = new_data_bytes;
 
-  new = clib_mem_alloc_aligned_at_offset (new_alloc_bytes, data_align, header_bytes);
+  /* Grow in place when heap has room after vector.
+     Space past old allocation is ours to zero. */
+  zero_bytes = old_alloc_bytes;
+  if (clib_mem_realloc_in_place (old, new_alloc_bytes))
+    v = old;
+  else
+    {
+      new = clib_mem_alloc_aligned_at_offset (new_alloc_bytes, data_align, header_bytes);
 
-  /* FIXME fail gracefully. */
-  if (! new)
-    os_panic ();
+      /* FIXME fail gracefully. */
+      if (! new)
+	os_panic ();
 
-  memcpy (new, old, old_alloc_bytes);
-  clib_mem_free (old);
-  v = new;
+      /* Only header and live elements need copying; rest is zeroed below. */
+      memcpy (new, old, old_data_bytes);
+      clib_mem_free (old);
+      v = new;
+      zero_bytes = old_data_bytes;
+    }
 
   /* Allocator may give a bit of extra room. */
   new_alloc_bytes = clib_mem_size (v);
 
+  /* Caller will fill added elements: only zero past new length. */
+  if ((flags & VEC_RESIZE_NO_ZERO) && zero_bytes < new_data_bytes)
+    zero_bytes = new_data_bytes;
+
   /* Zero new memory. */
-  memset (v + old_alloc_bytes, 0, new_alloc_bytes - old_alloc_bytes);
+  memset (v + zero_bytes, 0, new_alloc_bytes - zero_bytes);
 
   return v + header_bytes;
 } 
@@ -60,25 +60,39 @@ user's pointer ->     vector element #1
    of a vector then expand it. Vectors expand by 3/2, so such code
    may appear to work for a period of time. Memorize vector indices
    which are invariant. 
+
+   Growth policy may be given per call with the _haf macro variants:
+   VEC_RESIZE_GROW_DOUBLE or VEC_RESIZE_GROW_EXACT in place of the
+   default 3/2.  VEC_RESIZE_NO_ZERO skips zeroing of added elements for
+   callers which overwrite them immediately (e.g. vec_add, vec_add2_uninit).
+   Space past the new length is always zeroed.
  */
 
+#define VEC_RESIZE_GROW_3_2	(0 << 0)
+#define VEC_RESIZE_GROW_DOUBLE	(1 << 0)
+#define VEC_RESIZE_GROW_EXACT	(2 << 0)
+#define VEC_RESIZE_GROW_MASK	(3 << 0)
+#define VEC_RESIZE_NO_ZERO	(1 << 2)
+
 /* Low-level resize allocation function. */
 void * vec_resize_allocate_memory (void * v,
 				   word length_increment,
 				   uword old_length,
 				   uword n_bytes_per_elt,
 				   uword header_bytes,
-				   uword data_align);
+				   uword data_align,
+				   uword flags);
 
-/* Vector resize function.  Called as needed by various macros such as
-   vec_add1() when we need to allocate memory. */
+/* Vector resize function with VEC_RESIZE_* flags.  Called as needed by
+   various macros such as vec_add1() when we need to allocate memory. */
 always_inline void *
-_vec_resize (void * v,
-	     word length_increment,
-	     uword old_length,
-	     uword n_bytes_per_elt,
-	     uword header_bytes,
-	     uword data_align)
+_vec_resize_with_flags (void * v,
+			word length_increment,
+			uword old_length,
+			uword n_bytes_per_elt,
+			uword header_bytes,
+			uword data_align,
+			uword flags)
 {
   vec_header_t * vh;
   uword aligned_header_bytes, new_data_bytes, old_data_bytes;
@@ -121,7 +135,20 @@ _vec_resize (void * v,
 				     old_length,
 				     n_bytes_per_elt,
 				     header_bytes,
-				     clib_max (sizeof (vec_header_t), data_align));
+				     clib_max (sizeof (vec_header_t), data_align),
+				     flags);
+}
+
+always_inline void *
+_vec_resize (void * v,
+	     word length_increment,
+	     uword old_length,
+	     uword n_bytes_per_elt,
+	     uword header_bytes,
+	     uword data_align)
+{
+  return _vec_resize_with_flags (v, length_increment, old_length, n_bytes_per_elt,
+				 header_bytes, data_align, /* flags */ 0);
 }
 
 uword clib_mem_is_vec_h (void * v, uword header_bytes);
@@ -136,17 +163,21 @@ always_inline uword clib_mem_is_vec (void * v)
    Add N elements to end of given vector V, return pointer to start of vector.
    Vector will have room for H header bytes and will have user's data aligned
    at alignment A (rounded to next power of 2). */
-#define vec_resize_ha(V,N,H,A)						\
+#define vec_resize_haf(V,N,H,A,F)					\
 do {									\
   word _v(resize_n) = (N);						\
   word _v(resize_l) = vec_len (V);					\
-  V = _vec_resize ((V), _v(resize_n), _v(resize_l), sizeof ((V)[0]), (H), (A));	\
+  V = _vec_resize_with_flags ((V), _v(resize_n), _v(resize_l), sizeof ((V)[0]), (H), (A), (F)); \
 } while (0)
 
+/* Resize a vector (default growth policy). */
+#define vec_resize_ha(V,N,H,A) vec_resize_haf(V,N,H,A,0)
 /* Resize a vector (unspecified alignment). */
 #define vec_resize(V,N)     vec_resize_ha(V,N,0,0)
 /* Resize a vector (aligned). */
 #define vec_resize_aligned(V,N,A) vec_resize_ha(V,N,0,A)
+/* Resize a vector leaving added elements uninitialized. */
+#define vec_resize_uninit(V,N) vec_resize_haf(V,N,0,0,VEC_RESIZE_NO_ZERO)
 
 /* Allocate space for N more elements but keep size the same (general version). */
 #define vec_alloc_ha(V,N,H,A)			\
@@ -227,7 +258,7 @@ do {									\
   word _v(validate_l) = vec_len (V);					\
   if (_v(validate_i) >= _v(validate_l))					\
     {									\
-      vec_resize_ha ((V), 1 + (_v(validate_i) - _v(validate_l)), (H), (A)); \
+      vec_resize_haf ((V), 1 + (_v(validate_i) - _v(validate_l)), (H), (A), VEC_RESIZE_NO_ZERO); \
       /* Must zero new space since user may have previously		\
 	 used e.g. _vec_len (v) -= 10 */				\
       memset ((V) + _v(validate_l), 0, (1 + (_v(validate_i) - _v(validate_l))) * sizeof ((V)[0])); \
@@ -246,7 +277,7 @@ do {									\
   word _v(validate_l) = vec_len (V);					\
   if (_v(validate_i) >= _v(validate_l))					\
     {									\
-      vec_resize_ha ((V), 1 + (_v(validate_i) - _v(validate_l)), (H), (A)); \
+      vec_resize_haf ((V), 1 + (_v(validate_i) - _v(validate_l)), (H), (A), VEC_RESIZE_NO_ZERO); \
       while (_v(validate_l) <= _v(validate_i))				\
 	{								\
 	  (V)[_v(validate_l)] = (INIT);					\
@@ -266,7 +297,7 @@ do {									\
 #define vec_add1_ha(V,E,H,A)						\
 do {									\
   word _v(add_l) = vec_len (V);						\
-  V = _vec_resize ((V), 1, _v(add_l), sizeof ((V)[0]), (H), (A));	\
+  V = _vec_resize_with_flags ((V), 1, _v(add_l), sizeof ((V)[0]), (H), (A), VEC_RESIZE_NO_ZERO); \
   (V)[_v(add_l)] = (E);							\
 } while (0)
 
@@ -276,25 +307,28 @@ do {									\
 #define vec_add1_aligned(V,E,A) vec_add1_ha(V,E,0,A)
 
 /* Add N elements to end of vector V, return pointer to new elements in P. (general version) */
-#define vec_add2_ha(V,P,N,H,A)						\
+#define vec_add2_haf(V,P,N,H,A,F)					\
 do {									\
   word _v(add_n) = (N);							\
   word _v(add_l) = vec_len (V);						\
-  V = _vec_resize ((V), _v(add_n), _v(add_l), sizeof ((V)[0]), (H), (A)); \
+  V = _vec_resize_with_flags ((V), _v(add_n), _v(add_l), sizeof ((V)[0]), (H), (A), (F)); \
   P = (V) + _v(add_l);							\
 } while (0)
 
+#define vec_add2_ha(V,P,N,H,A)    vec_add2_haf(V,P,N,H,A,0)
 /* Add N elements to end of vector V, return pointer to new elements in P. (unspecified alignment) */
 #define vec_add2(V,P,N)           vec_add2_ha(V,P,N,0,0)
 /* Add N elements to end of vector V, return pointer to new elements in P. (alignment specified, no header) */
 #define vec_add2_aligned(V,P,N,A) vec_add2_ha(V,P,N,0,A)
+/* As vec_add2 but new elements are not zeroed: caller must write them all. */
+#define vec_add2_uninit(V,P,N)    vec_add2_haf(V,P,N,0,0,VEC_RESIZE_NO_ZERO)
 
 /* Add N elements to end of vector V (general version) */
 #define vec_add_ha(V,E,N,H,A)						\
 do {									\
   word _v(add_n) = (N);							\
   word _v(add_l) = vec_len (V);						\
-  V = _vec_resize ((V), _v(add_n), _v(add_l), sizeof ((V)[0]), (H), (A));	\
+  V = _vec_resize_with_flags ((V), _v(add_n), _v(add_l), sizeof ((V)[0]), (H), (A), VEC_RESIZE_NO_ZERO); \
   memcpy ((V) + _v(add_l), (E), _v(add_n) * sizeof ((V)[0]));			\
 } while (0)
 
@@ -474,5 +508,116 @@ do {								\
   qsort (vec, vec_len (vec), sizeof (vec[0]), (void *) (f));	\
 } while (0)
 
+/* Search and count kernels.  Use 16 byte vector compares when
+   u8x16_compare_byte_mask is available (SSE2, NEON); scalar loops
+   otherwise. */
+#if CLIB_VECTOR_WORD_BITS >= 128 && (defined (__SSE2__) || defined (__ARM_NEON__) || defined (__arm64__))
+#define CLIB_VEC_SEARCH_SIMD 1
+#else
+#define CLIB_VEC_SEARCH_SIMD 0
+#endif
+
+/* Index of first element equal to X among N at P or ~0 if none. */
+always_inline uword
+clib_search_u8 (u8 * p, uword n, u8 x)
+{
+  uword i = 0;
+#if CLIB_VEC_SEARCH_SIMD
+  u8x16 xs = u8x16_splat (x);
+  uword m;
+
+  for (; i + 16 <= n; i += 16)
+    {
+      m = u8x16_compare_byte_mask (u8x16_is_equal (clib_mem_unaligned (p + i, u8x16), xs));
+      if (m)
+	return i + log2_first_set (m);
+    }
+#endif
+  for (; i < n; i++)
+    if (p[i] == x)
+      return i;
+  return ~0;
+}
+
+always_inline uword
+clib_search_u16 (u16 * p, uword n, u16 x)
+{
+  uword i = 0;
+#if CLIB_VEC_SEARCH_SIMD
+  u16x8 xs = (u16x8) {x, x, x, x, x, x, x, x};
+  uword m;
+
+  for (; i + 8 <= n; i += 8)
+    {
+      /* 2 mask bits per element. */
+      m = u8x16_compare_byte_mask ((u8x16) (clib_mem_unaligned (p + i, u16x8) == xs));
+      if (m)
+	return i + log2_first_set (m) / 2;
+    }
+#endif
+  for (; i < n; i++)
+    if (p[i] == x)
+      return i;
+  return ~0;
+}
+
+always_inline uword
+clib_search_u32 (u32 * p, uword n, u32 x)
+{
+  uword i = 0;
+#if CLIB_VEC_SEARCH_SIMD
+  u32x4 xs = (u32x4) {x, x, x, x};
+  uword m;
+
+  for (; i + 4 <= n; i += 4)
+    {
+      /* 4 mask bits per element. */
+      m = u8x16_compare_byte_mask ((u8x16) (clib_mem_unaligned (p + i, u32x4) == xs));
+      if (m)
+	return i + log2_first_set (m) / 4;
+    }
+#endif
+  for (; i < n; i++)
+    if (p[i] == x)
+      return i;
+  return ~0;
+}
+
+/* Number of bytes equal to X among N at P. */
+always_inline uword
+clib_count_u8 (u8 * p, uword n, u8 x)
+{
+  uword i = 0, count = 0;
+#if CLIB_VEC_SEARCH_SIMD
+  u8x16 xs = u8x16_splat (x);
+
+  while (i + 16 <= n)
+    {
+      u8x16_union_t sum;
+      uword j, n_blocks;
+
+      /* Compares are 0 or -1 per byte: accumulate at most 255 blocks
+	 in byte counters before they can wrap. */
+      n_blocks = clib_min ((n - i) / 16, 255);
+      sum.as_u8x16 = u8x16_splat (0);
+      for (j = 0; j < n_blocks; j++, i += 16)
+	sum.as_u8x16 -= (u8x16) u8x16_is_equal (clib_mem_unaligned (p + i, u8x16), xs);
+      for (j = 0; j < 16; j++)
+	count += sum.as_u8[j];
+    }
+#endif
+  for (; i < n; i++)
+    count += p[i] == x;
+  return count;
+}
+
+/* Index of first element of V equal to X or ~0 if none. */
+#define vec_search_u8(v,x)	clib_search_u8 ((v), vec_len (v), (x))
+#define vec_search_u16(v,x)	clib_search_u16 ((v), vec_len (v), (x))
+#define vec_search_u32(v,x)	clib_search_u32 ((v), vec_len (v), (x))
+
+/* Number of elements of byte vector V equal to X. */
+#define vec_count_u8(v,x)	clib_count_u8 ((v), vec_len (v), (x))
+
 #endif /* included_vec_h */
 
@@ -26,6 +26,7 @@
 
 #include <unistd.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
 
 always_inline uword
 clib_mem_vm_mmap_base_flags ()
@@ -92,4 +93,92 @@ always_inline void * clib_mem_vm_map (void * addr, uword size)
 always_inline uword clib_mem_get_page_size (void)
 { return getpagesize (); }
 
+/* Huge page size used by clib_mem_vm_alloc_huge. */
+#define CLIB_MEM_LOG2_HUGE_PAGE_BYTES 21
+#define CLIB_MEM_HUGE_PAGE_BYTES ((uword) 1 << CLIB_MEM_LOG2_HUGE_PAGE_BYTES)
+
+/* Allocate virtual address space backed by huge pages.  Size is rounded
+   up to huge page size and returned address is huge page aligned.
+   First tries hugetlbfs pages (MAP_HUGETLB); if none are reserved falls
+   back to normal pages with transparent huge pages requested via
+   madvise (MADV_HUGEPAGE).  Page size used is returned in
+   *page_size_return and *is_transparent_return is set for fallback.
+   On failure returns 0 with both set to zero. */
+always_inline void *
+clib_mem_vm_alloc_huge (uword size, uword * page_size_return, uword * is_transparent_return)
+{
+  void * mmap_addr;
+  uword flags = clib_mem_vm_mmap_base_flags ();
+  uword huge = CLIB_MEM_HUGE_PAGE_BYTES;
+
+  *page_size_return = *is_transparent_return = 0;
+
+  size = (size + huge - 1) &~ (huge - 1);
+
+#if defined (MAP_HUGETLB)
+  /* Huge pages are reserved up front: no MAP_NORESERVE. */
+  mmap_addr = mmap (0, size, PROT_READ | PROT_WRITE,
+		    (flags &~ MAP_NORESERVE) | MAP_HUGETLB, -1, 0);
+  if (mmap_addr != (void *) -1)
+    {
+      *page_size_return = huge;
+      *is_transparent_return = 0;
+      return mmap_addr;
+    }
+#endif
+
+  /* Over allocate so we can trim to huge page alignment. */
+  mmap_addr = mmap (0, size + huge, PROT_READ | PROT_WRITE, flags, -1, 0);
+  if (mmap_addr == (void *) -1)
+    return 0;
+
+  {
+    uword a = pointer_to_uword (mmap_addr);
+    uword b = (a + huge - 1) &~ (huge - 1);
+
+    if (b > a)
+      munmap (mmap_addr, b - a);
+    if (b + size < a + size + huge)
+      munmap (uword_to_pointer (b + size, void *), a + huge - b);
+    mmap_addr = uword_to_pointer (b, void *);
+  }
+
+  *page_size_return = clib_mem_get_page_size ();
+#if defined (MADV_HUGEPAGE)
+  if (madvise (mmap_addr, size, MADV_HUGEPAGE) == 0)
+    *page_size_return = huge;
+#endif
+  *is_transparent_return = 1;
+
+  return mmap_addr;
+}
+
+/* Give pages back to kernel keeping address range mapped.
+   Pages read back as zero when next touched. */
+always_inline void clib_mem_vm_release (void * addr, uword size)
+{ madvise (addr, size, MADV_DONTNEED); }
+
+/* Prefer given NUMA node for pages of address range (mbind
+   MPOL_PREFERRED); pages already present are moved.  Unlike MPOL_BIND
+   allocation falls back to other nodes when node runs out of memory
+   instead of invoking OOM killer.  Policy is lost when range is
+   re-mapped.  Returns 0 on success. */
+always_inline int
+clib_mem_vm_bind_numa_node (void * addr, uword size, uword node)
+{
+#if defined (__linux__) && defined (SYS_mbind)
+  uword mask[1 + node / BITS (uword)];
+  uword max_node = BITS (mask);
+
+  memset (mask, 0, sizeof (mask));
+  mask[node / BITS (uword)] = (uword) 1 << (node % BITS (uword));
+
+  /* 1 = MPOL_PREFERRED, 1 << 1 = MPOL_MF_MOVE from <linux/mempolicy.h>.
+     Kernel wants one more than number of bits in mask. */
+  return syscall (SYS_mbind, addr, size, 1, mask, max_node + 1, 1 << 1);
+#else
+  return -1;
+#endif
+}
+
 #endif /* included_vm_unix_h */
@@ -212,18 +212,32 @@ static int parse_rx_frame (websocket_main_t * wsm, websocket_socket_t * ws)
   return rx_frame_parsed;
 }
 
+/* Handshake is re-parsed each time more of it is received.  Parse in
+   arena so that incomplete handshakes leave nothing to free; fields kept
+   from a complete handshake are copied out before arena is reset. */
 static int
 parse_rx_handshake (websocket_main_t * wsm, websocket_socket_t * ws,
                     uword * rx_buffer_advance,
 		    clib_error_t ** error_return)
 {
+  clib_arena_t * a = &wsm->rx_handshake_arena;
   clib_socket_t * s = &ws->clib_socket;
   unformat_input_t input;
   http_request_or_response_t r;
-  u8 * websocket_key = 0;
-  int is_ok = 0;
+  u8 * websocket_key = 0, * key = 0, * protocol = 0;
+  char * error_message = 0;
+  u8 sum[20];
+  int is_ok = 0, use_arena;
 
   *error_return = 0;
+  *rx_buffer_advance = 0;
+
+  /* Let large requests be parsed on normal heap.  Nothing may be
+     allocated on or grow into other heaps while arena is pushed. */
+  use_arena = vec_len (s->rx_buffer) <= clib_arena_max_bytes (a) / 16;
+  if (use_arena)
+    clib_arena_push (a);
+
   unformat_init_vector (&input, s->rx_buffer);
   if (! unformat_user (&input, unformat_http_request, &r))
     goto done;
@@ -238,7 +252,7 @@ parse_rx_handshake (websocket_main_t * wsm, websocket_socket_t * ws,
   if (hash_elts (wsm->host_name_hash) > 0
       && ! hash_get_mem (wsm->host_name_hash, http_request_value_for_key (&r, "host")))
     {
-      *error_return = clib_error_return (0, "host unknown: %v", s->rx_buffer);
+      error_message = "host unknown";
       goto done;
     }
       
@@ -247,57 +261,72 @@ parse_rx_handshake (websocket_main_t * wsm, websocket_socket_t * ws,
       || ws->websocket_version < 13
       || ws->websocket_version >= 256)
     {
-      *error_return = clib_error_return (0, "sec-websocket-version unknown: %v", s->rx_buffer);
+      error_message = "sec-websocket-version unknown";
       goto done;
     }
 
   if (! http_request_value_for_key_compare (&r, "upgrade", "websocket"))
     {
-      *error_return = clib_error_return (0, "upgrade: websocket missing: %v", s->rx_buffer);
+      error_message = "upgrade: websocket missing";
       goto done;
     }
   if (! http_request_value_for_key_compare (&r, "connection", "Upgrade"))
     {
-      *error_return = clib_error_return (0, "connection: Upgrade missing: %v", s->rx_buffer);
+      error_message = "connection: Upgrade missing";
       goto done;
     }
 
-  {
-    u8 * v = http_request_value_for_key (&r, "sec-websocket-key");
-    u8 sum[20];
-
-    if (! v)
-      {
-	*error_return = clib_error_return (0, "sec-sebsocket-key missing: %v", s->rx_buffer);
-	goto done;
-      }
-
-    websocket_key = format (0, "%v%s", v, "258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
-    sha1 (sum, websocket_key, vec_len (websocket_key));
+  key = http_request_value_for_key (&r, "sec-websocket-key");
+  if (! key)
+    {
+      error_message = "sec-websocket-key missing";
+      goto done;
+    }
 
-    clib_socket_tx_add_formatted
-      (s,
-       "HTTP/1.1 101 Switching Protocols\r\n"
-       "Upgrade: websocket\r\n"
-       "Connection: Upgrade\r\n"
-       "Sec-WebSocket-Accept: %U\r\n"
-       "\r\n",
-       format_base64_data, sum, sizeof (sum));
-    clib_socket_tx (s);
+  websocket_key = format (0, "%v%s", key, "258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
+  sha1 (sum, websocket_key, vec_len (websocket_key));
 
-    is_ok = 1;
-  }
+  protocol = http_request_value_for_key (&r, "sec-websocket-protocol");
+  is_ok = 1;
 
  done:
   /* Let caller know how much we've advanced rx buffer. */
   *rx_buffer_advance = input.index;
   input.buffer = 0;             /* don't free clib_socket rx_buffer */
-  unformat_free (&input);
-  vec_free (websocket_key);
+
+  if (use_arena)
+    clib_arena_pop (a);
+
   if (is_ok)
-    ws->server.http_handshake_request = r;
+    {
+      ws->server.sec_websocket_key = vec_dup (key);
+      ws->server.sec_websocket_protocol = vec_dup (protocol);
+      ws->server.path = vec_dup (r.request.path);
+
+      clib_socket_tx_add_formatted
+	(s,
+	 "HTTP/1.1 101 Switching Protocols\r\n"
+	 "Upgrade: websocket\r\n"
+	 "Connection: Upgrade\r\n"
+	 "Sec-WebSocket-Accept: %U\r\n"
+	 "\r\n",
+	 format_base64_data, sum, sizeof (sum));
+      clib_socket_tx (s);
+    }
+
+  if (error_message)
+    *error_return = clib_error_return (0, "%s: %v", error_message, s->rx_buffer);
+
+  /* Frees request, key and input's buffer marks. */
+  if (use_arena)
+    clib_arena_reset (a);
   else
-    http_request_or_response_free (&r);
+    {
+      unformat_free (&input);
+      vec_free (websocket_key);
+      http_request_or_response_free (&r);
+    }
+
   return is_ok;
 }
 
@@ -693,6 +722,12 @@ websocket_init (websocket_main_t * wsm)
   if (wsm->rx_handshake_timeout_in_sec <= 0)
     wsm->rx_handshake_timeout_in_sec = 5;
 
+  if (! clib_arena_init (&wsm->rx_handshake_arena, 1 << 20))
+    {
+      error = clib_error_return (0, "failed to allocate handshake arena");
+      goto done;
+    }
+
   {
     unix_file_poller_file_functions_t f = {
       .read_function = websocket_client_file_read_ready,
@@ -918,6 +953,7 @@ void websocket_main_free (websocket_main_t * wsm)
     }
   pool_free (wsm->user_socket_pool);
   clib_random_buffer_free (&wsm->random_buffer);
+  clib_arena_free (&wsm->rx_handshake_arena);
 }
 
 u8 * format_websocket_connection_type (u8 * s, va_list * va)
@@ -50,7 +50,10 @@ typedef struct {
     } client;
 
     struct {
-      http_request_or_response_t http_handshake_request;
+      /* From client's handshake request. */
+      u8 * path;
+      u8 * sec_websocket_key;
+      u8 * sec_websocket_protocol;
     } server;
   };
 } websocket_socket_t;
@@ -82,7 +85,9 @@ websocket_socket_free (websocket_socket_t * ws)
   clib_socket_free (&ws->clib_socket);
   if (ws->is_server_client)
     {
-      http_request_or_response_free (&ws->server.http_handshake_request);
+      vec_free (ws->server.path);
+      vec_free (ws->server.sec_websocket_key);
+      vec_free (ws->server.sec_websocket_protocol);
     }
   else
     {
@@ -151,6 +156,9 @@ typedef struct websocket_main_t {
   /* If correct handshake is not received before a certain time close connection. */
   f64 rx_handshake_timeout_in_sec;
 
+  /* Scratch heap for parsing partially received handshakes. */
+  clib_arena_t rx_handshake_arena;
+
   u32 verbose;
 } websocket_main_t;
 